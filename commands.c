@@ -186,7 +186,14 @@ int mutt_display_message(struct Email *cur)
 
   snprintf(buf, sizeof(buf), "%s/%s", TYPE(cur->content), cur->content->subtype);
 
+  /* A large message may be displayed without its attachments */
+#ifdef USE_IMAP
+  imap_allow_partial(Context->mailbox, cur, true);
+#endif
   mutt_parse_mime_message(Context->mailbox, cur);
+#ifdef USE_IMAP
+  imap_allow_partial(Context->mailbox, cur, false);
+#endif
   mutt_message_hook(Context->mailbox, cur, MUTT_MESSAGE_HOOK);
 
   /* see if crypto is needed for this message.  if so, we should exit curses */
@@ -268,8 +275,14 @@ int mutt_display_message(struct Email *cur)
 #ifdef USE_NOTMUCH
   if (Context->mailbox->magic == MUTT_NOTMUCH)
     chflags |= CH_VIRTUAL;
+#endif
+#ifdef USE_IMAP
+  imap_allow_partial(Context->mailbox, cur, true);
 #endif
   res = mutt_copy_message_ctx(fpout, Context->mailbox, cur, cmflags, chflags);
+#ifdef USE_IMAP
+  imap_allow_partial(Context->mailbox, cur, false);
+#endif
 
   if ((mutt_file_fclose(&fpout) != 0 && errno != EPIPE) || res < 0)
   {
@@ -1068,7 +1081,7 @@ int mutt_save_message(struct Mailbox *m, struct EmailList *el, bool delete,
 #endif
 
   struct Mailbox *m_save = mx_path_resolve(buf);
-  savectx = mx_mbox_open(m_save, MUTT_APPEND);
+  savectx = mx_mbox_open(m_save, MUTT_APPEND | MUTT_BATCH);
   if (!savectx)
   {
     mailbox_free(&m_save);
@@ -1087,69 +1100,71 @@ int mutt_save_message(struct Mailbox *m, struct EmailList *el, bool delete,
   if (m_comp && (m_comp->msg_count == 0))
     m_comp = NULL;
 #endif
-  if (single)
+
+  int rc = 0;
+  struct EmailNode *failed = NULL;
+
+#ifdef USE_NOTMUCH
+  if (!single && (m->magic == MUTT_NOTMUCH))
+    nm_db_longrun_init(m, true);
+#endif
+  /* The originals are only deleted once all the copies have been flushed */
+  STAILQ_FOREACH(en, el, entries)
   {
-    if (mutt_save_message_ctx(en->email, delete, decode, decrypt, savectx->mailbox) != 0)
+    if (!single)
+      mutt_message_hook(m, en->email, MUTT_MESSAGE_HOOK);
+    rc = mutt_save_message_ctx(en->email, false, decode, decrypt, savectx->mailbox);
+    if (rc != 0)
     {
-      mx_mbox_close(&savectx);
-      return -1;
+      failed = en;
+      break;
     }
 #ifdef USE_COMPRESSED
     if (m_comp)
     {
+      struct Email *e2 = en->email;
       m_comp->msg_count++;
-      if (!en->email->read)
+      if (!e2->read)
       {
         m_comp->msg_unread++;
-        if (!en->email->old)
+        if (!e2->old)
           m_comp->msg_new++;
       }
-      if (en->email->flagged)
+      if (e2->flagged)
         m_comp->msg_flagged++;
     }
 #endif
   }
-  else
-  {
-    int rc = 0;
-
 #ifdef USE_NOTMUCH
-    if (m->magic == MUTT_NOTMUCH)
-      nm_db_longrun_init(m, true);
+  if (!single && (m->magic == MUTT_NOTMUCH))
+    nm_db_longrun_done(m);
 #endif
+
+  if (mx_mbox_flush(savectx->mailbox) != 0)
+  {
+    mx_mbox_close(&savectx);
+    return -1;
+  }
+
+  if (delete)
+  {
     STAILQ_FOREACH(en, el, entries)
     {
-      mutt_message_hook(m, en->email, MUTT_MESSAGE_HOOK);
-      rc = mutt_save_message_ctx(en->email, delete, decode, decrypt, savectx->mailbox);
-      if (rc != 0)
+      if (en == failed)
         break;
-#ifdef USE_COMPRESSED
-      if (m_comp)
-      {
-        struct Email *e2 = en->email;
-        m_comp->msg_count++;
-        if (!e2->read)
-        {
-          m_comp->msg_unread++;
-          if (!e2->old)
-            m_comp->msg_new++;
-        }
-        if (e2->flagged)
-          m_comp->msg_flagged++;
-      }
-#endif
-    }
-#ifdef USE_NOTMUCH
-    if (m->magic == MUTT_NOTMUCH)
-      nm_db_longrun_done(m);
-#endif
-    if (rc != 0)
-    {
-      mx_mbox_close(&savectx);
-      return -1;
+      mutt_set_flag(m, en->email, MUTT_DELETE, true);
+      mutt_set_flag(m, en->email, MUTT_PURGE, true);
+      if (DeleteUntag)
+        mutt_set_flag(m, en->email, MUTT_TAG, false);
     }
   }
 
+  if (rc != 0)
+  {
+    mx_mbox_close(&savectx);
+    return -1;
+  }
+
   const bool need_mailbox_cleanup = ((savectx->mailbox->magic == MUTT_MBOX) ||
                                      (savectx->mailbox->magic == MUTT_MMDF));
 
@@ -754,6 +754,27 @@ static int comp_mbox_close(struct Mailbox *m)
   return 0;
 }
 
+/**
+ * comp_mbox_flush - Implements MxOps::mbox_flush()
+ */
+static int comp_mbox_flush(struct Mailbox *m)
+{
+  if (!m || !m->compress_info)
+    return -1;
+
+  struct CompressInfo *ci = m->compress_info;
+
+  const struct MxOps *ops = ci->child_ops;
+  if (!ops)
+    return -1;
+
+  if (!ops->mbox_flush)
+    return 0;
+
+  /* Delegate */
+  return ops->mbox_flush(m);
+}
+
 /**
  * comp_msg_open - Implements MxOps::msg_open()
  */
@@ -977,6 +998,7 @@ struct MxOps MxCompOps = {
   .mbox_check       = comp_mbox_check,
   .mbox_sync        = comp_mbox_sync,
   .mbox_close       = comp_mbox_close,
+  .mbox_flush       = comp_mbox_flush,
   .msg_open         = comp_msg_open,
   .msg_open_new     = comp_msg_open_new,
   .msg_commit       = comp_msg_commit,
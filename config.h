@@ -0,0 +1,96 @@
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#define ALL_TARGETS "all-po all-doc all-contrib all-test"
+#define BINDIR "/usr/bin"
+#define CLEAN_TARGETS "clean-po clean-doc clean-contrib clean-test"
+#define CRYPT_BACKEND_CLASSIC_PGP 1
+#define CRYPT_BACKEND_CLASSIC_SMIME 1
+#define HAVE_BKGDSET 1
+#define HAVE_CFLAG_STD_C99 1
+#define HAVE_CLOCK_GETTIME 1
+#define HAVE_COLOR 1
+#define HAVE_COPY_FILE_RANGE 1
+#define HAVE_CURS_SET 1
+/* #undef HAVE_DECL_SYS_SIGLIST */
+#define HAVE_DEFLATESETDICTIONARY 1
+#define HAVE_FGETC_UNLOCKED 1
+#define HAVE_FUTIMENS 1
+#define HAVE_GETADDRINFO 1
+#define HAVE_GETADDRINFO_A 1
+#define HAVE_GETDENTS64 1
+#define HAVE_GETHOSTENT 1
+#define HAVE_GETSID 1
+#define HAVE_ICONV 1
+#define HAVE_ICONV_H 1
+#define HAVE_INOTIFY_ADD_WATCH 1
+#define HAVE_INOTIFY_INIT1 1
+#define HAVE_INOTIFY_RM_WATCH 1
+/* #undef HAVE_IOCTL_H */
+#define HAVE_ISWBLANK 1
+#define HAVE_LFS 1
+#define HAVE_LITTLE_ENDIAN 1
+#define HAVE_META 1
+/* #undef HAVE_MINIX_CONFIG_H */
+#define HAVE_MKDTEMP 1
+#define HAVE_NCURSESW_NCURSES_H 1
+#define HAVE_PGP 1
+#define HAVE_PTHREAD_CREATE 1
+#define HAVE_PTHREAD_H 1
+#define HAVE_SENDFILE 1
+#define HAVE_SETSOCKOPT 1
+#define HAVE_SIGNAL_H 1
+#define HAVE_SMIME 1
+#define HAVE_START_COLOR 1
+#define HAVE_STDLIB_H 1
+#define HAVE_STRSEP 1
+#define HAVE_STRUCT_STAT_ST_ATIM_TV_NSEC 1
+#define HAVE_STRUCT_TIMESPEC 1
+#define HAVE_SYSEXITS_H 1
+#define HAVE_SYS_INOTIFY_H 1
+#define HAVE_SYS_IOCTL_H 1
+#define HAVE_SYS_PARAM_H 1
+#define HAVE_SYS_SENDFILE_H 1
+#define HAVE_SYS_STAT_H 1
+#define HAVE_SYS_SYSCALL_H 1
+#define HAVE_SYS_TYPES_H 1
+#define HAVE_TGETENT 1
+#define HAVE_TIME_H 1
+#define HAVE_TYPEAHEAD 1
+#define HAVE_UNISTD_H 1
+#define HAVE_USE_DEFAULT_COLORS 1
+#define HAVE_USE_EXTENDED_NAMES 1
+/* #undef HAVE_UTIMESNSAT */
+#define HAVE_VASPRINTF 1
+#define HAVE_WADDNWSTR 1
+#define HAVE_WCSCASECMP 1
+#define HAVE_ZLIB 1
+#define HAVE_ZLIB_H 1
+#define ICONV_CONST 
+#define INSTALL_TARGETS "install-po install-doc install-contrib install-test"
+#define LOFF_T off_t
+#define MAILPATH "/var/mail"
+#define MUTTLOCALEDIR "/usr/share/locale"
+#define OFF_T_FMT "%" PRId64
+#define PACKAGE "neomutt"
+#define PACKAGE_VERSION "20180716"
+#define PKGDATADIR "/usr/share/neomutt"
+#define PKGDOCDIR "/usr/share/doc/neomutt"
+#define SENDMAIL "/usr/sbin/sendmail"
+#define SIG_ATOMIC_VOLATILE_T volatile sig_atomic_t
+#define SIZEOF_OFF_T 8
+#define SUN_ATTACHMENT 1
+#define SYSCONFDIR "/etc"
+#define UNINSTALL_TARGETS "uninstall-po uninstall-doc uninstall-contrib uninstall-test"
+#define USE_COMPRESSED 1
+#define USE_FCNTL 1
+/* #undef USE_FMEMOPEN */
+#define USE_IMAP 1
+#define USE_INOTIFY 1
+#define USE_NNTP 1
+#define USE_POP 1
+#define USE_PTHREADS 1
+#define USE_SIDEBAR 1
+#define USE_SMTP 1
+#define USE_SOCKET 1
+#define USE_ZLIB 1
+#endif
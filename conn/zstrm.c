@@ -0,0 +1,307 @@
+/**
+ * @file
+ * Compressed network connections
+ *
+ * @authors
+ * Copyright (C) 2019 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page conn_zstrm Compressed network connections
+ *
+ * Compress the traffic of an open Connection with raw DEFLATE (RFC1951), as
+ * used by the IMAP COMPRESS extension (RFC4978).
+ *
+ * The compression is layered on top of whatever the Connection already uses
+ * (a raw socket, a tunnel or TLS).  Closing the Connection removes it again.
+ */
+
+#include "config.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#include "mutt/mutt.h"
+#include "zstrm.h"
+#include "connection.h"
+
+/* Size of the buffers of compressed data */
+#define ZSTRM_BUFSIZE 8192
+
+/**
+ * struct ZstrmDirection - A stream of data being (de-)compressed
+ */
+struct ZstrmDirection
+{
+  z_stream z;      ///< zlib compression handle
+  char *buf;       ///< Buffer for the compressed data
+  bool full;       ///< The last output buffer was filled, more may be pending
+  bool conn_eof;   ///< The underlying Connection has been closed
+  bool stream_eof; ///< The end of the compressed stream has been reached
+  bool peeked;     ///< zstrm_poll() has decompressed a byte into peek
+  char peek;       ///< Byte decompressed by zstrm_poll(), not yet read
+};
+
+/**
+ * struct ZstrmContext - Data compression layer
+ */
+struct ZstrmContext
+{
+  struct ZstrmDirection read;  ///< Data being read and decompressed
+  struct ZstrmDirection write; ///< Data being compressed and written
+  struct Connection next_conn; ///< Underlying stream
+};
+
+/**
+ * zstrm_free - Free a compression layer
+ * @param zctx Compression layer
+ */
+static void zstrm_free(struct ZstrmContext **zctx)
+{
+  inflateEnd(&(*zctx)->read.z);
+  deflateEnd(&(*zctx)->write.z);
+  FREE(&(*zctx)->read.buf);
+  FREE(&(*zctx)->write.buf);
+  FREE(zctx);
+}
+
+/**
+ * zstrm_open - Unused - Implements Connection::conn_open()
+ *
+ * A compressed Connection is closed, and restored, before it can be reopened.
+ */
+static int zstrm_open(struct Connection *conn)
+{
+  return -1;
+}
+
+/**
+ * zstrm_close - Close a compressed Connection - Implements Connection::conn_close()
+ *
+ * The Connection's original callbacks are restored.
+ */
+static int zstrm_close(struct Connection *conn)
+{
+  struct ZstrmContext *zctx = conn->sockdata;
+
+  int rc = zctx->next_conn.conn_close(&zctx->next_conn);
+
+  conn->sockdata = zctx->next_conn.sockdata;
+  conn->conn_open = zctx->next_conn.conn_open;
+  conn->conn_read = zctx->next_conn.conn_read;
+  conn->conn_write = zctx->next_conn.conn_write;
+  conn->conn_poll = zctx->next_conn.conn_poll;
+  conn->conn_close = zctx->next_conn.conn_close;
+
+  mutt_debug(LL_DEBUG2, "read %lu->%lu, wrote %lu->%lu bytes\n",
+             zctx->read.z.total_in, zctx->read.z.total_out,
+             zctx->write.z.total_in, zctx->write.z.total_out);
+  zstrm_free(&zctx);
+
+  return rc;
+}
+
+/**
+ * zstrm_read - Read and decompress data - Implements Connection::conn_read()
+ */
+static int zstrm_read(struct Connection *conn, char *buf, size_t count)
+{
+  struct ZstrmContext *zctx = conn->sockdata;
+  z_stream *z = &zctx->read.z;
+
+  /* Hand over the byte that zstrm_poll() found first */
+  if (zctx->read.peeked && (count > 0))
+  {
+    buf[0] = zctx->read.peek;
+    zctx->read.peeked = false;
+    return 1;
+  }
+
+  if (zctx->read.stream_eof)
+    return 0;
+
+  z->next_out = (Bytef *) buf;
+  z->avail_out = (uInt) MIN(count, UINT_MAX);
+
+  while (true)
+  {
+    int zrc = inflate(z, Z_SYNC_FLUSH);
+    const int len = (int) ((Bytef *) z->next_out - (Bytef *) buf);
+
+    if (zrc == Z_STREAM_END)
+    {
+      zctx->read.stream_eof = true;
+      return len;
+    }
+
+    if ((zrc != Z_OK) && (zrc != Z_BUF_ERROR))
+    {
+      mutt_error(_("Error decompressing data from %s: %s"), conn->account.host,
+                 NONULL(z->msg));
+      return -1;
+    }
+
+    if (len > 0)
+    {
+      zctx->read.full = (z->avail_out == 0);
+      return len;
+    }
+
+    /* No output means that inflate() has consumed all its input */
+    if (zctx->read.conn_eof)
+      return 0;
+
+    int rc = zctx->next_conn.conn_read(&zctx->next_conn, zctx->read.buf, ZSTRM_BUFSIZE);
+    if (rc < 0)
+      return rc;
+    if (rc == 0)
+      zctx->read.conn_eof = true;
+
+    z->next_in = (Bytef *) zctx->read.buf;
+    z->avail_in = rc;
+  }
+}
+
+/**
+ * zstrm_poll - Check whether a read would block - Implements Connection::conn_poll()
+ */
+static int zstrm_poll(struct Connection *conn, time_t wait_secs)
+{
+  struct ZstrmContext *zctx = conn->sockdata;
+  z_stream *z = &zctx->read.z;
+
+  /* There may be data that has been received, but not yet decompressed.
+   * Only inflate() knows whether it will produce any output, so ask it for
+   * a byte and keep that for the next read. */
+  if (!zctx->read.peeked && !zctx->read.stream_eof &&
+      ((z->avail_in > 0) || zctx->read.full))
+  {
+    z->next_out = (Bytef *) &zctx->read.peek;
+    z->avail_out = 1;
+
+    int zrc = inflate(z, Z_SYNC_FLUSH);
+    if (z->avail_out == 0)
+      zctx->read.peeked = true;
+    else
+      zctx->read.full = false;
+
+    /* Let the read report the end of the stream, or the error */
+    if ((zrc != Z_OK) && (zrc != Z_BUF_ERROR))
+    {
+      if (zrc == Z_STREAM_END)
+        zctx->read.stream_eof = true;
+      return 1;
+    }
+  }
+
+  if (zctx->read.peeked)
+    return 1;
+
+  return zctx->next_conn.conn_poll(&zctx->next_conn, wait_secs);
+}
+
+/**
+ * zstrm_write - Compress and write data - Implements Connection::conn_write()
+ *
+ * The data is flushed, so that the server can act on it.
+ */
+static int zstrm_write(struct Connection *conn, const char *buf, size_t count)
+{
+  struct ZstrmContext *zctx = conn->sockdata;
+  z_stream *z = &zctx->write.z;
+
+  z->next_in = (Bytef *) buf;
+  z->avail_in = (uInt) MIN(count, UINT_MAX);
+
+  do
+  {
+    z->next_out = (Bytef *) zctx->write.buf;
+    z->avail_out = ZSTRM_BUFSIZE;
+
+    int zrc = deflate(z, Z_SYNC_FLUSH);
+    if ((zrc != Z_OK) && (zrc != Z_BUF_ERROR))
+    {
+      mutt_error(_("Error compressing data for %s: %s"), conn->account.host,
+                 NONULL(z->msg));
+      return -1;
+    }
+
+    const char *p = zctx->write.buf;
+    size_t len = ZSTRM_BUFSIZE - z->avail_out;
+    while (len > 0)
+    {
+      int rc = zctx->next_conn.conn_write(&zctx->next_conn, p, len);
+      if (rc < 0)
+        return -1;
+      p += rc;
+      len -= rc;
+    }
+  } while ((z->avail_in > 0) || (z->avail_out == 0));
+
+  return (int) (count - z->avail_in);
+}
+
+/**
+ * mutt_zstrm_wrap_conn - Wrap a compression layer around a Connection
+ * @param conn Connection to wrap
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * Everything written to, and read from, the Connection from now on is
+ * compressed.  Any data that has already been received is assumed to be
+ * compressed too.
+ */
+int mutt_zstrm_wrap_conn(struct Connection *conn)
+{
+  struct ZstrmContext *zctx = mutt_mem_calloc(1, sizeof(struct ZstrmContext));
+
+  /* A negative windowBits selects raw DEFLATE, without the zlib wrapper */
+  if ((inflateInit2(&zctx->read.z, -15) != Z_OK) ||
+      (deflateInit2(&zctx->write.z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                    Z_DEFAULT_STRATEGY) != Z_OK))
+  {
+    mutt_debug(LL_DEBUG1, "can't initialise zlib\n");
+    zstrm_free(&zctx);
+    return -1;
+  }
+
+  zctx->read.buf = mutt_mem_malloc(ZSTRM_BUFSIZE);
+  zctx->write.buf = mutt_mem_malloc(ZSTRM_BUFSIZE);
+
+  /* The Connection may have read ahead, past the end of the last reply */
+  if (conn->bufpos < conn->available)
+  {
+    const size_t len = MIN(conn->available - conn->bufpos, ZSTRM_BUFSIZE);
+    memcpy(zctx->read.buf, conn->inbuf + conn->bufpos, len);
+    zctx->read.z.next_in = (Bytef *) zctx->read.buf;
+    zctx->read.z.avail_in = len;
+    conn->bufpos = 0;
+    conn->available = 0;
+  }
+
+  zctx->next_conn = *conn;
+
+  conn->sockdata = zctx;
+  conn->conn_open = zstrm_open;
+  conn->conn_read = zstrm_read;
+  conn->conn_write = zstrm_write;
+  conn->conn_poll = zstrm_poll;
+  conn->conn_close = zstrm_close;
+
+  return 0;
+}
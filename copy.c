@@ -31,6 +31,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
 #include "mutt/mutt.h"
 #include "config/lib.h"
 #include "email/lib.h"
@@ -398,6 +399,7 @@ int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
  * * #CH_REORDER      output header in order specified by 'hdr_order'
  * * #CH_TXTPLAIN     generate text/plain MIME headers [hack alert.]
  * * #CH_UPDATE       write new Status: and X-Status:
+ * * #CH_PAD_STATUS   write Status: and X-Status: even if empty, padded to full width
  * * #CH_UPDATE_LEN   write new Content-Length: and Lines:
  * * #CH_XMIT         ignore Lines: and Content-Length:
  * * #CH_WEED         do header weeding
@@ -459,25 +461,22 @@ int mutt_copy_header(FILE *in, struct Email *e, FILE *out, int flags, const char
 
   if ((flags & CH_UPDATE) && (flags & CH_NOSTATUS) == 0)
   {
-    if (e->old || e->read)
-    {
-      fputs("Status: ", out);
-      if (e->read)
-        fputs("RO", out);
-      else if (e->old)
-        fputc('O', out);
-      fputc('\n', out);
-    }
-
-    if (e->flagged || e->replied)
-    {
-      fputs("X-Status: ", out);
-      if (e->replied)
-        fputc('A', out);
-      if (e->flagged)
-        fputc('F', out);
-      fputc('\n', out);
-    }
+    /* Padded fields leave room for the mbox code to update the flags in place */
+    const int width = (flags & CH_PAD_STATUS) ? 2 : 0;
+
+    if (e->old || e->read || width)
+      fprintf(out, "Status: %-*s\n", width, e->read ? "RO" : (e->old ? "O" : ""));
+
+    char xstatus[3];
+    int n = 0;
+    if (e->replied)
+      xstatus[n++] = 'A';
+    if (e->flagged)
+      xstatus[n++] = 'F';
+    xstatus[n] = '\0';
+
+    if ((n > 0) || width)
+      fprintf(out, "X-Status: %-*s\n", width, xstatus);
   }
 
   if (flags & CH_UPDATE_LEN && (flags & CH_NOLEN) == 0)
@@ -844,6 +843,56 @@ int mutt_copy_message_ctx(FILE *fpout, struct Mailbox *src, struct Email *e,
   return r;
 }
 
+/**
+ * link_message - Add a message to a Maildir by linking to its file
+ * @param dest    destination mailbox
+ * @param src     source mailbox
+ * @param e       Email being copied
+ * @param msg     New message, from mx_msg_open_new()
+ * @param flags   mutt_open_copy_message() flags
+ * @param chflags mutt_copy_header() flags
+ * @retval true  The new message is a link to the file of the source
+ * @retval false The message must be copied
+ *
+ * A raw copy between Maildirs only updates the Content-Length:, Lines: and
+ * status fields, which Maildir ignores, so both can share the same file.
+ */
+static bool link_message(struct Mailbox *dest, struct Mailbox *src, struct Email *e,
+                         struct Message *msg, int flags, int chflags)
+{
+  if ((src->magic != MUTT_MAILDIR) || (dest->magic != MUTT_MAILDIR) ||
+      !msg->path || !e->path)
+  {
+    return false;
+  }
+
+  if ((flags != 0) || ((chflags & ~(CH_UPDATE_LEN | CH_NOSTATUS)) != 0) ||
+      e->attach_del || (e->env && e->env->changed))
+  {
+    return false;
+  }
+
+  char path[PATH_MAX];
+  char tmp[PATH_MAX];
+  if ((snprintf(path, sizeof(path), "%s/%s", src->path, e->path) >= sizeof(path)) ||
+      (snprintf(tmp, sizeof(tmp), "%s.link", msg->path) >= sizeof(tmp)))
+  {
+    return false;
+  }
+
+  /* Replace the new, empty, file.  This fails across filesystems. */
+  if (link(path, tmp) != 0)
+    return false;
+  if (rename(tmp, msg->path) != 0)
+  {
+    unlink(tmp);
+    return false;
+  }
+
+  mutt_debug(LL_DEBUG2, "linked %s to %s\n", path, msg->path);
+  return true;
+}
+
 /**
  * append_message - appends a copy of the given message to a mailbox
  * @param dest    destination mailbox
@@ -873,7 +922,12 @@ static int append_message(struct Mailbox *dest, FILE *fpin, struct Mailbox *src,
   if (dest->magic == MUTT_MBOX || dest->magic == MUTT_MMDF)
     chflags |= CH_FROM | CH_FORCE_FROM;
   chflags |= (dest->magic == MUTT_MAILDIR ? CH_NOSTATUS : CH_UPDATE);
-  r = mutt_copy_message_fp(msg->fp, fpin, e, flags, chflags);
+  if (MboxPadStatus && (dest->magic == MUTT_MBOX || dest->magic == MUTT_MMDF))
+    chflags |= CH_PAD_STATUS;
+  if (link_message(dest, src, e, msg, flags, chflags))
+    r = 0;
+  else
+    r = mutt_copy_message_fp(msg->fp, fpin, e, flags, chflags);
   if (mx_msg_commit(dest, msg) != 0)
     r = -1;
 
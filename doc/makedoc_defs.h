@@ -66,6 +66,9 @@
 #ifndef HAVE_QDBM
 #define HAVE_QDBM
 #endif
+#ifndef USE_HCACHE_COMPRESSION
+#define USE_HCACHE_COMPRESSION
+#endif
 #ifndef HAVE_LIBIDN
 #define HAVE_LIBIDN
 #endif
@@ -75,6 +78,9 @@
 #ifndef USE_SASL
 #define USE_SASL
 #endif
+#ifndef USE_PTHREADS
+#define USE_PTHREADS
+#endif
 #ifndef USE_SIDEBAR
 #define USE_SIDEBAR
 #endif
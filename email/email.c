@@ -53,6 +53,7 @@ void mutt_email_free(struct Email **e)
   driver_tags_free(&(*e)->tags);
   if ((*e)->edata && (*e)->free_edata)
     (*e)->free_edata(&(*e)->edata);
+  FREE(&(*e)->hcache_deferred);
   FREE(e);
 }
 
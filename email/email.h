@@ -111,6 +111,8 @@ struct Email
 
   void *edata;                 /**< driver-specific data */
   void (*free_edata)(void **); /**< driver-specific data free function */
+
+  void *hcache_deferred; /**< header cache data not restored yet */
 };
 
 /**
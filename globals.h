@@ -227,6 +227,7 @@ WHERE bool Help;                           ///< Config: Display a help line with
 #ifdef USE_IMAP
 WHERE bool ImapCheckSubscribed;            ///< Config: (imap) When opening a mailbox, ask the server for a list of subscribed folders
 WHERE bool ImapCondStore;                  ///< Config: (imap) Enable the CONDSTORE extension
+WHERE bool ImapDeflate;                    ///< Config: (imap) Compress network traffic
 WHERE bool ImapListSubscribed;             ///< Config: (imap) When browsing a mailbox, only display subscribed folders
 WHERE bool ImapPassive;                    ///< Config: (imap) Reuse an existing IMAP connection to check for new mail
 WHERE bool ImapPeek;                       ///< Config: (imap) Don't mark messages as read when fetching them from the server
@@ -245,6 +246,7 @@ WHERE bool SslVerifyPartialChains;         ///< Config: (ssl) Allow verification
 WHERE bool MailCheckRecent;                ///< Config: Notify the user about new mail since the last time the mailbox was opened
 WHERE bool MaildirTrash;                   ///< Config: Use the maildir 'trashed' flag, rather than deleting
 WHERE bool Markers;                        ///< Config: Display a '+' at the beginning of wrapped lines in the pager
+WHERE bool MboxPadStatus;                  ///< Config: (mbox,mmdf) Leave room to update the flags of messages in place
 #if defined(USE_IMAP) || defined(USE_POP)
 WHERE bool MessageCacheClean;              ///< Config: (imap/pop) Clean out obsolete entries from the message cache
 #endif
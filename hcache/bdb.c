@@ -152,7 +152,7 @@ fail_close:
 /**
  * hcache_bdb_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen)
+static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen, size_t *dlen)
 {
   DBT dkey;
   DBT data;
@@ -168,6 +168,7 @@ static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen)
 
   ctx->db->get(ctx->db, NULL, &dkey, &data, 0);
 
+  *dlen = data.size;
   return data.data;
 }
 
@@ -218,6 +219,33 @@ static int hcache_bdb_delete(void *vctx, const char *key, size_t keylen)
   return ctx->db->del(ctx->db, NULL, &dkey, 0);
 }
 
+/**
+ * hcache_bdb_begin - Implements HcacheOps::begin()
+ *
+ * The environment isn't transactional; updates live in the memory pool
+ * until commit() flushes them.
+ */
+static int hcache_bdb_begin(void *vctx)
+{
+  if (!vctx)
+    return -1;
+
+  return 0;
+}
+
+/**
+ * hcache_bdb_commit - Implements HcacheOps::commit()
+ */
+static int hcache_bdb_commit(void *vctx)
+{
+  if (!vctx)
+    return -1;
+
+  struct HcacheDbCtx *ctx = vctx;
+
+  return ctx->db->sync(ctx->db, 0);
+}
+
 /**
  * hcache_bdb_close - Implements HcacheOps::close()
  */
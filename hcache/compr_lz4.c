@@ -0,0 +1,172 @@
+/**
+ * @file
+ * LZ4 header cache compression
+ *
+ * @authors
+ * Copyright (C) 2019 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hc_compr_lz4 LZ4
+ *
+ * Compress header cache records with LZ4, optionally primed with a
+ * dictionary.
+ *
+ * The level is LZ4's acceleration factor: higher levels are faster, but
+ * compress less.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <lz4.h>
+#include "mutt/mutt.h"
+#include "compress.h"
+
+/**
+ * struct ComprLz4Ctx - Private LZ4 Compression Context
+ */
+struct ComprLz4Ctx
+{
+  LZ4_stream_t dict_strm; ///< Stream with the dictionary loaded
+  LZ4_stream_t strm;      ///< Working copy of dict_strm
+  const char *dict;       ///< Dictionary
+  size_t dict_len;        ///< Length of the dictionary
+  short level;            ///< Acceleration factor
+  void *buf;              ///< Temporary buffer for compressed data
+  size_t buf_len;         ///< Size of the buffer
+};
+
+/**
+ * compr_lz4_open - Implements ComprOps::open()
+ */
+static void *compr_lz4_open(short level)
+{
+  struct ComprLz4Ctx *ctx = mutt_mem_calloc(1, sizeof(struct ComprLz4Ctx));
+
+  ctx->level = level;
+  return ctx;
+}
+
+/**
+ * compr_lz4_compress - Implements ComprOps::compress()
+ */
+static void *compr_lz4_compress(void *cctx, const char *data, size_t dlen,
+                                size_t *clen, bool use_dict)
+{
+  if (!cctx || (dlen > LZ4_MAX_INPUT_SIZE))
+    return NULL;
+
+  struct ComprLz4Ctx *ctx = cctx;
+
+  size_t len = LZ4_compressBound(dlen);
+  if (ctx->buf_len < len)
+  {
+    mutt_mem_realloc(&ctx->buf, len);
+    ctx->buf_len = len;
+  }
+
+  int rc;
+  if (use_dict)
+  {
+    /* Loading the dictionary is costly, so copy a stream that already has it */
+    memcpy(&ctx->strm, &ctx->dict_strm, sizeof(LZ4_stream_t));
+    rc = LZ4_compress_fast_continue(&ctx->strm, data, ctx->buf, dlen, ctx->buf_len, ctx->level);
+  }
+  else
+  {
+    rc = LZ4_compress_fast(data, ctx->buf, dlen, ctx->buf_len, ctx->level);
+  }
+
+  if (rc <= 0)
+    return NULL;
+
+  *clen = rc;
+  return ctx->buf;
+}
+
+/**
+ * compr_lz4_decompress - Implements ComprOps::decompress()
+ */
+static bool compr_lz4_decompress(void *cctx, const char *cbuf, size_t clen,
+                                 char *data, size_t dlen, bool use_dict)
+{
+  if (!cctx)
+    return false;
+
+  struct ComprLz4Ctx *ctx = cctx;
+
+  int rc;
+  if (use_dict)
+    rc = LZ4_decompress_safe_usingDict(cbuf, data, clen, dlen, ctx->dict, ctx->dict_len);
+  else
+    rc = LZ4_decompress_safe(cbuf, data, clen, dlen);
+
+  return (rc >= 0) && ((size_t) rc == dlen);
+}
+
+/**
+ * compr_lz4_set_dict - Implements ComprOps::set_dict()
+ */
+static bool compr_lz4_set_dict(void *cctx, const void *dict, size_t dlen)
+{
+  if (!cctx)
+    return false;
+
+  struct ComprLz4Ctx *ctx = cctx;
+
+  /* LZ4 only ever uses the last 64KB of a dictionary */
+  if (dlen > 65536)
+  {
+    dict = (const char *) dict + dlen - 65536;
+    dlen = 65536;
+  }
+
+  ctx->dict = dict;
+  ctx->dict_len = dlen;
+  LZ4_resetStream(&ctx->dict_strm);
+  LZ4_loadDict(&ctx->dict_strm, dict, dlen);
+  return true;
+}
+
+/**
+ * compr_lz4_train - Implements ComprOps::train()
+ *
+ * LZ4 has no trainer; the most recent samples make a good dictionary.
+ */
+static size_t compr_lz4_train(void *dict, size_t dlen, const void *samples,
+                              const size_t *sizes, unsigned int count)
+{
+  return 0;
+}
+
+/**
+ * compr_lz4_close - Implements ComprOps::close()
+ */
+static void compr_lz4_close(void **cctx)
+{
+  if (!cctx || !*cctx)
+    return;
+
+  struct ComprLz4Ctx *ctx = *cctx;
+
+  FREE(&ctx->buf);
+  FREE(cctx);
+}
+
+COMPRESS_OPS(lz4, 1, 12)
@@ -0,0 +1,181 @@
+/**
+ * @file
+ * Zlib header cache compression
+ *
+ * @authors
+ * Copyright (C) 2019 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hc_compr_zlib Zlib
+ *
+ * Compress header cache records with raw deflate, optionally primed with a
+ * preset dictionary.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <zlib.h>
+#include "mutt/mutt.h"
+#include "compress.h"
+
+/**
+ * struct ComprZlibCtx - Private Zlib Compression Context
+ */
+struct ComprZlibCtx
+{
+  z_stream cstrm;    ///< Deflate stream
+  z_stream dstrm;    ///< Inflate stream
+  const void *dict;  ///< Preset dictionary
+  size_t dict_len;   ///< Length of the dictionary
+  void *buf;         ///< Temporary buffer for compressed data
+  size_t buf_len;    ///< Size of the buffer
+};
+
+/**
+ * compr_zlib_open - Implements ComprOps::open()
+ */
+static void *compr_zlib_open(short level)
+{
+  struct ComprZlibCtx *ctx = mutt_mem_calloc(1, sizeof(struct ComprZlibCtx));
+
+  /* Raw deflate: the record length is known, so skip the zlib wrapper */
+  if (deflateInit2(&ctx->cstrm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    FREE(&ctx);
+    return NULL;
+  }
+
+  if (inflateInit2(&ctx->dstrm, -15) != Z_OK)
+  {
+    deflateEnd(&ctx->cstrm);
+    FREE(&ctx);
+    return NULL;
+  }
+
+  return ctx;
+}
+
+/**
+ * compr_zlib_compress - Implements ComprOps::compress()
+ */
+static void *compr_zlib_compress(void *cctx, const char *data, size_t dlen,
+                                 size_t *clen, bool use_dict)
+{
+  if (!cctx)
+    return NULL;
+
+  struct ComprZlibCtx *ctx = cctx;
+
+  if (deflateReset(&ctx->cstrm) != Z_OK)
+    return NULL;
+
+  if (use_dict && (deflateSetDictionary(&ctx->cstrm, ctx->dict, ctx->dict_len) != Z_OK))
+    return NULL;
+
+  uLong len = deflateBound(&ctx->cstrm, dlen);
+  if (ctx->buf_len < len)
+  {
+    mutt_mem_realloc(&ctx->buf, len);
+    ctx->buf_len = len;
+  }
+
+  ctx->cstrm.next_in = (Bytef *) data;
+  ctx->cstrm.avail_in = dlen;
+  ctx->cstrm.next_out = ctx->buf;
+  ctx->cstrm.avail_out = ctx->buf_len;
+
+  if (deflate(&ctx->cstrm, Z_FINISH) != Z_STREAM_END)
+    return NULL;
+
+  *clen = ctx->cstrm.total_out;
+  return ctx->buf;
+}
+
+/**
+ * compr_zlib_decompress - Implements ComprOps::decompress()
+ */
+static bool compr_zlib_decompress(void *cctx, const char *cbuf, size_t clen,
+                                  char *data, size_t dlen, bool use_dict)
+{
+  if (!cctx)
+    return false;
+
+  struct ComprZlibCtx *ctx = cctx;
+
+  if (inflateReset(&ctx->dstrm) != Z_OK)
+    return false;
+
+  /* Raw inflate never asks for the dictionary, so it must be set up front */
+  if (use_dict && (inflateSetDictionary(&ctx->dstrm, ctx->dict, ctx->dict_len) != Z_OK))
+    return false;
+
+  ctx->dstrm.next_in = (Bytef *) cbuf;
+  ctx->dstrm.avail_in = clen;
+  ctx->dstrm.next_out = (Bytef *) data;
+  ctx->dstrm.avail_out = dlen;
+
+  if (inflate(&ctx->dstrm, Z_FINISH) != Z_STREAM_END)
+    return false;
+
+  return ctx->dstrm.total_out == dlen;
+}
+
+/**
+ * compr_zlib_set_dict - Implements ComprOps::set_dict()
+ */
+static bool compr_zlib_set_dict(void *cctx, const void *dict, size_t dlen)
+{
+  if (!cctx)
+    return false;
+
+  struct ComprZlibCtx *ctx = cctx;
+
+  ctx->dict = dict;
+  ctx->dict_len = dlen;
+  return true;
+}
+
+/**
+ * compr_zlib_train - Implements ComprOps::train()
+ *
+ * Zlib has no trainer; the most recent samples make a good preset dictionary.
+ */
+static size_t compr_zlib_train(void *dict, size_t dlen, const void *samples,
+                               const size_t *sizes, unsigned int count)
+{
+  return 0;
+}
+
+/**
+ * compr_zlib_close - Implements ComprOps::close()
+ */
+static void compr_zlib_close(void **cctx)
+{
+  if (!cctx || !*cctx)
+    return;
+
+  struct ComprZlibCtx *ctx = *cctx;
+
+  deflateEnd(&ctx->cstrm);
+  inflateEnd(&ctx->dstrm);
+  FREE(&ctx->buf);
+  FREE(cctx);
+}
+
+COMPRESS_OPS(zlib, 1, 9)
@@ -0,0 +1,179 @@
+/**
+ * @file
+ * Zstandard header cache compression
+ *
+ * @authors
+ * Copyright (C) 2019 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hc_compr_zstd Zstandard
+ *
+ * Compress header cache records with Zstandard, optionally using a dictionary
+ * trained on the records of the mailbox.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <zdict.h>
+#include <zstd.h>
+#include "mutt/mutt.h"
+#include "compress.h"
+
+/**
+ * struct ComprZstdCtx - Private Zstandard Compression Context
+ */
+struct ComprZstdCtx
+{
+  ZSTD_CCtx *cctx;   ///< Compression context
+  ZSTD_DCtx *dctx;   ///< Decompression context
+  ZSTD_CDict *cdict; ///< Digested dictionary for compression
+  ZSTD_DDict *ddict; ///< Digested dictionary for decompression
+  short level;       ///< Compression level
+  void *buf;         ///< Temporary buffer for compressed data
+  size_t buf_len;    ///< Size of the buffer
+};
+
+/**
+ * compr_zstd_open - Implements ComprOps::open()
+ */
+static void *compr_zstd_open(short level)
+{
+  struct ComprZstdCtx *ctx = mutt_mem_calloc(1, sizeof(struct ComprZstdCtx));
+
+  ctx->cctx = ZSTD_createCCtx();
+  ctx->dctx = ZSTD_createDCtx();
+  if (!ctx->cctx || !ctx->dctx)
+  {
+    ZSTD_freeCCtx(ctx->cctx);
+    ZSTD_freeDCtx(ctx->dctx);
+    FREE(&ctx);
+    return NULL;
+  }
+
+  ctx->level = level;
+  return ctx;
+}
+
+/**
+ * compr_zstd_compress - Implements ComprOps::compress()
+ */
+static void *compr_zstd_compress(void *cctx, const char *data, size_t dlen,
+                                 size_t *clen, bool use_dict)
+{
+  if (!cctx)
+    return NULL;
+
+  struct ComprZstdCtx *ctx = cctx;
+
+  size_t len = ZSTD_compressBound(dlen);
+  if (ctx->buf_len < len)
+  {
+    mutt_mem_realloc(&ctx->buf, len);
+    ctx->buf_len = len;
+  }
+
+  size_t rc;
+  if (use_dict)
+    rc = ZSTD_compress_usingCDict(ctx->cctx, ctx->buf, ctx->buf_len, data, dlen, ctx->cdict);
+  else
+    rc = ZSTD_compressCCtx(ctx->cctx, ctx->buf, ctx->buf_len, data, dlen, ctx->level);
+
+  if (ZSTD_isError(rc))
+    return NULL;
+
+  *clen = rc;
+  return ctx->buf;
+}
+
+/**
+ * compr_zstd_decompress - Implements ComprOps::decompress()
+ */
+static bool compr_zstd_decompress(void *cctx, const char *cbuf, size_t clen,
+                                  char *data, size_t dlen, bool use_dict)
+{
+  if (!cctx)
+    return false;
+
+  struct ComprZstdCtx *ctx = cctx;
+
+  if (use_dict && !ctx->ddict)
+    return false;
+
+  size_t rc;
+  if (use_dict)
+    rc = ZSTD_decompress_usingDDict(ctx->dctx, data, dlen, cbuf, clen, ctx->ddict);
+  else
+    rc = ZSTD_decompressDCtx(ctx->dctx, data, dlen, cbuf, clen);
+
+  return !ZSTD_isError(rc) && (rc == dlen);
+}
+
+/**
+ * compr_zstd_set_dict - Implements ComprOps::set_dict()
+ */
+static bool compr_zstd_set_dict(void *cctx, const void *dict, size_t dlen)
+{
+  if (!cctx)
+    return false;
+
+  struct ComprZstdCtx *ctx = cctx;
+
+  ZSTD_freeCDict(ctx->cdict);
+  ZSTD_freeDDict(ctx->ddict);
+  ctx->cdict = ZSTD_createCDict(dict, dlen, ctx->level);
+  ctx->ddict = ZSTD_createDDict(dict, dlen);
+
+  return ctx->cdict && ctx->ddict;
+}
+
+/**
+ * compr_zstd_train - Implements ComprOps::train()
+ */
+static size_t compr_zstd_train(void *dict, size_t dlen, const void *samples,
+                               const size_t *sizes, unsigned int count)
+{
+  size_t rc = ZDICT_trainFromBuffer(dict, dlen, samples, sizes, count);
+  if (ZDICT_isError(rc))
+  {
+    mutt_debug(LL_DEBUG2, "zstd dictionary training failed: %s\n", ZDICT_getErrorName(rc));
+    return 0;
+  }
+
+  return rc;
+}
+
+/**
+ * compr_zstd_close - Implements ComprOps::close()
+ */
+static void compr_zstd_close(void **cctx)
+{
+  if (!cctx || !*cctx)
+    return;
+
+  struct ComprZstdCtx *ctx = *cctx;
+
+  ZSTD_freeCDict(ctx->cdict);
+  ZSTD_freeDDict(ctx->ddict);
+  ZSTD_freeCCtx(ctx->cctx);
+  ZSTD_freeDCtx(ctx->dctx);
+  FREE(&ctx->buf);
+  FREE(cctx);
+}
+
+COMPRESS_OPS(zstd, 1, 22)
@@ -0,0 +1,444 @@
+/**
+ * @file
+ * Header cache compression
+ *
+ * @authors
+ * Copyright (C) 2019 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hc_compress Header cache compression
+ *
+ * Compress the records of the header cache, independently of the backend.
+ *
+ * Only the part of a record following the validity datum and the crc is
+ * compressed, so that both can still be checked without decompressing.  A
+ * compressed record looks like:
+ *
+ * | Field                  | Size               |
+ * | :--------------------- | :----------------- |
+ * | union Validate         | Uncompressed       |
+ * | crc                    | Uncompressed       |
+ * | HcacheComprHeader      | Uncompressed       |
+ * | Email, sections        | Compressed         |
+ *
+ * The records of a cache file are very similar to each other, so the first
+ * records are kept as samples to build a dictionary.  Once trained, the
+ * dictionary is stored alongside the records, and used for all the records
+ * compressed after it.
+ *
+ * The header of each record holds a checksum of the dictionary it was
+ * compressed with.  A record whose dictionary has since been replaced is
+ * treated as a miss.
+ *
+ * | File                | Description            |
+ * | :------------------ | :--------------------- |
+ * | hcache/compr_lz4.c  | @subpage hc_compr_lz4  |
+ * | hcache/compr_zlib.c | @subpage hc_compr_zlib |
+ * | hcache/compr_zstd.c | @subpage hc_compr_zstd |
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "mutt/mutt.h"
+#include "compress.h"
+#include "hcache.h"
+
+/* The number of records used to train the dictionary */
+#define HC_DICT_SAMPLES 128
+/* The maximum size of a dictionary */
+#define HC_DICT_SIZE 16384
+/* The maximum size of a decompressed record */
+#define HC_RECORD_MAX (16 * 1024 * 1024)
+
+#define COMPRESS_BACKEND(name) extern const struct ComprOps compr_##name##_ops;
+COMPRESS_BACKEND(lz4)
+COMPRESS_BACKEND(zlib)
+COMPRESS_BACKEND(zstd)
+#undef COMPRESS_BACKEND
+
+/**
+ * compr_ops - Compression implementations
+ */
+const struct ComprOps *compr_ops[] = {
+#ifdef HAVE_ZSTD
+  &compr_zstd_ops,
+#endif
+#ifdef HAVE_ZLIB
+  &compr_zlib_ops,
+#endif
+#ifdef HAVE_LZ4
+  &compr_lz4_ops,
+#endif
+  NULL,
+};
+
+/**
+ * struct HcacheComprHeader - Header of a compressed record
+ */
+struct HcacheComprHeader
+{
+  unsigned int dlen; ///< Length of the uncompressed data
+  unsigned int clen; ///< Length of the compressed data
+  unsigned int dict; ///< Id of the dictionary used, 0 if none
+};
+
+/**
+ * struct HcacheCompr - Compression state of a header cache
+ */
+struct HcacheCompr
+{
+  const struct ComprOps *ops; ///< Compression implementation
+  void *cctx;                 ///< Backend-specific context
+  char *dict;                 ///< Dictionary, or NULL if not trained yet
+  size_t dict_len;            ///< Length of the dictionary
+  unsigned int dict_id;       ///< Checksum of the dictionary, never 0
+  char *samples;              ///< Records kept to train the dictionary
+  size_t samples_len;         ///< Total length of the samples
+  size_t sizes[HC_DICT_SAMPLES]; ///< Length of each sample
+  unsigned int num_samples;   ///< Number of samples
+  char *buf;                  ///< Buffer for decompressed records
+  size_t buf_len;             ///< Size of the decompression buffer
+  char *zbuf;                 ///< Buffer for compressed records
+  size_t zbuf_len;            ///< Size of the compression buffer
+};
+
+/**
+ * compr_get_ops - Get the API functions for a compression method
+ * @param name Name of the compression method
+ * @retval ptr  Set of function pointers
+ * @retval NULL No such method
+ */
+static const struct ComprOps *compr_get_ops(const char *name)
+{
+  if (!name || !*name)
+    return NULL;
+
+  const struct ComprOps **ops = compr_ops;
+  for (; *ops; ++ops)
+    if (strcmp(name, (*ops)->name) == 0)
+      break;
+
+  return *ops;
+}
+
+/**
+ * compr_buf_ensure - Make sure a buffer is big enough
+ * @param buf  Buffer to grow
+ * @param len  Current size of the buffer
+ * @param size Minimum size
+ * @retval ptr The buffer
+ */
+static char *compr_buf_ensure(char **buf, size_t *len, size_t size)
+{
+  if (*len < size)
+  {
+    mutt_mem_realloc(buf, size);
+    *len = size;
+  }
+  return *buf;
+}
+
+/**
+ * hcache_compr_open - Set up the compression of a header cache
+ * @param name  Name of the compression method
+ * @param level Compression level, clamped to the method's range
+ * @retval ptr  Compression state
+ * @retval NULL Unknown method, or error
+ */
+struct HcacheCompr *hcache_compr_open(const char *name, short level)
+{
+  const struct ComprOps *ops = compr_get_ops(name);
+  if (!ops)
+    return NULL;
+
+  if (level < ops->min_level)
+    level = ops->min_level;
+  if (level > ops->max_level)
+    level = ops->max_level;
+
+  void *cctx = ops->open(level);
+  if (!cctx)
+  {
+    mutt_debug(LL_DEBUG1, "%s: can't open compression context\n", ops->name);
+    return NULL;
+  }
+
+  struct HcacheCompr *hcc = mutt_mem_calloc(1, sizeof(struct HcacheCompr));
+  hcc->ops = ops;
+  hcc->cctx = cctx;
+  return hcc;
+}
+
+/**
+ * hcache_compr_close - Free the compression state of a header cache
+ * @param hcc Compression state
+ */
+void hcache_compr_close(struct HcacheCompr **hcc)
+{
+  if (!hcc || !*hcc)
+    return;
+
+  (*hcc)->ops->close(&(*hcc)->cctx);
+  FREE(&(*hcc)->dict);
+  FREE(&(*hcc)->samples);
+  FREE(&(*hcc)->buf);
+  FREE(&(*hcc)->zbuf);
+  FREE(hcc);
+}
+
+/**
+ * hcache_compr_name - Get the name of the compression method
+ * @param hcc Compression state
+ * @retval ptr Name of the method
+ */
+const char *hcache_compr_name(struct HcacheCompr *hcc)
+{
+  return hcc->ops->name;
+}
+
+/**
+ * hcache_compr_compress - Compress a record
+ * @param[in]  hcc  Compression state
+ * @param[in]  data Record, as created by mutt_hcache_dump()
+ * @param[in]  dlen Length of the record
+ * @param[out] clen Length of the compressed record
+ * @retval ptr  Compressed record, owned by @a hcc
+ * @retval NULL Error
+ */
+void *hcache_compr_compress(struct HcacheCompr *hcc, const void *data, size_t dlen, size_t *clen)
+{
+  const size_t hlen = sizeof(union Validate) + sizeof(unsigned int);
+  if (dlen < hlen)
+    return NULL;
+
+  const bool use_dict = hcc->dict;
+  size_t zlen = 0;
+  void *z = hcc->ops->compress(hcc->cctx, (const char *) data + hlen,
+                               dlen - hlen, &zlen, use_dict);
+  if (!z)
+    return NULL;
+
+  struct HcacheComprHeader hdr = { dlen - hlen, zlen, use_dict ? hcc->dict_id : 0 };
+
+  char *buf = compr_buf_ensure(&hcc->zbuf, &hcc->zbuf_len, hlen + sizeof(hdr) + zlen);
+  memcpy(buf, data, hlen);
+  memcpy(buf + hlen, &hdr, sizeof(hdr));
+  memcpy(buf + hlen + sizeof(hdr), z, zlen);
+
+  *clen = hlen + sizeof(hdr) + zlen;
+  return buf;
+}
+
+/**
+ * hcache_compr_decompress - Decompress a record
+ * @param hcc   Compression state
+ * @param cdata Compressed record, as created by hcache_compr_compress()
+ * @param clen  Length of the compressed record
+ * @retval ptr  Record, owned by @a hcc
+ * @retval NULL Error
+ *
+ * The record stays valid until the next call.
+ *
+ * Neither raw deflate nor lz4 can tell that the data was compressed with
+ * another dictionary, so a record is only decompressed if it was compressed
+ * with the current one.
+ */
+void *hcache_compr_decompress(struct HcacheCompr *hcc, const void *cdata, size_t clen)
+{
+  const size_t hlen = sizeof(union Validate) + sizeof(unsigned int);
+  struct HcacheComprHeader hdr;
+
+  if (clen < hlen + sizeof(hdr))
+    return NULL;
+
+  memcpy(&hdr, (const char *) cdata + hlen, sizeof(hdr));
+  if ((hdr.clen != clen - hlen - sizeof(hdr)) || (hdr.dlen == 0) ||
+      (hdr.dlen > HC_RECORD_MAX))
+  {
+    mutt_debug(LL_DEBUG1, "bad compressed record: %u->%u bytes in %zu\n",
+               hdr.clen, hdr.dlen, clen);
+    return NULL;
+  }
+
+  const bool use_dict = (hdr.dict != 0);
+  if (use_dict && (hdr.dict != hcc->dict_id))
+  {
+    mutt_debug(LL_DEBUG1, "record needs another dictionary\n");
+    return NULL;
+  }
+
+  char *buf = compr_buf_ensure(&hcc->buf, &hcc->buf_len, hlen + hdr.dlen);
+  memcpy(buf, cdata, hlen);
+  if (!hcc->ops->decompress(hcc->cctx, (const char *) cdata + hlen + sizeof(hdr),
+                            hdr.clen, buf + hlen, hdr.dlen, use_dict))
+  {
+    mutt_debug(LL_DEBUG1, "%s: can't decompress record\n", hcc->ops->name);
+    return NULL;
+  }
+
+  return buf;
+}
+
+/**
+ * hcache_compr_owns - Was the data returned by hcache_compr_decompress()?
+ * @param hcc  Compression state
+ * @param data Data to check
+ * @retval true The data belongs to the compression state
+ */
+bool hcache_compr_owns(struct HcacheCompr *hcc, const void *data)
+{
+  return hcc && data && (data == hcc->buf);
+}
+
+/**
+ * hcache_compr_set_dict - Set the dictionary
+ * @param hcc  Compression state
+ * @param dict Dictionary
+ * @param dlen Length of the dictionary
+ * @retval true Success
+ */
+bool hcache_compr_set_dict(struct HcacheCompr *hcc, const void *dict, size_t dlen)
+{
+  if (!dict || (dlen == 0) || (dlen > HC_DICT_SIZE) || hcc->dict)
+    return false;
+
+  hcc->dict = mutt_mem_malloc(dlen);
+  memcpy(hcc->dict, dict, dlen);
+  hcc->dict_len = dlen;
+
+  unsigned int digest[4];
+  mutt_md5_bytes(hcc->dict, hcc->dict_len, digest);
+  hcc->dict_id = digest[0] ? digest[0] : 1;
+
+  if (!hcc->ops->set_dict(hcc->cctx, hcc->dict, hcc->dict_len))
+  {
+    mutt_debug(LL_DEBUG1, "%s: can't use dictionary\n", hcc->ops->name);
+    FREE(&hcc->dict);
+    hcc->dict_len = 0;
+    hcc->dict_id = 0;
+    return false;
+  }
+
+  FREE(&hcc->samples);
+  hcc->samples_len = 0;
+  hcc->num_samples = 0;
+  return true;
+}
+
+/**
+ * hcache_compr_has_dict - Does the compression state have a dictionary?
+ * @param hcc Compression state
+ * @retval true It does
+ */
+bool hcache_compr_has_dict(struct HcacheCompr *hcc)
+{
+  return hcc->dict;
+}
+
+/**
+ * hcache_compr_add_sample - Keep a record to train the dictionary
+ * @param hcc  Compression state
+ * @param data Record, as created by mutt_hcache_dump()
+ * @param dlen Length of the record
+ * @retval true Enough samples have been collected, see hcache_compr_train()
+ */
+bool hcache_compr_add_sample(struct HcacheCompr *hcc, const void *data, size_t dlen)
+{
+  const size_t hlen = sizeof(union Validate) + sizeof(unsigned int);
+
+  if (hcc->dict || (dlen <= hlen))
+    return false;
+
+  if (hcc->num_samples < HC_DICT_SAMPLES)
+  {
+    dlen -= hlen;
+    mutt_mem_realloc(&hcc->samples, hcc->samples_len + dlen);
+    memcpy(hcc->samples + hcc->samples_len, (const char *) data + hlen, dlen);
+    hcc->samples_len += dlen;
+    hcc->sizes[hcc->num_samples++] = dlen;
+  }
+
+  return hcc->num_samples == HC_DICT_SAMPLES;
+}
+
+/**
+ * hcache_compr_train - Build a dictionary from the samples
+ * @param[in]  hcc  Compression state
+ * @param[out] dlen Length of the dictionary
+ * @retval ptr  Dictionary, to be freed by the caller
+ * @retval NULL Error
+ *
+ * If the method can't train a dictionary, the most recent samples are used
+ * as a raw dictionary.
+ */
+void *hcache_compr_train(struct HcacheCompr *hcc, size_t *dlen)
+{
+  if (hcc->num_samples == 0)
+    return NULL;
+
+  char *dict = mutt_mem_malloc(HC_DICT_SIZE);
+  size_t len = hcc->ops->train(dict, HC_DICT_SIZE, hcc->samples, hcc->sizes,
+                               hcc->num_samples);
+  if (len == 0)
+  {
+    /* The end of a raw dictionary is the most valuable part */
+    len = MIN(hcc->samples_len, HC_DICT_SIZE);
+    memcpy(dict, hcc->samples + hcc->samples_len - len, len);
+  }
+
+  mutt_debug(LL_DEBUG2, "%s: trained a %zu byte dictionary from %u records\n",
+             hcc->ops->name, len, hcc->num_samples);
+  *dlen = len;
+  return dict;
+}
+
+/**
+ * mutt_hcache_compress_list - Get a list of compression method names
+ * @retval ptr Comma-space-separated list of names
+ *
+ * The caller should free the string.
+ */
+const char *mutt_hcache_compress_list(void)
+{
+  char tmp[STRING] = { 0 };
+  const struct ComprOps **ops = compr_ops;
+  size_t len = 0;
+
+  for (; *ops; ++ops)
+  {
+    if (len != 0)
+    {
+      len += snprintf(tmp + len, STRING - len, ", ");
+    }
+    len += snprintf(tmp + len, STRING - len, "%s", (*ops)->name);
+  }
+
+  return mutt_str_strdup(tmp);
+}
+
+/**
+ * mutt_hcache_is_valid_compression - Is this a valid compression method name?
+ * @param s Name to check
+ * @retval true If valid
+ */
+bool mutt_hcache_is_valid_compression(const char *s)
+{
+  return compr_get_ops(s);
+}
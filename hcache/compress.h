@@ -0,0 +1,129 @@
+/**
+ * @file
+ * API for the header cache compression
+ *
+ * @authors
+ * Copyright (C) 2019 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_HCACHE_COMPRESS_H
+#define MUTT_HCACHE_COMPRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * struct ComprOps - Header Cache Compression API
+ */
+struct ComprOps
+{
+  /**
+   * name - Compression name
+   */
+  const char *name;
+  /**
+   * min_level - Minimum compression level
+   */
+  short min_level;
+  /**
+   * max_level - Maximum compression level
+   */
+  short max_level;
+  /**
+   * open - backend-specific routine to create a compression context
+   * @param level Compression level, between min_level and max_level
+   * @retval ptr  Success, backend-specific context
+   * @retval NULL Otherwise
+   */
+  void *(*open)(short level);
+  /**
+   * compress - backend-specific routine to compress a block of data
+   * @param[in]  cctx     The backend-specific context retrieved via open()
+   * @param[in]  data     Data to compress
+   * @param[in]  dlen     Length of the data
+   * @param[out] clen     Length of the compressed data
+   * @param[in]  use_dict Use the dictionary set by set_dict()
+   * @retval ptr  Success, the compressed data, owned by the context
+   * @retval NULL Otherwise
+   */
+  void *(*compress)(void *cctx, const char *data, size_t dlen, size_t *clen, bool use_dict);
+  /**
+   * decompress - backend-specific routine to decompress a block of data
+   * @param cctx     The backend-specific context retrieved via open()
+   * @param cbuf     Compressed data
+   * @param clen     Length of the compressed data
+   * @param data     Buffer for the decompressed data
+   * @param dlen     Exact length of the decompressed data
+   * @param use_dict The data was compressed with the dictionary
+   * @retval true Success
+   */
+  bool (*decompress)(void *cctx, const char *cbuf, size_t clen, char *data,
+                     size_t dlen, bool use_dict);
+  /**
+   * set_dict - backend-specific routine to set the dictionary
+   * @param cctx The backend-specific context retrieved via open()
+   * @param dict Dictionary, it must stay valid until close()
+   * @param dlen Length of the dictionary
+   * @retval true Success
+   */
+  bool (*set_dict)(void *cctx, const void *dict, size_t dlen);
+  /**
+   * train - backend-specific routine to build a dictionary from samples
+   * @param dict     Buffer for the dictionary
+   * @param dlen     Size of the buffer
+   * @param samples  Samples, one after the other
+   * @param sizes    Size of each sample
+   * @param count    Number of samples
+   * @retval num Length of the dictionary
+   * @retval 0   The raw samples should be used as the dictionary
+   */
+  size_t (*train)(void *dict, size_t dlen, const void *samples,
+                  const size_t *sizes, unsigned int count);
+  /**
+   * close - backend-specific routine to free a compression context
+   * @param[out] cctx The backend-specific context retrieved via open()
+   */
+  void (*close)(void **cctx);
+};
+
+#define COMPRESS_OPS(_name, _min_level, _max_level)                            \
+  const struct ComprOps compr_##_name##_ops = {                                \
+    .name       = #_name,                                                      \
+    .min_level  = _min_level,                                                  \
+    .max_level  = _max_level,                                                  \
+    .open       = compr_##_name##_open,                                        \
+    .compress   = compr_##_name##_compress,                                    \
+    .decompress = compr_##_name##_decompress,                                  \
+    .set_dict   = compr_##_name##_set_dict,                                    \
+    .train      = compr_##_name##_train,                                       \
+    .close      = compr_##_name##_close,                                       \
+  };
+
+struct HcacheCompr;
+
+struct HcacheCompr *hcache_compr_open(const char *name, short level);
+void                hcache_compr_close(struct HcacheCompr **hcc);
+void *              hcache_compr_compress(struct HcacheCompr *hcc, const void *data, size_t dlen, size_t *clen);
+void *              hcache_compr_decompress(struct HcacheCompr *hcc, const void *cdata, size_t clen);
+bool                hcache_compr_owns(struct HcacheCompr *hcc, const void *data);
+bool                hcache_compr_set_dict(struct HcacheCompr *hcc, const void *dict, size_t dlen);
+bool                hcache_compr_has_dict(struct HcacheCompr *hcc);
+bool                hcache_compr_add_sample(struct HcacheCompr *hcc, const void *data, size_t dlen);
+void *              hcache_compr_train(struct HcacheCompr *hcc, size_t *dlen);
+const char *        hcache_compr_name(struct HcacheCompr *hcc);
+
+#endif /* MUTT_HCACHE_COMPRESS_H */
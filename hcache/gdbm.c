@@ -57,7 +57,7 @@ static void *hcache_gdbm_open(const char *path)
 /**
  * hcache_gdbm_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
   datum dkey;
   datum data;
@@ -70,6 +70,7 @@ static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen)
   dkey.dptr = (char *) key;
   dkey.dsize = keylen;
   data = gdbm_fetch(db, dkey);
+  *dlen = data.dsize;
   return data.dptr;
 }
 
@@ -121,6 +122,32 @@ static int hcache_gdbm_delete(void *ctx, const char *key, size_t keylen)
   return gdbm_delete(db, dkey);
 }
 
+/**
+ * hcache_gdbm_begin - Implements HcacheOps::begin()
+ *
+ * GDBM has no transactions; updates are simply buffered until commit().
+ */
+static int hcache_gdbm_begin(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  return 0;
+}
+
+/**
+ * hcache_gdbm_commit - Implements HcacheOps::commit()
+ */
+static int hcache_gdbm_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  GDBM_FILE db = ctx;
+  gdbm_sync(db);
+  return 0;
+}
+
 /**
  * hcache_gdbm_close - Implements HcacheOps::close()
  */
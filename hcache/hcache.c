@@ -48,17 +48,61 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include "mutt/mutt.h"
 #include "backend.h"
 #include "hcache.h"
 #include "hcache/hcversion.h"
+#ifdef USE_HCACHE_COMPRESSION
+#include "compress.h"
+#endif
 
 /* These Config Variables are only used in hcache/hcache.c */
 char *HeaderCacheBackend; ///< Config: (hcache) Header cache backend to use
+bool HeaderCacheShared; ///< Config: (hcache) Share one database between the folders of an account
+#ifdef USE_HCACHE_COMPRESSION
+char *HeaderCacheCompressMethod; ///< Config: (hcache) Compression method for the header cache records
+short HeaderCacheCompressLevel; ///< Config: (hcache) Compression level for the header cache records
+#endif
 
 static unsigned int hcachever = 0x0;
 
+/**
+ * struct HcacheFolderStats - Statistics of the header caches of a folder
+ */
+struct HcacheFolderStats
+{
+  char *folder;             ///< Folder of the header cache
+  unsigned long opens;      ///< Number of times the cache was opened
+  struct HcacheStats stats; ///< Statistics accumulated over all the opens
+  STAILQ_ENTRY(HcacheFolderStats) entries;
+};
+STAILQ_HEAD(HcacheFolderStatsList, HcacheFolderStats);
+
+static struct HcacheFolderStatsList FolderStats = STAILQ_HEAD_INITIALIZER(FolderStats);
+
+STAILQ_HEAD(HcacheList, EmailCache);
+
+/* Header caches that are open, their statistics aren't in FolderStats yet */
+static struct HcacheList OpenCaches = STAILQ_HEAD_INITIALIZER(OpenCaches);
+
+/**
+ * struct HcacheDb - A database shared by the folders of an account
+ */
+struct HcacheDb
+{
+  char *path;                  ///< Path of the database file
+  const struct HcacheOps *ops; ///< Backend which opened the database
+  void *ctx;                   ///< Backend-specific context
+  int refs;                    ///< Number of header caches using the database
+  int batches;                 ///< Number of header caches with an open batch
+  STAILQ_ENTRY(HcacheDb) entries;
+};
+STAILQ_HEAD(HcacheDbList, HcacheDb);
+
+static struct HcacheDbList SharedDbs = STAILQ_HEAD_INITIALIZER(SharedDbs);
+
 #define HCACHE_BACKEND(name) extern const struct HcacheOps hcache_##name##_ops;
 HCACHE_BACKEND(bdb)
 HCACHE_BACKEND(gdbm)
@@ -70,6 +114,12 @@ HCACHE_BACKEND(tokyocabinet)
 
 #define hcache_get_ops() hcache_get_backend_ops(HeaderCacheBackend)
 
+#ifdef USE_HCACHE_COMPRESSION
+/* Key of the compression dictionary, it can't clash with a message key */
+#define HC_DICT_KEY "/HCDICT"
+#define HC_DICT_KEYLEN (sizeof(HC_DICT_KEY) - 1)
+#endif
+
 /**
  * hcache_ops - Backend implementations
  *
@@ -119,6 +169,74 @@ static const struct HcacheOps *hcache_get_backend_ops(const char *backend)
   return *ops;
 }
 
+/**
+ * hcache_now - Get a monotonic timestamp
+ * @retval num Time in microseconds
+ */
+static uint64_t hcache_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * hcache_stats_add - Accumulate the statistics of a header cache
+ * @param acc   Statistics to add to
+ * @param stats Statistics to add
+ */
+static void hcache_stats_add(struct HcacheStats *acc, const struct HcacheStats *stats)
+{
+  acc->hits += stats->hits;
+  acc->misses += stats->misses;
+  acc->crc_misses += stats->crc_misses;
+  acc->stale += stats->stale;
+  acc->stores += stats->stores;
+  acc->bytes_read += stats->bytes_read;
+  acc->bytes_written += stats->bytes_written;
+  acc->fetch_us += stats->fetch_us;
+  acc->restore_us += stats->restore_us;
+  acc->store_us += stats->store_us;
+}
+
+/**
+ * hcache_stats_folder - Get the statistics of a folder
+ * @param folder Folder of the header cache
+ * @retval ptr Statistics, created if necessary
+ */
+static struct HcacheFolderStats *hcache_stats_folder(const char *folder)
+{
+  struct HcacheFolderStats *fs = NULL;
+  STAILQ_FOREACH(fs, &FolderStats, entries)
+  {
+    if (mutt_str_strcmp(fs->folder, folder) == 0)
+      return fs;
+  }
+
+  fs = mutt_mem_calloc(1, sizeof(struct HcacheFolderStats));
+  fs->folder = mutt_str_strdup(folder);
+  STAILQ_INSERT_TAIL(&FolderStats, fs, entries);
+  return fs;
+}
+
+/**
+ * hcache_stats_save - Log and keep the statistics of a header cache
+ * @param hc Header cache handle
+ */
+static void hcache_stats_save(header_cache_t *hc)
+{
+  const struct HcacheStats *st = &hc->stats;
+
+  mutt_debug(LL_DEBUG2,
+             "%s: %lu hits, %lu misses, %lu crc misses, %lu stale, %lu stores, "
+             "%lu bytes read, %lu bytes written, fetch %lums, restore %lums, store %lums\n",
+             hc->folder, st->hits, st->misses, st->crc_misses, st->stale, st->stores,
+             st->bytes_read, st->bytes_written, (unsigned long) (st->fetch_us / 1000),
+             (unsigned long) (st->restore_us / 1000), (unsigned long) (st->store_us / 1000));
+
+  hcache_stats_add(&hcache_stats_folder(hc->folder)->stats, st);
+}
+
 /**
  * crc_matches - Is the CRC number correct?
  * @param d   Binary blob to read CRC from
@@ -161,6 +279,125 @@ static bool create_hcache_dir(const char *path)
   return false;
 }
 
+/**
+ * hcache_account - Get the account a folder belongs to
+ * @param folder Mailbox name (including protocol)
+ * @param buf    Buffer for the account
+ * @param buflen Length of the buffer
+ *
+ * The account of a remote folder is its URL, up to the path, e.g.
+ * "imaps://user@example.com".  All the local folders share one account.
+ */
+static void hcache_account(const char *folder, char *buf, size_t buflen)
+{
+  const char *p = strstr(folder, "://");
+  if (!p)
+  {
+    mutt_str_strfcpy(buf, "local", buflen);
+    return;
+  }
+
+  p = strchr(p + 3, '/');
+  size_t len = p ? (p - folder) : mutt_str_strlen(folder);
+  mutt_str_strnfcpy(buf, folder, len, buflen);
+}
+
+/**
+ * hcache_db_open - Open a database file
+ * @param ops  Backend to use
+ * @param path Database filename
+ * @retval ptr  Backend-specific context
+ * @retval NULL Error
+ */
+static void *hcache_db_open(const struct HcacheOps *ops, const char *path)
+{
+  void *ctx = ops->open(path);
+  if (ctx)
+    return ctx;
+
+  /* remove a possibly incompatible version */
+  if (unlink(path) == 0)
+    return ops->open(path);
+
+  return NULL;
+}
+
+/**
+ * hcache_db_keep - Can a shared database stay open while it's unused?
+ * @param ops Backend of the database
+ * @retval true The database can stay open
+ *
+ * Only LMDB lets other processes use a database while it's open.  The other
+ * backends lock the file, so it must be closed as soon as possible.
+ */
+static bool hcache_db_keep(const struct HcacheOps *ops)
+{
+#ifdef HAVE_LMDB
+  return ops == &hcache_lmdb_ops;
+#else
+  return false;
+#endif
+}
+
+/**
+ * hcache_db_get - Get a shared database, opening it if necessary
+ * @param ops  Backend to use
+ * @param path Database filename
+ * @retval ptr  Shared database
+ * @retval NULL Error
+ */
+static struct HcacheDb *hcache_db_get(const struct HcacheOps *ops, const char *path)
+{
+  struct HcacheDb *db = NULL;
+  STAILQ_FOREACH(db, &SharedDbs, entries)
+  {
+    if ((db->ops == ops) && (mutt_str_strcmp(db->path, path) == 0))
+    {
+      db->refs++;
+      return db;
+    }
+  }
+
+  void *ctx = hcache_db_open(ops, path);
+  if (!ctx)
+    return NULL;
+
+  db = mutt_mem_calloc(1, sizeof(struct HcacheDb));
+  db->path = mutt_str_strdup(path);
+  db->ops = ops;
+  db->ctx = ctx;
+  db->refs = 1;
+  STAILQ_INSERT_TAIL(&SharedDbs, db, entries);
+
+  return db;
+}
+
+/**
+ * hcache_db_close - Release a shared database
+ * @param db    Shared database
+ * @param force If true, close the database even if it could be kept open
+ */
+static void hcache_db_close(struct HcacheDb *db, bool force)
+{
+  if (db->refs > 0)
+    db->refs--;
+
+  if (db->refs > 0)
+    return;
+
+  /* End any transaction, so other processes see our updates */
+  db->ops->commit(db->ctx);
+  db->batches = 0;
+
+  if (!force && hcache_db_keep(db->ops))
+    return;
+
+  STAILQ_REMOVE(&SharedDbs, db, HcacheDb, entries);
+  db->ops->close(&db->ctx);
+  FREE(&db->path);
+  FREE(&db);
+}
+
 /**
  * hcache_per_folder - Generate the hcache pathname
  * @param path   Base directory, from $header_cache
@@ -180,6 +417,9 @@ static bool create_hcache_dir(const char *path)
  * This function will create any parent directories needed, so the caller just
  * needs to create the database file.
  *
+ * If $header_cache_shared is set, NAME is the md5sum of the account of
+ * @a folder instead, so that all its folders use the same database.
+ *
  * If @a path exists and is a directory, it is used.
  * If @a path has a trailing '/' it is assumed to be a directory.
  * If ICONV isn't being used, then a suffix is added to the path, e.g. '-utf-8'.
@@ -205,7 +445,24 @@ static const char *hcache_per_folder(const char *path, const char *folder, hcach
 
   /* We have a directory - no matter whether it exists, or not */
 
-  if (namer)
+  if (HeaderCacheShared)
+  {
+    /* All the folders of the account share a database */
+    struct Md5Ctx ctx;
+    unsigned char m[16]; /* binary md5sum */
+    char account[PATH_MAX];
+    char name[33];
+    hcache_account(folder, account, sizeof(account));
+    mutt_md5_init_ctx(&ctx);
+    mutt_md5_process(hcache_get_ops()->name, &ctx);
+    mutt_md5_process("|", &ctx);
+    mutt_md5_process(account, &ctx);
+    mutt_md5_finish_ctx(&ctx, m);
+    mutt_md5_toascii(m, name);
+    rc = snprintf(hcpath, sizeof(hcpath), "%s%s%s-shared%s", path,
+                  slash ? "" : "/", name, suffix);
+  }
+  else if (namer)
   {
     /* We have a mailbox-specific namer function */
     snprintf(hcpath, sizeof(hcpath), "%s%s", path, slash ? "" : "/");
@@ -249,6 +506,56 @@ static char *get_foldername(const char *folder)
   return p;
 }
 
+#ifdef USE_HCACHE_COMPRESSION
+/**
+ * hcache_load_dict - Load the compression dictionary of a header cache
+ * @param hc Header cache handle
+ */
+static void hcache_load_dict(header_cache_t *hc)
+{
+  size_t len = 0;
+  void *data = mutt_hcache_fetch_raw_len(hc, HC_DICT_KEY, HC_DICT_KEYLEN, &len);
+  if (!data)
+    return;
+
+  /* The dictionary is stored as: crc, length, dictionary */
+  const size_t hlen = 2 * sizeof(unsigned int);
+  if (len >= hlen)
+  {
+    unsigned int crc = ((unsigned int *) data)[0];
+    unsigned int dlen = ((unsigned int *) data)[1];
+    if ((crc == hc->crc) && (dlen == len - hlen))
+      hcache_compr_set_dict(hc->compr, (unsigned int *) data + 2, dlen);
+  }
+
+  mutt_hcache_free(hc, &data);
+}
+
+/**
+ * hcache_train_dict - Train and save the compression dictionary
+ * @param hc Header cache handle
+ */
+static void hcache_train_dict(header_cache_t *hc)
+{
+  size_t dlen = 0;
+  char *dict = hcache_compr_train(hc->compr, &dlen);
+  if (!dict)
+    return;
+
+  const size_t hlen = 2 * sizeof(unsigned int);
+  char *data = mutt_mem_malloc(hlen + dlen);
+  unsigned int hdr[2] = { hc->crc, dlen };
+  memcpy(data, hdr, hlen);
+  memcpy(data + hlen, dict, dlen);
+
+  if (mutt_hcache_store_raw(hc, HC_DICT_KEY, HC_DICT_KEYLEN, data, hlen + dlen) == 0)
+    hcache_compr_set_dict(hc->compr, dict, dlen);
+
+  FREE(&data);
+  FREE(&dict);
+}
+#endif
+
 /**
  * mutt_hcache_open - Multiplexor for HcacheOps::open
  */
@@ -306,25 +613,61 @@ header_cache_t *mutt_hcache_open(const char *path, const char *folder, hcache_na
     return NULL;
   }
 
+#ifdef USE_HCACHE_COMPRESSION
+  if (HeaderCacheCompressMethod && *HeaderCacheCompressMethod)
+  {
+    hc->compr = hcache_compr_open(HeaderCacheCompressMethod, HeaderCacheCompressLevel);
+    if (hc->compr)
+    {
+      /* Records written with another method, or without compression, are
+       * invalid: mix the method into the crc */
+      union {
+        unsigned char charval[16];
+        unsigned int intval;
+      } digest;
+      struct Md5Ctx ctx;
+
+      mutt_md5_init_ctx(&ctx);
+      mutt_md5_process_bytes(&hc->crc, sizeof(hc->crc), &ctx);
+      mutt_md5_process(hcache_compr_name(hc->compr), &ctx);
+      mutt_md5_finish_ctx(&ctx, digest.charval);
+      hc->crc = digest.intval;
+    }
+  }
+#endif
+
   path = hcache_per_folder(path, hc->folder, namer);
 
-  hc->ctx = ops->open(path);
-  if (hc->ctx)
-    return hc;
+  if (HeaderCacheShared)
+  {
+    hc->db = hcache_db_get(ops, path);
+    if (hc->db)
+      hc->ctx = hc->db->ctx;
+  }
   else
   {
-    /* remove a possibly incompatible version */
-    if (unlink(path) == 0)
-    {
-      hc->ctx = ops->open(path);
-      if (hc->ctx)
-        return hc;
-    }
+    hc->ctx = hcache_db_open(ops, path);
+  }
+
+  if (!hc->ctx)
+  {
+#ifdef USE_HCACHE_COMPRESSION
+    hcache_compr_close(&hc->compr);
+#endif
     FREE(&hc->folder);
     FREE(&hc);
-
     return NULL;
   }
+
+#ifdef USE_HCACHE_COMPRESSION
+  if (hc->compr)
+    hcache_load_dict(hc);
+#endif
+
+  hcache_stats_folder(hc->folder)->opens++;
+  STAILQ_INSERT_TAIL(&OpenCaches, hc, entries);
+
+  return hc;
 }
 
 /**
@@ -336,7 +679,19 @@ void mutt_hcache_close(header_cache_t *hc)
   if (!hc || !ops)
     return;
 
-  ops->close(&hc->ctx);
+  if (hc->batch)
+    mutt_hcache_commit(hc);
+
+  STAILQ_REMOVE(&OpenCaches, hc, EmailCache, entries);
+  hcache_stats_save(hc);
+
+  if (hc->db)
+    hcache_db_close(hc->db, false);
+  else
+    ops->close(&hc->ctx);
+#ifdef USE_HCACHE_COMPRESSION
+  hcache_compr_close(&hc->compr);
+#endif
   FREE(&hc->folder);
   FREE(&hc);
 }
@@ -346,21 +701,80 @@ void mutt_hcache_close(header_cache_t *hc)
  */
 void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen)
 {
-  void *data = mutt_hcache_fetch_raw(hc, key, keylen);
+  return mutt_hcache_fetch_valid(hc, key, keylen, NULL, NULL);
+}
+
+/**
+ * mutt_hcache_fetch_valid - Fetch a record and check that it's up to date
+ */
+void *mutt_hcache_fetch_valid(header_cache_t *hc, const char *key, size_t keylen,
+                              hcache_valid_t valid, void *vdata)
+{
+  if (!hc)
+    return NULL;
+
+  uint64_t start = hcache_now();
+  size_t dlen = 0;
+  void *data = mutt_hcache_fetch_raw_len(hc, key, keylen, &dlen);
   if (!data)
   {
+    hc->stats.misses++;
+    hc->stats.fetch_us += hcache_now() - start;
     return NULL;
   }
 
-  if (!crc_matches(data, hc->crc))
+  if ((dlen < sizeof(union Validate) + sizeof(unsigned int)) || !crc_matches(data, hc->crc))
   {
     mutt_hcache_free(hc, &data);
+    hc->stats.crc_misses++;
+    hc->stats.fetch_us += hcache_now() - start;
     return NULL;
   }
 
+  if (valid && !valid(data, vdata))
+  {
+    mutt_hcache_free(hc, &data);
+    hc->stats.stale++;
+    hc->stats.fetch_us += hcache_now() - start;
+    return NULL;
+  }
+
+#ifdef USE_HCACHE_COMPRESSION
+  if (hc->compr)
+  {
+    hc->stats.bytes_read += dlen;
+    void *record = hcache_compr_decompress(hc->compr, data, dlen);
+    mutt_hcache_free(hc, &data);
+    data = record;
+  }
+  else
+#endif
+    hc->stats.bytes_read += serial_record_len(data);
+
+  if (data)
+    hc->stats.hits++;
+  else
+    hc->stats.crc_misses++;
+  hc->stats.fetch_us += hcache_now() - start;
+
   return data;
 }
 
+/**
+ * mutt_hcache_restore - Multiplexor for serial_restore_email()
+ */
+struct Email *mutt_hcache_restore(header_cache_t *hc, const unsigned char *d)
+{
+  if (!hc)
+    return serial_restore_email(d);
+
+  uint64_t start = hcache_now();
+  struct Email *e = serial_restore_email(d);
+  hc->stats.restore_us += hcache_now() - start;
+
+  return e;
+}
+
 /**
  * mutt_hcache_fetch_raw - Find the data for a key in a database backend
  * @param hc     Header cache handle
@@ -368,16 +782,31 @@ void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen)
  * @param keylen The length of the string pointed to by key
  */
 void *mutt_hcache_fetch_raw(header_cache_t *hc, const char *key, size_t keylen)
+{
+  size_t dlen = 0;
+  return mutt_hcache_fetch_raw_len(hc, key, keylen, &dlen);
+}
+
+/**
+ * mutt_hcache_fetch_raw_len - Find the data, and its length, for a key
+ * @param[in]  hc     Header cache handle
+ * @param[in]  key    A message identification string
+ * @param[in]  keylen The length of the string pointed to by key
+ * @param[out] dlen   Length of the data
+ */
+void *mutt_hcache_fetch_raw_len(header_cache_t *hc, const char *key,
+                                size_t keylen, size_t *dlen)
 {
   char path[PATH_MAX];
   const struct HcacheOps *ops = hcache_get_ops();
 
+  *dlen = 0;
   if (!hc || !ops)
     return NULL;
 
   keylen = snprintf(path, sizeof(path), "%s%s", hc->folder, key);
 
-  return ops->fetch(hc->ctx, path, keylen);
+  return ops->fetch(hc->ctx, path, keylen, dlen);
 }
 
 /**
@@ -390,6 +819,14 @@ void mutt_hcache_free(header_cache_t *hc, void **data)
   if (!hc || !ops)
     return;
 
+#ifdef USE_HCACHE_COMPRESSION
+  if (hcache_compr_owns(hc->compr, *data))
+  {
+    *data = NULL;
+    return;
+  }
+#endif
+
   ops->free(hc->ctx, data);
 }
 
@@ -406,10 +843,37 @@ int mutt_hcache_store(header_cache_t *hc, const char *key, size_t keylen,
   if (!hc)
     return -1;
 
+  uint64_t start = hcache_now();
   data = mutt_hcache_dump(hc, e, &dlen, uidvalidity);
-  ret = mutt_hcache_store_raw(hc, key, keylen, data, dlen);
 
-  FREE(&data);
+#ifdef USE_HCACHE_COMPRESSION
+  if (hc->compr)
+  {
+    if (hcache_compr_add_sample(hc->compr, data, dlen))
+      hcache_train_dict(hc);
+
+    size_t clen = 0;
+    void *cdata = hcache_compr_compress(hc->compr, data, dlen, &clen);
+    FREE(&data);
+    if (!cdata)
+      return -1;
+
+    ret = mutt_hcache_store_raw(hc, key, keylen, cdata, clen);
+    dlen = clen;
+  }
+  else
+#endif
+  {
+    ret = mutt_hcache_store_raw(hc, key, keylen, data, dlen);
+    FREE(&data);
+  }
+
+  if (ret == 0)
+  {
+    hc->stats.stores++;
+    hc->stats.bytes_written += dlen;
+  }
+  hc->stats.store_us += hcache_now() - start;
 
   return ret;
 }
@@ -454,6 +918,136 @@ int mutt_hcache_delete(header_cache_t *hc, const char *key, size_t keylen)
   return ops->delete (hc->ctx, path, keylen);
 }
 
+/**
+ * mutt_hcache_begin - Multiplexor for HcacheOps::begin
+ */
+int mutt_hcache_begin(header_cache_t *hc)
+{
+  const struct HcacheOps *ops = hcache_get_ops();
+
+  if (!hc || !ops)
+    return -1;
+
+  if (hc->batch)
+    return 0;
+
+  /* A shared database has one transaction for all its header caches */
+  if (hc->db && (hc->db->batches > 0))
+  {
+    hc->db->batches++;
+    hc->batch = true;
+    return 0;
+  }
+
+  int rc = ops->begin(hc->ctx);
+  if (rc == 0)
+  {
+    hc->batch = true;
+    if (hc->db)
+      hc->db->batches++;
+  }
+
+  return rc;
+}
+
+/**
+ * mutt_hcache_commit - Multiplexor for HcacheOps::commit
+ */
+int mutt_hcache_commit(header_cache_t *hc)
+{
+  const struct HcacheOps *ops = hcache_get_ops();
+
+  if (!hc || !ops)
+    return -1;
+
+  if (!hc->batch)
+    return 0;
+
+  hc->batch = false;
+
+  /* Only the last batch on a shared database ends the transaction */
+  if (hc->db && (--hc->db->batches > 0))
+    return 0;
+
+  return ops->commit(hc->ctx);
+}
+
+/**
+ * mutt_hcache_stats_dump - Write the statistics of the header caches
+ */
+void mutt_hcache_stats_dump(FILE *fp)
+{
+  if (!fp)
+    return;
+
+  if (STAILQ_EMPTY(&FolderStats))
+  {
+    fputs(_("No header cache has been used yet.\n"), fp);
+    return;
+  }
+
+  struct HcacheStats total = { 0 };
+  unsigned long opens = 0;
+  struct HcacheFolderStats *fs = NULL;
+  STAILQ_FOREACH(fs, &FolderStats, entries)
+  {
+    /* Include the header caches that are still open */
+    struct HcacheStats live = fs->stats;
+    header_cache_t *hc = NULL;
+    STAILQ_FOREACH(hc, &OpenCaches, entries)
+    {
+      if (mutt_str_strcmp(hc->folder, fs->folder) == 0)
+        hcache_stats_add(&live, &hc->stats);
+    }
+
+    const struct HcacheStats *st = &live;
+    unsigned long lookups = st->hits + st->misses + st->crc_misses + st->stale;
+
+    fprintf(fp, "%s\n", fs->folder);
+    fprintf(fp, _("  opened %lu times, %lu lookups, %lu%% hit rate\n"), fs->opens,
+            lookups, lookups ? (st->hits * 100 / lookups) : 0);
+    fprintf(fp, _("  hits %lu, misses %lu (absent %lu, version %lu, stale %lu)\n"),
+            st->hits, st->misses + st->crc_misses + st->stale, st->misses,
+            st->crc_misses, st->stale);
+    fprintf(fp, _("  stores %lu, read %lu KiB, written %lu KiB\n"), st->stores,
+            st->bytes_read / 1024, st->bytes_written / 1024);
+    fprintf(fp, _("  time: fetch %lums, restore %lums, store %lums\n\n"),
+            (unsigned long) (st->fetch_us / 1000),
+            (unsigned long) (st->restore_us / 1000), (unsigned long) (st->store_us / 1000));
+
+    opens += fs->opens;
+    hcache_stats_add(&total, st);
+  }
+
+  unsigned long lookups = total.hits + total.misses + total.crc_misses + total.stale;
+  fprintf(fp, _("Total: opened %lu times, %lu lookups, %lu hits, %lu stores, "
+                "fetch %lums, restore %lums, store %lums\n"),
+          opens, lookups, total.hits, total.stores, (unsigned long) (total.fetch_us / 1000),
+          (unsigned long) (total.restore_us / 1000), (unsigned long) (total.store_us / 1000));
+}
+
+/**
+ * mutt_hcache_cleanup - Close the shared databases and free the statistics
+ */
+void mutt_hcache_cleanup(void)
+{
+  struct HcacheDb *db = NULL;
+  struct HcacheDb *dbtmp = NULL;
+  STAILQ_FOREACH_SAFE(db, &SharedDbs, entries, dbtmp)
+  {
+    hcache_db_close(db, true);
+  }
+
+  struct HcacheFolderStats *fs = NULL;
+  struct HcacheFolderStats *tmp = NULL;
+  STAILQ_FOREACH_SAFE(fs, &FolderStats, entries, tmp)
+  {
+    FREE(&fs->folder);
+    FREE(&fs);
+  }
+  STAILQ_INIT(&FolderStats);
+}
+
 /**
  * mutt_hcache_backend_list - Get a list of backend names
  * @retval ptr Comma-space-separated list of names
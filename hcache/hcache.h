@@ -50,9 +50,31 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <sys/time.h>
+#include "mutt/queue.h"
 
 struct Email;
+struct HcacheCompr;
+struct HcacheDb;
+
+/**
+ * struct HcacheStats - Header cache statistics
+ */
+struct HcacheStats
+{
+  unsigned long hits;          ///< Records found and valid
+  unsigned long misses;        ///< Records not found
+  unsigned long crc_misses;    ///< Records written by another version, or with another config
+  unsigned long stale;         ///< Records rejected by the caller, e.g. the mtime or UIDVALIDITY changed
+  unsigned long stores;        ///< Records written
+  unsigned long bytes_read;    ///< Size of the valid records read
+  unsigned long bytes_written; ///< Size of the records written
+  uint64_t fetch_us;           ///< Time spent fetching records
+  uint64_t restore_us;         ///< Time spent restoring Emails from records
+  uint64_t store_us;           ///< Time spent storing Emails
+};
 
 /**
  * struct EmailCache - header cache structure
@@ -67,6 +89,13 @@ struct EmailCache
   char *folder;
   unsigned int crc;
   void *ctx;
+  bool batch; ///< A batch of updates has been started with mutt_hcache_begin()
+  struct HcacheStats stats; ///< Statistics since the cache was opened
+  struct HcacheDb *db; ///< Database shared with other folders, see $header_cache_shared
+#ifdef USE_HCACHE_COMPRESSION
+  struct HcacheCompr *compr; ///< Compression state, NULL if records aren't compressed
+#endif
+  STAILQ_ENTRY(EmailCache) entries; ///< Open header caches, for their statistics
 };
 
 typedef struct EmailCache header_cache_t;
@@ -88,8 +117,21 @@ union Validate {
   unsigned int uidvalidity;
 };
 
+/**
+ * typedef hcache_valid_t - Prototype for a function to check a record's validity
+ * @param valid Validity datum of the record, see mutt_hcache_store()
+ * @param data  Data passed to mutt_hcache_fetch_valid()
+ * @retval true The record is up to date
+ */
+typedef bool (*hcache_valid_t)(const union Validate *valid, void *data);
+
 /* These Config Variables are only used in hcache/hcache.c */
 extern char *HeaderCacheBackend;
+extern bool HeaderCacheShared;
+#ifdef USE_HCACHE_COMPRESSION
+extern char *HeaderCacheCompressMethod;
+extern short HeaderCacheCompressLevel;
+#endif
 
 /**
  * mutt_hcache_open - open the connection to the header cache
@@ -124,6 +166,23 @@ void mutt_hcache_close(header_cache_t *hc);
  */
 void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen);
 
+/**
+ * mutt_hcache_fetch_valid - fetch a message's header, if it is up to date
+ * @param hc     Pointer to the header_cache_t structure got by mutt_hcache_open
+ * @param key    Message identification string
+ * @param keylen Length of the string pointed to by key
+ * @param valid  Function to check the record's validity datum
+ * @param vdata  Data passed to @a valid
+ * @retval ptr  Success, data if found, valid and up to date
+ * @retval NULL Otherwise
+ *
+ * Like mutt_hcache_fetch(), but the caller's own check is done before the
+ * record is decompressed, e.g. on the UIDVALIDITY or the mtime of the
+ * message.  A record which fails it counts as stale in the statistics.
+ */
+void *mutt_hcache_fetch_valid(header_cache_t *hc, const char *key, size_t keylen,
+                              hcache_valid_t valid, void *vdata);
+
 /**
  * mutt_hcache_fetch_raw - fetch a message's header from the cache
  * @param hc     Pointer to the header_cache_t structure got by mutt_hcache_open
@@ -139,6 +198,20 @@ void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen);
  */
 void *mutt_hcache_fetch_raw(header_cache_t *hc, const char *key, size_t keylen);
 
+/**
+ * mutt_hcache_fetch_raw_len - fetch raw data, and its length, from the cache
+ * @param[in]  hc     Pointer to the header_cache_t structure got by mutt_hcache_open
+ * @param[in]  key    Message identification string
+ * @param[in]  keylen Length of the string pointed to by key
+ * @param[out] dlen   Length of the data found
+ * @retval ptr  Success, the data if found
+ * @retval NULL Otherwise
+ *
+ * @note Like mutt_hcache_fetch_raw(), no check is performed on the data.
+ */
+void *mutt_hcache_fetch_raw_len(header_cache_t *hc, const char *key,
+                                size_t keylen, size_t *dlen);
+
 /**
  * mutt_hcache_free - free previously fetched data
  * @param hc   Pointer to the header_cache_t structure got by mutt_hcache_open
@@ -148,13 +221,27 @@ void mutt_hcache_free(header_cache_t *hc, void **data);
 
 /**
  * mutt_hcache_restore - restore a Header from data retrieved from the cache
- * @param d Data retrieved using mutt_hcache_fetch or mutt_hcache_fetch_raw
+ * @param hc Pointer to the header_cache_t structure got by mutt_hcache_open
+ * @param d  Data retrieved using mutt_hcache_fetch or mutt_hcache_fetch_raw
  * @retval ptr Success, the restored header (cannot be NULL)
  *
  * @note The returned Header must be free'd by caller code with
  *       mutt_email_free().
+ *
+ * @note Only the fields needed by the index are restored.  The body
+ *       parameters and user-defined headers are restored by
+ *       mutt_hcache_restore_deferred().
  */
-struct Email *mutt_hcache_restore(const unsigned char *d);
+struct Email *mutt_hcache_restore(header_cache_t *hc, const unsigned char *d);
+
+/**
+ * mutt_hcache_restore_deferred - restore the fields skipped by mutt_hcache_restore
+ * @param e Email restored from the cache
+ *
+ * This must be called before the message is opened.  It does nothing if the
+ * Email didn't come from the cache, or has already been completed.
+ */
+void mutt_hcache_restore_deferred(struct Email *e);
 
 /**
  * mutt_hcache_store - store a Header along with a validity datum
@@ -192,6 +279,28 @@ int mutt_hcache_store_raw(header_cache_t *hc, const char *key, size_t keylen,
  */
 int mutt_hcache_delete(header_cache_t *hc, const char *key, size_t keylen);
 
+/**
+ * mutt_hcache_begin - start a batch of updates
+ * @param hc Pointer to the header_cache_t structure got by mutt_hcache_open
+ * @retval 0   Success
+ * @retval num Generic or backend-specific error code otherwise
+ *
+ * Until mutt_hcache_commit() is called, the backend is free to group all the
+ * stores and deletes into a single transaction.  Starting a batch while one
+ * is already in progress has no effect.
+ */
+int mutt_hcache_begin(header_cache_t *hc);
+
+/**
+ * mutt_hcache_commit - write a batch of updates to the header cache
+ * @param hc Pointer to the header_cache_t structure got by mutt_hcache_open
+ * @retval 0   Success
+ * @retval num Generic or backend-specific error code otherwise
+ *
+ * @note mutt_hcache_close() commits any batch still in progress.
+ */
+int mutt_hcache_commit(header_cache_t *hc);
+
 /**
  * mutt_hcache_backend_list - get a list of backend identification strings
  * @retval ptr Comma separated string describing the compiled-in backends
@@ -208,4 +317,39 @@ const char *mutt_hcache_backend_list(void);
  */
 bool mutt_hcache_is_valid_backend(const char *s);
 
+/**
+ * mutt_hcache_stats_dump - write the statistics of the header caches
+ * @param fp File to write to
+ *
+ * The statistics of a header cache are collected while it's open, and
+ * accumulated per folder when it's closed.
+ */
+void mutt_hcache_stats_dump(FILE *fp);
+
+/**
+ * mutt_hcache_cleanup - free the resources kept between header caches
+ *
+ * Close the databases shared by the folders of an account, see
+ * $header_cache_shared, and free the statistics.
+ */
+void mutt_hcache_cleanup(void);
+
+#ifdef USE_HCACHE_COMPRESSION
+/**
+ * mutt_hcache_compress_list - get a list of compression method names
+ * @retval ptr Comma separated string describing the compiled-in methods
+ *
+ * @note The returned string must be free'd by the caller
+ */
+const char *mutt_hcache_compress_list(void);
+
+/**
+ * mutt_hcache_is_valid_compression - Is the string a valid compression method
+ * @param s String identifying a compression method
+ * @retval true  s is recognized as a valid method
+ * @retval false otherwise
+ */
+bool mutt_hcache_is_valid_compression(const char *s);
+#endif
+
 #endif /* MUTT_HCACHE_HCACHE_H */
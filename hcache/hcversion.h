@@ -0,0 +1,9 @@
+/* base version: 3
+ * Address: char *personal; char *mailbox; _Bool group : 1; _Bool is_intl : 1; _Bool intl_checked : 1; struct Address *next;
+ * Buffer: char *data; char *dptr; size_t dsize; int destroy;
+ * ListNode: char *data; struct { struct ListNode *stqe_next; } entries;
+ * Parameter: char *attribute; char *value; struct { struct Parameter *tqe_next; struct Parameter **tqe_prev; } entries;
+ * Body: char *xtype; char *subtype; char *language; struct ParameterList parameter; char *description; char *form_name; long hdr_offset; off_t offset; off_t length; char *filename; char *d_filename; char *charset; struct Content *content; struct Body *next; struct Body *parts; struct Email *email; struct AttachPtr *aptr; signed short attach_count; time_t stamp; struct Envelope *mime_headers; unsigned int type : 4; unsigned int encoding : 3; unsigned int disposition : 2; _Bool use_disp : 1; _Bool unlink : 1; _Bool tagged : 1; _Bool deleted : 1; _Bool noconv : 1; _Bool force_charset : 1; _Bool is_signed_data : 1; _Bool goodsig : 1; _Bool warnsig : 1; _Bool badsig : 1; _Bool collapsed : 1; _Bool attach_qualifies : 1;
+ * Envelope: struct Address *return_path; struct Address *from; struct Address *to; struct Address *cc; struct Address *bcc; struct Address *sender; struct Address *reply_to; struct Address *mail_followup_to; struct Address *x_original_to; char *list_post; char *subject; char *real_subj; char *disp_subj; char *message_id; char *supersedes; char *date; char *x_label; char *organization; char *newsgroups; char *xref; char *followup_to; char *x_comment_to; struct Buffer *spam; struct ListHead references; struct ListHead in_reply_to; struct ListHead userhdrs; unsigned char changed;
+ */
+#define HCACHEVER 0x766464c6
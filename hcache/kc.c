@@ -71,15 +71,13 @@ static void *hcache_kyotocabinet_open(const char *path)
 /**
  * hcache_kyotocabinet_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_kyotocabinet_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_kyotocabinet_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
-  size_t sp;
-
   if (!ctx)
     return NULL;
 
   KCDB *db = ctx;
-  return kcdbget(db, key, keylen, &sp);
+  return kcdbget(db, key, keylen, dlen);
 }
 
 /**
@@ -126,6 +124,40 @@ static int hcache_kyotocabinet_delete(void *ctx, const char *key, size_t keylen)
   return 0;
 }
 
+/**
+ * hcache_kyotocabinet_begin - Implements HcacheOps::begin()
+ */
+static int hcache_kyotocabinet_begin(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  KCDB *db = ctx;
+  if (!kcdbbegintran(db, false))
+  {
+    int ecode = kcdbecode(db);
+    return ecode ? ecode : -1;
+  }
+  return 0;
+}
+
+/**
+ * hcache_kyotocabinet_commit - Implements HcacheOps::commit()
+ */
+static int hcache_kyotocabinet_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  KCDB *db = ctx;
+  if (!kcdbendtran(db, true))
+  {
+    int ecode = kcdbecode(db);
+    return ecode ? ecode : -1;
+  }
+  return 0;
+}
+
 /**
  * hcache_kyotocabinet_close - Implements HcacheOps::close()
  */
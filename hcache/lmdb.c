@@ -173,7 +173,7 @@ fail_env:
 /**
  * hcache_lmdb_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen)
+static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen, size_t *dlen)
 {
   MDB_val dkey;
   MDB_val data;
@@ -206,6 +206,7 @@ static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen)
     return NULL;
   }
 
+  *dlen = data.mv_size;
   return data.mv_data;
 }
 
@@ -285,6 +286,55 @@ static int hcache_lmdb_delete(void *vctx, const char *key, size_t keylen)
   return rc;
 }
 
+/**
+ * hcache_lmdb_begin - Implements HcacheOps::begin()
+ */
+static int hcache_lmdb_begin(void *vctx)
+{
+  int rc;
+
+  if (!vctx)
+    return -1;
+
+  struct HcacheLmdbCtx *ctx = vctx;
+
+  rc = mdb_get_w_txn(ctx);
+  if (rc != MDB_SUCCESS)
+    mutt_debug(LL_DEBUG2, "mdb_get_w_txn: %s\n", mdb_strerror(rc));
+
+  return rc;
+}
+
+/**
+ * hcache_lmdb_commit - Implements HcacheOps::commit()
+ */
+static int hcache_lmdb_commit(void *vctx)
+{
+  int rc = MDB_SUCCESS;
+
+  if (!vctx)
+    return -1;
+
+  struct HcacheLmdbCtx *ctx = vctx;
+
+  if (ctx->txn && ctx->txn_mode == TXN_WRITE)
+  {
+    rc = mdb_txn_commit(ctx->txn);
+    if (rc != MDB_SUCCESS)
+      mutt_debug(LL_DEBUG2, "mdb_txn_commit: %s\n", mdb_strerror(rc));
+    ctx->txn_mode = TXN_UNINITIALIZED;
+    ctx->txn = NULL;
+  }
+  else if (ctx->txn && ctx->txn_mode == TXN_READ)
+  {
+    /* Release the snapshot, the next read will see the latest updates */
+    mdb_txn_reset(ctx->txn);
+    ctx->txn_mode = TXN_UNINITIALIZED;
+  }
+
+  return rc;
+}
+
 /**
  * hcache_lmdb_close - Implements HcacheOps::close()
  */
@@ -301,6 +351,11 @@ static void hcache_lmdb_close(void **vctx)
     ctx->txn_mode = TXN_UNINITIALIZED;
     ctx->txn = NULL;
   }
+  else if (ctx->txn)
+  {
+    mdb_txn_abort(ctx->txn);
+    ctx->txn = NULL;
+  }
 
   mdb_env_close(ctx->env);
   FREE(vctx);
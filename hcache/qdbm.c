@@ -54,13 +54,17 @@ static void *hcache_qdbm_open(const char *path)
 /**
  * hcache_qdbm_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_qdbm_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_qdbm_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
+  int sp = 0;
+
   if (!ctx)
     return NULL;
 
   VILLA *db = ctx;
-  return vlget(db, key, keylen, NULL);
+  void *data = vlget(db, key, keylen, &sp);
+  *dlen = sp;
+  return data;
 }
 
 /**
@@ -101,6 +105,32 @@ static int hcache_qdbm_delete(void *ctx, const char *key, size_t keylen)
   return success ? 0 : dpecode ? dpecode : -1;
 }
 
+/**
+ * hcache_qdbm_begin - Implements HcacheOps::begin()
+ */
+static int hcache_qdbm_begin(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  VILLA *db = ctx;
+  bool success = vltranbegin(db);
+  return success ? 0 : dpecode ? dpecode : -1;
+}
+
+/**
+ * hcache_qdbm_commit - Implements HcacheOps::commit()
+ */
+static int hcache_qdbm_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  VILLA *db = ctx;
+  bool success = vltrancommit(db);
+  return success ? 0 : dpecode ? dpecode : -1;
+}
+
 /**
  * hcache_qdbm_close - Implements HcacheOps::close()
  */
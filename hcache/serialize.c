@@ -40,6 +40,7 @@
 #include "email/parse.h"
 #include "globals.h"
 #include "hcache.h"
+#include "serialize.h"
 
 /**
  * lazy_malloc - Allocate some memory
@@ -413,6 +414,9 @@ void serial_restore_parameter(struct ParameterList *p, const unsigned char *d,
  * @param off     Offset into the blob
  * @param convert If true, the strings will be converted to utf-8
  * @retval ptr End of the newly packed binary
+ *
+ * Only the fields needed by the index are packed here, the rest is packed by
+ * serial_dump_body_deferred().
  */
 unsigned char *serial_dump_body(struct Body *c, unsigned char *d, int *off, bool convert)
 {
@@ -437,12 +441,26 @@ unsigned char *serial_dump_body(struct Body *c, unsigned char *d, int *off, bool
   d = serial_dump_char(nb.xtype, d, off, false);
   d = serial_dump_char(nb.subtype, d, off, false);
 
-  d = serial_dump_parameter(&nb.parameter, d, off, convert);
+  return d;
+}
 
-  d = serial_dump_char(nb.description, d, off, convert);
-  d = serial_dump_char(nb.form_name, d, off, convert);
-  d = serial_dump_char(nb.filename, d, off, convert);
-  d = serial_dump_char(nb.d_filename, d, off, convert);
+/**
+ * serial_dump_body_deferred - Pack the rarely used fields of a Body
+ * @param c       Body to pack
+ * @param d       Binary blob to add to
+ * @param off     Offset into the blob
+ * @param convert If true, the strings will be converted to utf-8
+ * @retval ptr End of the newly packed binary
+ */
+unsigned char *serial_dump_body_deferred(struct Body *c, unsigned char *d,
+                                         int *off, bool convert)
+{
+  d = serial_dump_parameter(&c->parameter, d, off, convert);
+
+  d = serial_dump_char(c->description, d, off, convert);
+  d = serial_dump_char(c->form_name, d, off, convert);
+  d = serial_dump_char(c->filename, d, off, convert);
+  d = serial_dump_char(c->d_filename, d, off, convert);
 
   return d;
 }
@@ -453,6 +471,8 @@ unsigned char *serial_dump_body(struct Body *c, unsigned char *d, int *off, bool
  * @param d       Binary blob to read from
  * @param off     Offset into the blob
  * @param convert If true, the strings will be converted from utf-8
+ *
+ * The fields packed by serial_dump_body_deferred() are left empty.
  */
 void serial_restore_body(struct Body *c, const unsigned char *d, int *off, bool convert)
 {
@@ -464,6 +484,22 @@ void serial_restore_body(struct Body *c, const unsigned char *d, int *off, bool
   serial_restore_char(&c->subtype, d, off, false);
 
   TAILQ_INIT(&c->parameter);
+  c->description = NULL;
+  c->form_name = NULL;
+  c->filename = NULL;
+  c->d_filename = NULL;
+}
+
+/**
+ * serial_restore_body_deferred - Unpack the rarely used fields of a Body
+ * @param c       Store the unpacked fields here
+ * @param d       Binary blob to read from
+ * @param off     Offset into the blob
+ * @param convert If true, the strings will be converted from utf-8
+ */
+void serial_restore_body_deferred(struct Body *c, const unsigned char *d,
+                                  int *off, bool convert)
+{
   serial_restore_parameter(&c->parameter, d, off, convert);
 
   serial_restore_char(&c->description, d, off, convert);
@@ -479,6 +515,8 @@ void serial_restore_body(struct Body *c, const unsigned char *d, int *off, bool
  * @param off     Offset into the blob
  * @param convert If true, the strings will be converted to utf-8
  * @retval ptr End of the newly packed binary
+ *
+ * The user-defined headers are packed separately, see mutt_hcache_dump().
  */
 unsigned char *serial_dump_envelope(struct Envelope *env, unsigned char *d,
                                     int *off, bool convert)
@@ -509,7 +547,6 @@ unsigned char *serial_dump_envelope(struct Envelope *env, unsigned char *d,
 
   d = serial_dump_stailq(&env->references, d, off, false);
   d = serial_dump_stailq(&env->in_reply_to, d, off, false);
-  d = serial_dump_stailq(&env->userhdrs, d, off, convert);
 
 #ifdef USE_NNTP
   d = serial_dump_char(env->xref, d, off, false);
@@ -562,7 +599,6 @@ void serial_restore_envelope(struct Envelope *env, const unsigned char *d, int *
 
   serial_restore_stailq(&env->references, d, off, false);
   serial_restore_stailq(&env->in_reply_to, d, off, false);
-  serial_restore_stailq(&env->userhdrs, d, off, convert);
 
 #ifdef USE_NNTP
   serial_restore_char(&env->xref, d, off, false);
@@ -571,6 +607,43 @@ void serial_restore_envelope(struct Envelope *env, const unsigned char *d, int *
 #endif
 }
 
+/**
+ * serial_dump_deferred - Pack the fields that aren't needed by the index
+ * @param e       Email to pack
+ * @param d       Binary blob to add to
+ * @param off     Offset into the blob
+ * @param convert If true, the strings will be converted to utf-8
+ * @retval ptr End of the newly packed binary
+ *
+ * The section is prefixed by its length so that it can be kept aside by
+ * mutt_hcache_restore().  If the Email was itself restored from the cache
+ * and its deferred fields were never needed, they are copied verbatim.
+ */
+static unsigned char *serial_dump_deferred(const struct Email *e, unsigned char *d,
+                                           int *off, bool convert)
+{
+  if (e->hcache_deferred)
+  {
+    unsigned int size;
+    memcpy(&size, e->hcache_deferred, sizeof(int));
+    lazy_realloc(&d, *off + sizeof(int) + size);
+    memcpy(d + *off, e->hcache_deferred, sizeof(int) + size);
+    *off += sizeof(int) + size;
+    return d;
+  }
+
+  unsigned int start_off = *off;
+  d = serial_dump_int(0xdeadbeef, d, off);
+
+  d = serial_dump_body_deferred(e->content, d, off, convert);
+  d = serial_dump_stailq(&e->env->userhdrs, d, off, convert);
+
+  unsigned int size = *off - start_off - sizeof(int);
+  memcpy(d + start_off, &size, sizeof(int));
+
+  return d;
+}
+
 /**
  * mutt_hcache_dump - Serialise a Header object
  * @param hc          Header cache handle
@@ -581,6 +654,12 @@ void serial_restore_envelope(struct Envelope *env, const unsigned char *d, int *
  *
  * This function transforms a e into a char so that it is usable by
  * db_store.
+ *
+ * The blob is laid out as:
+ * - union Validate, crc
+ * - struct Email
+ * - section table, offsets of the sections listed in enum HcacheSection
+ * - the sections themselves
  */
 void *mutt_hcache_dump(header_cache_t *hc, const struct Email *e, int *off, unsigned int uidvalidity)
 {
@@ -626,23 +705,68 @@ void *mutt_hcache_dump(header_cache_t *hc, const struct Email *e, int *off, unsi
   STAILQ_INIT(&nh.chain);
 #endif
   nh.edata = NULL;
+  nh.hcache_deferred = NULL;
 
   memcpy(d + *off, &nh, sizeof(struct Email));
   *off += sizeof(struct Email);
 
+  int table = *off;
+  for (int i = 0; i < HC_SECTION_MAX; i++)
+    d = serial_dump_int(0, d, off);
+
+  memcpy(d + table + HC_SECTION_ENVELOPE * sizeof(int), off, sizeof(int));
   d = serial_dump_envelope(nh.env, d, off, convert);
+  memcpy(d + table + HC_SECTION_BODY * sizeof(int), off, sizeof(int));
   d = serial_dump_body(nh.content, d, off, convert);
   d = serial_dump_char(nh.maildir_flags, d, off, convert);
+  memcpy(d + table + HC_SECTION_DEFERRED * sizeof(int), off, sizeof(int));
+  d = serial_dump_deferred(e, d, off, convert);
 
   return d;
 }
 
 /**
- * mutt_hcache_restore - Deserialise a Header object
+ * serial_section - Find the offset of a section of a cached record
+ * @param d       Binary blob
+ * @param section Section to find, e.g. #HC_SECTION_BODY
+ * @retval num Offset into the blob
+ */
+static int serial_section(const unsigned char *d, enum HcacheSection section)
+{
+  int off = sizeof(union Validate) + sizeof(unsigned int) + sizeof(struct Email) +
+            section * sizeof(int);
+  unsigned int section_off;
+
+  serial_restore_int(&section_off, d, &off);
+  return section_off;
+}
+
+/**
+ * serial_record_len - Get the length of a cached record
+ * @param d Binary blob
+ * @retval num Length of the blob
+ *
+ * The deferred section is always the last one.
+ */
+size_t serial_record_len(const unsigned char *d)
+{
+  int off = serial_section(d, HC_SECTION_DEFERRED);
+  unsigned int size;
+  memcpy(&size, d + off, sizeof(int));
+
+  return off + sizeof(int) + size;
+}
+
+/**
+ * serial_restore_email - Deserialise a Header object
  * @param d Binary blob
  * @retval ptr Reconstructed Header
+ *
+ * Only the fields needed to display the index are unpacked.  The rest of the
+ * record is kept aside, untouched, until mutt_hcache_restore_deferred() is
+ * called.
  */
-struct Email *mutt_hcache_restore(const unsigned char *d)
+struct Email *serial_restore_email(const unsigned char *d)
 {
   int off = 0;
   struct Email *e = mutt_email_new();
@@ -662,13 +786,43 @@ struct Email *mutt_hcache_restore(const unsigned char *d)
   STAILQ_INIT(&e->chain);
 #endif
 
+  off = serial_section(d, HC_SECTION_ENVELOPE);
   e->env = mutt_env_new();
   serial_restore_envelope(e->env, d, &off, convert);
 
+  off = serial_section(d, HC_SECTION_BODY);
   e->content = mutt_body_new();
   serial_restore_body(e->content, d, &off, convert);
 
   serial_restore_char(&e->maildir_flags, d, &off, convert);
 
+  off = serial_section(d, HC_SECTION_DEFERRED);
+  unsigned int size;
+  memcpy(&size, d + off, sizeof(int));
+  e->hcache_deferred = mutt_mem_malloc(sizeof(int) + size);
+  memcpy(e->hcache_deferred, d + off, sizeof(int) + size);
+
   return e;
 }
+
+/**
+ * mutt_hcache_restore_deferred - Deserialise the rest of a Header object
+ * @param e Email restored by serial_restore_email()
+ */
+void mutt_hcache_restore_deferred(struct Email *e)
+{
+  if (!e || !e->hcache_deferred)
+    return;
+
+  const unsigned char *d = e->hcache_deferred;
+  int off = sizeof(int);
+  bool convert = !CharsetIsUtf8;
+
+  if (e->content && e->env)
+  {
+    serial_restore_body_deferred(e->content, d, &off, convert);
+    serial_restore_stailq(&e->env->userhdrs, d, &off, convert);
+  }
+
+  FREE(&e->hcache_deferred);
+}
@@ -38,8 +38,22 @@ struct Email;
 struct ListHead;
 struct ParameterList;
 
+/**
+ * enum HcacheSection - Sections of a cached Email record
+ *
+ * The offset of each section is stored in a table following the Email.
+ */
+enum HcacheSection
+{
+  HC_SECTION_ENVELOPE, ///< Envelope, needed by the index
+  HC_SECTION_BODY,     ///< Body type and maildir flags, needed by the index
+  HC_SECTION_DEFERRED, ///< Body parameters and user headers, restored on demand
+  HC_SECTION_MAX,
+};
+
 unsigned char *serial_dump_address(struct Address *a, unsigned char *d, int *off, bool convert);
 unsigned char *serial_dump_body(struct Body *c, unsigned char *d, int *off, bool convert);
+unsigned char *serial_dump_body_deferred(struct Body *c, unsigned char *d, int *off, bool convert);
 unsigned char *serial_dump_buffer(struct Buffer *b, unsigned char *d, int *off, bool convert);
 unsigned char *serial_dump_char(char *c, unsigned char *d, int *off, bool convert);
 unsigned char *serial_dump_char_size(char *c, unsigned char *d, int *off, ssize_t size, bool convert);
@@ -50,6 +64,7 @@ unsigned char *serial_dump_stailq(struct ListHead *l, unsigned char *d, int *off
 
 void           serial_restore_address(struct Address **a, const unsigned char *d, int *off, bool convert);
 void           serial_restore_body(struct Body *c, const unsigned char *d, int *off, bool convert);
+void           serial_restore_body_deferred(struct Body *c, const unsigned char *d, int *off, bool convert);
 void           serial_restore_buffer(struct Buffer **b, const unsigned char *d, int *off, bool convert);
 void           serial_restore_char(char **c, const unsigned char *d, int *off, bool convert);
 void           serial_restore_envelope(struct Envelope *e, const unsigned char *d, int *off, bool convert);
@@ -58,6 +73,8 @@ void           serial_restore_parameter(struct ParameterList *p, const unsigned
 void           serial_restore_stailq(struct ListHead *l, const unsigned char *d, int *off, bool convert);
 
 void *        mutt_hcache_dump(header_cache_t *hc, const struct Email *e, int *off, unsigned int uidvalidity);
-struct Email *mutt_hcache_restore(const unsigned char *d);
+struct Email *serial_restore_email(const unsigned char *d);
+size_t        serial_record_len(const unsigned char *d);
+void          mutt_hcache_restore_deferred(struct Email *e);
 
 #endif /* MUTT_HCACHE_SERIALIZE_H */
@@ -35,9 +35,15 @@
 #include "opcodes.h"
 #include "pager.h"
 #include "version.h"
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
 
 // clang-format off
 static enum CommandResult icmd_bind   (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
+#ifdef USE_HCACHE
+static enum CommandResult icmd_hcache (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
+#endif
 static enum CommandResult icmd_set    (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
 static enum CommandResult icmd_version(struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
 
@@ -48,6 +54,9 @@ static enum CommandResult icmd_version(struct Buffer *buf, struct Buffer *s, uns
  */
 const struct ICommand ICommandList[] = {
   { "bind",     icmd_bind,     0 },
+#ifdef USE_HCACHE
+  { "hcache",   icmd_hcache,   0 },
+#endif
   { "macro",    icmd_bind,     1 },
   { "set",      icmd_set,      0 },
   { "version",  icmd_version,  0 },
@@ -294,6 +303,43 @@ static enum CommandResult icmd_bind(struct Buffer *buf, struct Buffer *s,
   return MUTT_CMD_SUCCESS;
 }
 
+#ifdef USE_HCACHE
+/**
+ * icmd_hcache - Parse 'hcache' command to display the header cache statistics - Implements ::icommand_t
+ */
+static enum CommandResult icmd_hcache(struct Buffer *buf, struct Buffer *s,
+                                      unsigned long data, struct Buffer *err)
+{
+  if (MoreArgs(s))
+  {
+    mutt_buffer_printf(err, _("%s: too many arguments"), "hcache");
+    return MUTT_CMD_WARNING;
+  }
+
+  char tempfile[PATH_MAX];
+  mutt_mktemp(tempfile, sizeof(tempfile));
+
+  FILE *fpout = mutt_file_fopen(tempfile, "w");
+  if (!fpout)
+  {
+    mutt_buffer_addstr(err, _("Could not create temporary file"));
+    return MUTT_CMD_ERROR;
+  }
+
+  mutt_hcache_stats_dump(fpout);
+  mutt_file_fclose(&fpout);
+
+  struct Pager info = { 0 };
+  if (mutt_pager("hcache", tempfile, 0, &info) == -1)
+  {
+    mutt_buffer_addstr(err, _("Could not create temporary file"));
+    return MUTT_CMD_ERROR;
+  }
+
+  return MUTT_CMD_SUCCESS;
+}
+#endif
+
 /**
  * icmd_set - Parse 'set' command to display config - Implements ::icommand_t
  */
@@ -71,15 +71,17 @@ static const char *const Capabilities[] = {
   "AUTH=GSSAPI", "AUTH=ANONYMOUS", "AUTH=OAUTHBEARER",
   "STARTTLS",    "LOGINDISABLED",  "IDLE",
   "SASL-IR",     "ENABLE",         "CONDSTORE",
-  "QRESYNC",     "X-GM-EXT-1",     NULL,
+  "QRESYNC",     "X-GM-EXT-1",     "COMPRESS=DEFLATE",
+  "BINARY",      "NOTIFY",         "MULTIAPPEND",
+  "LITERAL+",    "LITERAL-",       NULL,
 };
 
 /**
- * cmd_queue_full - Is the IMAP command queue full?
+ * imap_cmd_queue_full - Is the IMAP command queue full?
  * @param adata Imap Account data
  * @retval true Queue is full
  */
-static bool cmd_queue_full(struct ImapAccountData *adata)
+bool imap_cmd_queue_full(struct ImapAccountData *adata)
 {
   if ((adata->nextcmd + 1) % adata->cmdslots == adata->lastcmd)
     return true;
@@ -97,7 +99,7 @@ static struct ImapCommand *cmd_new(struct ImapAccountData *adata)
 {
   struct ImapCommand *cmd = NULL;
 
-  if (cmd_queue_full(adata))
+  if (imap_cmd_queue_full(adata))
   {
     mutt_debug(LL_DEBUG3, "IMAP command queue full\n");
     return NULL;
@@ -127,7 +129,7 @@ static struct ImapCommand *cmd_new(struct ImapAccountData *adata)
  */
 static int cmd_queue(struct ImapAccountData *adata, const char *cmdstr, int flags)
 {
-  if (cmd_queue_full(adata))
+  if (imap_cmd_queue_full(adata))
   {
     mutt_debug(LL_DEBUG3, "Draining IMAP command pipeline\n");
 
@@ -778,6 +780,7 @@ static void cmd_parse_status(struct ImapAccountData *adata, char *s)
   unsigned int olduv, oldun;
   unsigned int litlen;
   short new = 0;
+  bool unseen = false;
 
   char *mailbox = imap_next_word(s);
 
@@ -852,7 +855,10 @@ static void cmd_parse_status(struct ImapAccountData *adata, char *s)
     else if (mutt_str_startswith(s, "UIDVALIDITY", CASE_MATCH))
       mdata->uid_validity = count;
     else if (mutt_str_startswith(s, "UNSEEN", CASE_MATCH))
+    {
       mdata->unseen = count;
+      unseen = true;
+    }
 
     s = value;
     if (*s && *s != ')')
@@ -862,6 +868,16 @@ static void cmd_parse_status(struct ImapAccountData *adata, char *s)
              mdata->name, mdata->uid_validity, mdata->uid_next, mdata->messages,
              mdata->recent, mdata->unseen);
 
+  /* NOTIFY's events may leave out UNSEEN; a STATUS of our own fills it in.
+   * Until then, keep the old UIDNEXT so that the new mail is noticed. */
+  mdata->notify_stale = !unseen;
+  if (!unseen)
+  {
+    adata->notify_stale = true;
+    mdata->uid_next = oldun;
+    return;
+  }
+
   mutt_debug(LL_DEBUG3, "Running default STATUS handler\n");
 
   mutt_debug(LL_DEBUG3, "Found %s in mailbox list (OV: %u ON: %u U: %d)\n",
@@ -1002,6 +1018,12 @@ static int cmd_handle_untagged(struct ImapAccountData *adata)
     cmd_parse_status(adata, s);
   else if (mutt_str_startswith(s, "ENABLED", CASE_IGNORE))
     cmd_parse_enabled(adata, s);
+  else if (mutt_str_startswith(s, "OK [NOTIFICATIONOVERFLOW]", CASE_IGNORE))
+  {
+    /* the server has stopped sending events until NOTIFY is set again */
+    mutt_debug(LL_DEBUG2, "NOTIFY overflowed\n");
+    adata->notify = false;
+  }
   else if (mutt_str_startswith(s, "BYE", CASE_IGNORE))
   {
     mutt_debug(LL_DEBUG2, "Handling BYE\n");
@@ -1013,6 +1035,15 @@ static int cmd_handle_untagged(struct ImapAccountData *adata)
     /* server shut down our connection */
     s += 3;
     SKIPWS(s);
+
+    /* an extra STATUS connection is quietly reopened when it's next needed */
+    if (adata->pooled)
+    {
+      mutt_debug(LL_DEBUG1, "Pool connection closed: %s\n", s);
+      adata->status = IMAP_FATAL;
+      return -1;
+    }
+
     mutt_error("%s", s);
     cmd_handle_fatal(adata);
 
@@ -1043,6 +1074,19 @@ int imap_cmd_start(struct ImapAccountData *adata, const char *cmdstr)
   return cmd_start(adata, cmdstr, 0);
 }
 
+/**
+ * imap_cmd_last_seq - Get the tag of the most recently queued command
+ * @param adata Imap Account data
+ * @retval ptr Command tag, e.g. 'a0001'
+ *
+ * Callers that keep several commands in flight use this to match each
+ * tagged completion to the command that caused it.
+ */
+const char *imap_cmd_last_seq(struct ImapAccountData *adata)
+{
+  return adata->cmds[(adata->nextcmd + adata->cmdslots - 1) % adata->cmdslots].seq;
+}
+
 /**
  * imap_cmd_step - Reads server responses from an IMAP command
  * @param adata Imap Account data
@@ -71,6 +71,8 @@
 
 /* These Config Variables are only used in imap/imap.c */
 bool ImapIdle; ///< Config: (imap) Use the IMAP IDLE extension to check for new mail
+bool ImapNotify; ///< Config: (imap) Let the server report changes to mailboxes using NOTIFY
+short ImapStatusConnections; ///< Config: (imap) Number of extra connections used to check mailboxes
 
 /**
  * check_capabilities - Make sure we can log in to this server
@@ -693,6 +695,9 @@ void imap_logout_all(void)
     if (!adata)
       continue;
 
+    for (int i = 0; i < adata->poolsize; i++)
+      imap_logout(adata->pool[i]);
+
     struct Connection *conn = adata->conn;
     if (!conn || (conn->fd < 0))
       continue;
@@ -707,18 +712,19 @@ void imap_logout_all(void)
  * imap_read_literal - Read bytes bytes from server into file
  * @param fp    File handle for email file
  * @param adata Imap Account data
- * @param bytes Number of bytes to read
- * @param pbar  Progress bar
+ * @param bytes  Number of bytes to read
+ * @param pbar   Progress bar
+ * @param binary If true, copy the bytes unchanged
  * @retval  0 Success
  * @retval -1 Failure
  *
  * Not explicitly buffered, relies on FILE buffering.
  *
- * @note Strips `\r` from `\r\n`.
+ * @note Strips `\r` from `\r\n`, unless the data is binary.
  *       Apparently even literals use `\r\n`-terminated strings ?!
  */
 int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
-                      unsigned long bytes, struct Progress *pbar)
+                      unsigned long bytes, struct Progress *pbar, bool binary)
 {
   char c;
   bool r = false;
@@ -743,7 +749,7 @@ int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
     if (r && c != '\n')
       fputc('\r', fp);
 
-    if (c == '\r')
+    if ((c == '\r') && !binary)
     {
       r = true;
       continue;
@@ -944,6 +950,7 @@ void imap_close_connection(struct ImapAccountData *adata)
     mutt_socket_close(adata->conn);
     adata->state = IMAP_DISCONNECTED;
   }
+  adata->notify = false;
   adata->seqno = false;
   adata->nextcmd = false;
   adata->lastcmd = false;
@@ -1185,6 +1192,126 @@ int imap_sync_message_for_copy(struct Mailbox *m, struct Email *e,
   return 0;
 }
 
+/**
+ * imap_pool_drain - Read the replies on the extra connections
+ * @param adata Imap Account data
+ * @param wait  Wait for the outstanding replies, too
+ *
+ * Without wait, this only reads what has already arrived, so it's cheap
+ * enough to call often.
+ */
+static void imap_pool_drain(struct ImapAccountData *adata, bool wait)
+{
+  for (int i = 0; i < adata->poolsize; i++)
+  {
+    struct ImapAccountData *pool = adata->pool[i];
+    int rc = 0;
+
+    while ((pool->state >= IMAP_AUTHENTICATED) && (pool->lastcmd != pool->nextcmd))
+    {
+      if (!wait || (ImapPollTimeout > 0))
+      {
+        rc = mutt_socket_poll(pool->conn, wait ? ImapPollTimeout : 0);
+        if ((rc == 0) && wait)
+        {
+          mutt_debug(LL_DEBUG1, "Timed out waiting for the pool connection\n");
+          rc = -1;
+        }
+        if (rc <= 0)
+          break;
+      }
+      imap_cmd_step(pool);
+      if (pool->status == IMAP_FATAL)
+        break;
+    }
+
+    /* a broken connection is reopened the next time it's needed */
+    if ((rc < 0) || (pool->status == IMAP_FATAL))
+      imap_close_connection(pool);
+  }
+}
+
+/**
+ * imap_pool_wait_all - Wait for the STATUS replies on the extra connections
+ *
+ * Called at the end of a mailbox check, so that the counts are up to date
+ * before they're displayed.
+ */
+void imap_pool_wait_all(void)
+{
+  struct Account *np = NULL;
+  TAILQ_FOREACH(np, &AllAccounts, entries)
+  {
+    if ((np->magic != MUTT_IMAP) || !np->adata)
+      continue;
+
+    imap_pool_drain(np->adata, true);
+  }
+}
+
+/**
+ * imap_pool_get - Pick an extra connection for a STATUS command
+ * @param adata Imap Account data
+ * @retval ptr  Connection with room for another command
+ * @retval NULL Use the main connection
+ *
+ * The pool grows one connection at a time, up to $imap_status_connections,
+ * and the connections are used in turn.
+ */
+static struct ImapAccountData *imap_pool_get(struct ImapAccountData *adata)
+{
+  if ((ImapStatusConnections <= 0) || (adata->state < IMAP_AUTHENTICATED))
+    return NULL;
+
+  imap_pool_drain(adata, false);
+
+  if (!adata->poolfull && (adata->poolsize < ImapStatusConnections))
+  {
+    struct ImapAccountData *pool = imap_adata_new();
+    pool->conn_account = adata->conn_account;
+    pool->pooled = true;
+    /* the main connection's account holds the password */
+    pool->conn = mutt_conn_new(&adata->conn->account);
+    if (pool->conn && (imap_login(pool) == 0))
+    {
+      mutt_mem_realloc(&adata->pool, (adata->poolsize + 1) * sizeof(*adata->pool));
+      adata->pool[adata->poolsize++] = pool;
+    }
+    else
+    {
+      mutt_debug(LL_DEBUG1, "Server refused connection %d, keeping %d\n",
+                 adata->poolsize + 1, adata->poolsize);
+      imap_adata_free((void **) &pool);
+      adata->poolfull = true;
+    }
+  }
+
+  const int num = MIN(adata->poolsize, ImapStatusConnections);
+  if (num == 0)
+    return NULL;
+
+  struct ImapAccountData *pool = adata->pool[adata->poolnext % num];
+  adata->poolnext = (adata->poolnext + 1) % num;
+
+  if ((pool->state == IMAP_DISCONNECTED) && (imap_login(pool) < 0))
+    return NULL;
+
+  /* make room by waiting for the oldest reply */
+  while (imap_cmd_queue_full(pool))
+  {
+    const int rc = imap_cmd_step(pool);
+    if (pool->status == IMAP_FATAL)
+    {
+      imap_close_connection(pool);
+      return NULL;
+    }
+    if (rc != IMAP_CMD_CONTINUE)
+      break;
+  }
+
+  return pool;
+}
+
 /**
  * imap_check_mailbox - use the NOOP or IDLE command to poll for new mail
  * @param m     Mailbox
@@ -1202,6 +1329,9 @@ int imap_check_mailbox(struct Mailbox *m, bool force)
   struct ImapAccountData *adata = imap_adata_get(m);
   struct ImapMboxData *mdata = imap_mdata_get(m);
 
+  /* pick up any other mailboxes' STATUS that has arrived meanwhile */
+  imap_pool_drain(adata, false);
+
   /* overload keyboard timeout to avoid many mailbox checks in a row.
    * Most users don't like having to wait exactly when they press a key. */
   int result = 0;
@@ -1290,7 +1420,18 @@ static int imap_status(struct ImapAccountData *adata, struct ImapMboxData *mdata
   snprintf(command, sizeof(command), "STATUS %s (UIDNEXT %s UNSEEN RECENT MESSAGES)",
            mdata->munge_name, uid_validity_flag);
 
-  int rc = imap_exec(adata, command, queue ? IMAP_CMD_QUEUE : 0 | IMAP_CMD_POLL);
+  /* Spread the STATUS commands over the extra connections, if any.  They're
+   * sent straight away and their replies are read as they arrive. */
+  struct ImapAccountData *pool = queue ? imap_pool_get(adata) : NULL;
+  int rc;
+  if (pool)
+  {
+    rc = imap_cmd_start(pool, command);
+    if (rc < 0)
+      imap_close_connection(pool);
+  }
+  else
+    rc = imap_exec(adata, command, queue ? IMAP_CMD_QUEUE : 0 | IMAP_CMD_POLL);
   if (rc < 0)
   {
     mutt_debug(LL_DEBUG1, "Error queueing command\n");
@@ -1299,11 +1440,143 @@ static int imap_status(struct ImapAccountData *adata, struct ImapMboxData *mdata
   return mdata->messages;
 }
 
+/**
+ * imap_notify_set - Ask the server to report changes to an Account's Mailboxes
+ * @param a Account
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * RFC5465: The server sends EXISTS, EXPUNGE and FETCH for the selected
+ * mailbox, as usual, and STATUS for the others whenever they change.  The
+ * STATUS option gets us the current state of every mailbox to start with.
+ */
+static int imap_notify_set(struct Account *a)
+{
+  struct ImapAccountData *adata = a->adata;
+  struct Buffer *cmd = mutt_buffer_new();
+  struct MailboxNode *np = NULL;
+  int count = 0;
+
+  mutt_buffer_addstr(cmd, "NOTIFY SET STATUS (SELECTED (MessageNew MessageExpunge "
+                          "FlagChange)) (MAILBOXES (");
+  STAILQ_FOREACH(np, &a->mailboxes, entries)
+  {
+    struct ImapMboxData *mdata = imap_mdata_get(np->mailbox);
+    if (!mdata)
+      continue;
+
+    mutt_buffer_add_printf(cmd, "%s%s", (count++ == 0) ? "" : " ", mdata->munge_name);
+  }
+  mutt_buffer_addstr(cmd, ") (MessageNew MessageExpunge FlagChange))");
+
+  int rc = -1;
+  if (count == 0)
+    goto done;
+
+  adata->notify = true;
+  if (imap_exec(adata, cmd->data, IMAP_CMD_POLL) != IMAP_EXEC_SUCCESS)
+  {
+    mutt_debug(LL_DEBUG1, "NOTIFY failed, checking mailboxes with STATUS\n");
+    adata->notify = false;
+    adata->capabilities &= ~IMAP_CAP_NOTIFY;
+    goto done;
+  }
+
+  STAILQ_FOREACH(np, &a->mailboxes, entries)
+  {
+    struct ImapMboxData *mdata = imap_mdata_get(np->mailbox);
+    if (mdata)
+      mdata->notify = true;
+  }
+  rc = 0;
+
+done:
+  mutt_buffer_free(&cmd);
+  return rc;
+}
+
+/**
+ * imap_notify_poll - Read the NOTIFY events that have arrived
+ * @param a Account
+ *
+ * The events are handled like any other untagged response.  Mailboxes whose
+ * STATUS left out some counts are then asked for them, all in one go.
+ */
+static void imap_notify_poll(struct Account *a)
+{
+  struct ImapAccountData *adata = a->adata;
+
+  while (mutt_socket_poll(adata->conn, 0) > 0)
+  {
+    imap_cmd_step(adata);
+    if (adata->status == IMAP_FATAL)
+    {
+      adata->notify = false;
+      return;
+    }
+  }
+
+  /* nothing else will keep an idle connection alive */
+  if ((adata->state == IMAP_AUTHENTICATED) && (time(NULL) >= adata->lastread + ImapKeepalive))
+    imap_exec(adata, "NOOP", IMAP_CMD_POLL);
+
+  if (!adata->notify_stale)
+    return;
+  adata->notify_stale = false;
+
+  struct MailboxNode *np = NULL;
+  STAILQ_FOREACH(np, &a->mailboxes, entries)
+  {
+    struct ImapMboxData *mdata = imap_mdata_get(np->mailbox);
+    if (mdata && mdata->notify_stale)
+    {
+      mdata->notify_stale = false;
+      imap_status(adata, mdata, true);
+    }
+  }
+
+  if (mutt_buffer_len(adata->cmdbuf) > 0)
+    imap_exec(adata, NULL, IMAP_CMD_POLL);
+}
+
+/**
+ * imap_notify_check - Is NOTIFY keeping a Mailbox's counts up to date?
+ * @param m Mailbox
+ * @retval true The Mailbox doesn't need to be checked with STATUS
+ *
+ * The first Mailbox of an Account to be checked sets up NOTIFY for them all.
+ * After that, checking just picks up the events the server has sent.
+ */
+static bool imap_notify_check(struct Mailbox *m)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+
+  if (!ImapNotify || !adata || !mdata || !(adata->capabilities & IMAP_CAP_NOTIFY) ||
+      (adata->state < IMAP_AUTHENTICATED) || (adata->status == IMAP_FATAL))
+  {
+    return false;
+  }
+
+  /* new mailboxes, or a new connection, need a new NOTIFY */
+  if (!adata->notify || !mdata->notify)
+  {
+    if (imap_notify_set(m->account) < 0)
+      return false;
+  }
+
+  imap_notify_poll(m->account);
+  return adata->notify;
+}
+
 /**
  * imap_mbox_check_stats - Implements MxOps::mbox_check_stats()
  */
 int imap_mbox_check_stats(struct Mailbox *m, int flags)
 {
+  if (imap_notify_check(m))
+    return 0;
+
   int rc = imap_mailbox_status(m, true);
   if (rc > 0)
     rc = 0;
@@ -1932,6 +2205,18 @@ int imap_login(struct ImapAccountData *adata)
     /* capabilities may have changed */
     imap_exec(adata, "CAPABILITY", IMAP_CMD_QUEUE);
 
+#ifdef USE_ZLIB
+    /* RFC4978: compress the rest of the session.  The capabilities are
+     * needed first, and nothing else may be in flight when it starts. */
+    if (ImapDeflate && (imap_exec(adata, NULL, 0) == IMAP_EXEC_SUCCESS) &&
+        (adata->capabilities & IMAP_CAP_COMPRESS) &&
+        (imap_exec(adata, "COMPRESS DEFLATE", 0) == IMAP_EXEC_SUCCESS) &&
+        (mutt_zstrm_wrap_conn(adata->conn) == 0))
+    {
+      mutt_debug(LL_DEBUG2, "Communication compressed with DEFLATE\n");
+    }
+#endif
+
     /* enable RFC6855, if the server supports that */
     if (adata->capabilities & IMAP_CAP_ENABLE)
       imap_exec(adata, "ENABLE UTF8=ACCEPT", IMAP_CMD_QUEUE);
@@ -2181,6 +2466,8 @@ static int imap_mbox_open_append(struct Mailbox *m, int flags)
   struct ImapAccountData *adata = imap_adata_get(m);
   struct ImapMboxData *mdata = imap_mdata_get(m);
 
+  mdata->batch = (flags & MUTT_BATCH);
+
   int rc = imap_mailbox_status(m, false);
   if (rc >= 0)
     return 0;
@@ -2234,6 +2521,11 @@ static int imap_mbox_close(struct Mailbox *m)
   if (!adata || !mdata)
     return 0;
 
+  /* Don't lose a batch of messages if the caller didn't flush it */
+  if (mdata->append_count > 0)
+    imap_append_flush(m);
+  mdata->batch = false;
+
   /* imap_mbox_open_append() borrows the struct ImapAccountData temporarily,
    * just for the connection.
    *
@@ -2262,6 +2554,14 @@ static int imap_mbox_close(struct Mailbox *m)
   return 0;
 }
 
+/**
+ * imap_mbox_flush - Implements MxOps::mbox_flush()
+ */
+static int imap_mbox_flush(struct Mailbox *m)
+{
+  return imap_append_flush(m);
+}
+
 /**
  * imap_msg_open_new - Implements MxOps::msg_open_new()
  */
@@ -2530,6 +2830,7 @@ struct MxOps MxImapOps = {
   .mbox_check_stats = imap_mbox_check_stats,
   .mbox_sync        = NULL, /* imap syncing is handled by imap_sync_mailbox */
   .mbox_close       = imap_mbox_close,
+  .mbox_flush       = imap_mbox_flush,
   .msg_open         = imap_msg_open,
   .msg_open_new     = imap_msg_open_new,
   .msg_commit       = imap_msg_commit,
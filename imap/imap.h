@@ -51,9 +51,11 @@
 #include "conn/conn.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <sys/types.h>
 #include "mx.h"
 
+struct Body;
 struct BrowserState;
 struct Email;
 struct EmailList;
@@ -64,9 +66,12 @@ extern char *ImapAuthenticators;
 
 /* These Config Variables are only used in imap/imap.c */
 extern bool ImapIdle;
+extern bool ImapNotify;
+extern short ImapStatusConnections;
 
 /* These Config Variables are only used in imap/message.c */
 extern char *ImapHeaders;
+extern long ImapPartialFetch;
 
 /* These Config Variables are only used in imap/command.c */
 extern bool ImapServernoise;
@@ -88,6 +93,7 @@ int imap_complete(char *buf, size_t buflen, char *path);
 int imap_fast_trash(struct Mailbox *m, char *dest);
 int imap_path_probe(const char *path, const struct stat *st);
 int imap_path_canon(char *buf, size_t buflen);
+void imap_pool_wait_all(void);
 
 extern struct MxOps MxImapOps;
 
@@ -98,6 +104,10 @@ int imap_mailbox_rename(const char *path);
 
 /* message.c */
 int imap_copy_messages(struct Mailbox *m, struct EmailList *el, char *dest, bool delete);
+int imap_fetch_part(struct Mailbox *m, struct Email *e, const char *section, bool text, FILE *fp, bool *decoded);
+void imap_allow_partial(struct Mailbox *m, struct Email *e, bool allow);
+bool imap_part_missing(struct Mailbox *m, struct Email *e, struct Body *b);
+int imap_fetch_missing_part(struct Mailbox *m, struct Email *e, struct Body *b, FILE *fp_msg, FILE **fp, struct Body **part);
 
 /* socket.c */
 void imap_logout_all(void);
@@ -135,8 +135,14 @@ enum ImapState
 #define IMAP_CAP_CONDSTORE        (1 << 14) ///< RFC7162
 #define IMAP_CAP_QRESYNC          (1 << 15) ///< RFC7162
 #define IMAP_CAP_X_GM_EXT1        (1 << 16) ///< https://developers.google.com/gmail/imap/imap-extensions
+#define IMAP_CAP_COMPRESS         (1 << 17) ///< RFC4978: COMPRESS=DEFLATE
+#define IMAP_CAP_BINARY           (1 << 18) ///< RFC3516: BINARY
+#define IMAP_CAP_NOTIFY           (1 << 19) ///< RFC5465: NOTIFY
+#define IMAP_CAP_MULTIAPPEND      (1 << 20) ///< RFC3502: MULTIAPPEND
+#define IMAP_CAP_LITERALPLUS      (1 << 21) ///< RFC7888: LITERAL+
+#define IMAP_CAP_LITERALMINUS     (1 << 22) ///< RFC7888: LITERAL-
 
-#define IMAP_CAP_ALL             ((1 << 17) - 1)
+#define IMAP_CAP_ALL             ((1 << 23) - 1)
 
 /**
  * struct ImapList - Items in an IMAP browser
@@ -189,6 +195,8 @@ struct ImapAccountData
 
   bool unicode; /* If true, we can send UTF-8, and the server will use UTF8 rather than mUTF7 */
   bool qresync; /* true, if QRESYNC is successfully ENABLE'd */
+  bool notify;  /* true, if NOTIFY SET is in effect */
+  bool notify_stale; /* true, if NOTIFY left some mailbox's counts incomplete */
 
   /* if set, the response parser will store results for complicated commands
    * here. */
@@ -203,6 +211,27 @@ struct ImapAccountData
 
   char delim;
   struct Mailbox *mailbox;     /* Current selected mailbox */
+
+  /* extra connections for STATUS, see $imap_status_connections */
+  struct ImapAccountData **pool;
+  int poolsize;  ///< Number of connections in the pool
+  int poolnext;  ///< Pool connection to use next
+  bool poolfull; ///< The server refused another connection
+  bool pooled;   ///< This is one of the extra connections
+};
+
+/**
+ * struct ImapAppend - A message waiting to be uploaded
+ *
+ * A Mailbox opened with #MUTT_BATCH keeps the messages committed to it until
+ * imap_append_flush() sends them all.
+ */
+struct ImapAppend
+{
+  char *path;                ///< Temporary file holding the message
+  size_t len;                ///< Size of the message, with CRLF line endings
+  char flags[SHORT_STRING];  ///< IMAP flags, e.g. "\Seen \Flagged"
+  char date[IMAP_DATELEN];   ///< Date the message was received
 };
 
 /**
@@ -228,6 +257,14 @@ struct ImapMboxData
   unsigned int messages;
   unsigned int recent;
   unsigned int unseen;
+  bool notify;       /**< The server reports changes with NOTIFY */
+  bool notify_stale; /**< NOTIFY sent a STATUS without UNSEEN */
+
+  // Messages appended with #MUTT_BATCH
+  bool batch;                  /**< Keep messages until imap_append_flush() */
+  struct ImapAppend *appends;  /**< Messages waiting to be uploaded */
+  int append_count;            /**< Number of messages waiting */
+  int append_max;              /**< Allocation size of appends */
 
   // Cached data used only when the mailbox is opened
   struct Hash *uid_hash;
@@ -265,7 +302,7 @@ int imap_exec_msgset(struct Mailbox *m, const char *pre, const char *post,
                      int flag, bool changed, bool invert);
 int imap_open_connection(struct ImapAccountData *adata);
 void imap_close_connection(struct ImapAccountData *adata);
-int imap_read_literal(FILE *fp, struct ImapAccountData *adata, unsigned long bytes, struct Progress *pbar);
+int imap_read_literal(FILE *fp, struct ImapAccountData *adata, unsigned long bytes, struct Progress *pbar, bool binary);
 void imap_expunge_mailbox(struct Mailbox *m);
 int imap_login(struct ImapAccountData *adata);
 int imap_sync_message_for_copy(struct Mailbox *m, struct Email *e, struct Buffer *cmd, int *err_continue);
@@ -283,6 +320,8 @@ bool imap_code(const char *s);
 const char *imap_cmd_trailer(struct ImapAccountData *adata);
 int imap_exec(struct ImapAccountData *adata, const char *cmdstr, int flags);
 int imap_cmd_idle(struct ImapAccountData *adata);
+bool imap_cmd_queue_full(struct ImapAccountData *adata);
+const char *imap_cmd_last_seq(struct ImapAccountData *adata);
 
 /* message.c */
 void imap_edata_free(void **ptr);
@@ -292,6 +331,8 @@ char *imap_set_flags(struct Mailbox *m, struct Email *e, char *s, bool *server_c
 int imap_cache_del(struct Mailbox *m, struct Email *e);
 int imap_cache_clean(struct Mailbox *m);
 int imap_append_message(struct Mailbox *m, struct Message *msg);
+int imap_append_flush(struct Mailbox *m);
+void imap_append_free(struct ImapMboxData *mdata);
 
 int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno);
 int imap_msg_close(struct Mailbox *m, struct Message *msg);
@@ -32,8 +32,10 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include "imap_private.h"
 #include "mutt/mutt.h"
@@ -54,6 +56,7 @@
 #include "mutt_socket.h"
 #include "muttlib.h"
 #include "mx.h"
+#include "options.h"
 #include "progress.h"
 #include "protos.h"
 #ifdef USE_HCACHE
@@ -67,6 +70,28 @@ struct BodyCache;
 
 /* These Config Variables are only used in imap/message.c */
 char *ImapHeaders; ///< Config: (imap) Additional email headers to download when getting index
+long ImapPartialFetch; ///< Config: (imap) Display messages larger than this without their attachments
+
+/* Number of messages asked for by the first header FETCH */
+#define FETCH_CHUNK_MIN 256
+/* Most messages asked for by one header FETCH */
+#define FETCH_CHUNK_MAX 16384
+/* Most bytes of messages sent by one MULTIAPPEND */
+#define IMAP_MULTIAPPEND_SIZE (8 * 1024 * 1024)
+
+/**
+ * struct FetchPipeline - Header FETCH commands that are in flight
+ */
+struct FetchPipeline
+{
+  char (*seq)[SEQLEN + 1]; ///< Tags of the commands in flight
+  int depth;               ///< Most commands that may be in flight
+  int num;                 ///< Number of commands in flight
+  unsigned int chunk;      ///< Number of messages to ask for in the next FETCH
+  uint64_t sent;           ///< When the first FETCH was sent, in microseconds
+  uint64_t replied;        ///< When the first header arrived, in microseconds
+  unsigned int received;   ///< Number of headers received
+};
 
 /**
  * imap_edata_free - free ImapHeader structure
@@ -131,12 +156,13 @@ static struct BodyCache *msg_cache_open(struct Mailbox *m)
 
 /**
  * msg_cache_get - Get the message cache entry for an email
- * @param m     Selected Imap Mailbox
- * @param e     Email
+ * @param m       Selected Imap Mailbox
+ * @param e       Email
+ * @param partial If true, get the copy of the email without its attachments
  * @retval ptr  Success, handle of cache entry
  * @retval NULL Failure
  */
-static FILE *msg_cache_get(struct Mailbox *m, struct Email *e)
+static FILE *msg_cache_get(struct Mailbox *m, struct Email *e, bool partial)
 {
   struct ImapAccountData *adata = imap_adata_get(m);
   struct ImapMboxData *mdata = imap_mdata_get(m);
@@ -146,18 +172,20 @@ static FILE *msg_cache_get(struct Mailbox *m, struct Email *e)
 
   mdata->bcache = msg_cache_open(m);
   char id[64];
-  snprintf(id, sizeof(id), "%u-%u", mdata->uid_validity, imap_edata_get(e)->uid);
+  snprintf(id, sizeof(id), "%u-%u%s", mdata->uid_validity,
+           imap_edata_get(e)->uid, partial ? ".partial" : "");
   return mutt_bcache_get(mdata->bcache, id);
 }
 
 /**
  * msg_cache_put - Put an email into the message cache
- * @param m     Selected Imap Mailbox
- * @param e     Email
+ * @param m       Selected Imap Mailbox
+ * @param e       Email
+ * @param partial If true, the email is being stored without its attachments
  * @retval ptr  Success, handle of cache entry
  * @retval NULL Failure
  */
-static FILE *msg_cache_put(struct Mailbox *m, struct Email *e)
+static FILE *msg_cache_put(struct Mailbox *m, struct Email *e, bool partial)
 {
   struct ImapAccountData *adata = imap_adata_get(m);
   struct ImapMboxData *mdata = imap_mdata_get(m);
@@ -167,18 +195,20 @@ static FILE *msg_cache_put(struct Mailbox *m, struct Email *e)
 
   mdata->bcache = msg_cache_open(m);
   char id[64];
-  snprintf(id, sizeof(id), "%u-%u", mdata->uid_validity, imap_edata_get(e)->uid);
+  snprintf(id, sizeof(id), "%u-%u%s", mdata->uid_validity,
+           imap_edata_get(e)->uid, partial ? ".partial" : "");
   return mutt_bcache_put(mdata->bcache, id);
 }
 
 /**
  * msg_cache_commit - Add to the message cache
- * @param m     Selected Imap Mailbox
- * @param e     Email
+ * @param m       Selected Imap Mailbox
+ * @param e       Email
+ * @param partial If true, the email was stored without its attachments
  * @retval  0 Success
  * @retval -1 Failure
  */
-static int msg_cache_commit(struct Mailbox *m, struct Email *e)
+static int msg_cache_commit(struct Mailbox *m, struct Email *e, bool partial)
 {
   struct ImapAccountData *adata = imap_adata_get(m);
   struct ImapMboxData *mdata = imap_mdata_get(m);
@@ -188,9 +218,20 @@ static int msg_cache_commit(struct Mailbox *m, struct Email *e)
 
   mdata->bcache = msg_cache_open(m);
   char id[64];
-  snprintf(id, sizeof(id), "%u-%u", mdata->uid_validity, imap_edata_get(e)->uid);
+  snprintf(id, sizeof(id), "%u-%u%s", mdata->uid_validity,
+           imap_edata_get(e)->uid, partial ? ".partial" : "");
+  if (mutt_bcache_commit(mdata->bcache, id) < 0)
+    return -1;
+
+  /* A complete copy replaces one without the attachments */
+  if (!partial)
+  {
+    snprintf(id, sizeof(id), "%u-%u.partial", mdata->uid_validity,
+             imap_edata_get(e)->uid);
+    mutt_bcache_del(mdata->bcache, id);
+  }
 
-  return mutt_bcache_commit(mdata->bcache, id);
+  return 0;
 }
 
 /**
@@ -470,7 +511,7 @@ static int msg_fetch_header(struct Mailbox *m, struct ImapHeader *ih, char *buf,
 
   if (imap_get_literal_count(buf, &bytes) == 0)
   {
-    imap_read_literal(fp, adata, bytes, NULL);
+    imap_read_literal(fp, adata, bytes, NULL, false);
 
     /* we may have other fields of the FETCH _after_ the literal
      * (eg Domino puts FLAGS here). Nothing wrong with that, either.
@@ -583,68 +624,87 @@ static void imap_alloc_uid_hash(struct ImapAccountData *adata, unsigned int msn_
     mdata->uid_hash = mutt_hash_int_new(MAX(6 * msn_count / 5, 30), 0);
 }
 
+/**
+ * seqset_add_range - Append a range of MSNs to a sequence set
+ * @param b     Buffer for the sequence set
+ * @param begin First Message Sequence number
+ * @param end   Last Message Sequence number
+ */
+static void seqset_add_range(struct Buffer *b, unsigned int begin, unsigned int end)
+{
+  if (mutt_buffer_len(b) > 0)
+    mutt_buffer_addch(b, ',');
+
+  if (begin == end)
+    mutt_buffer_add_printf(b, "%u", begin);
+  else
+    mutt_buffer_add_printf(b, "%u:%u", begin, end);
+}
+
 /**
  * imap_fetch_msn_seqset - Generate a sequence set
  * @param b         Buffer for the result
- * @param adata Imap Account data
+ * @param adata     Imap Account data
+ * @param evalhc    If true, skip the MSNs that were found in the header cache
  * @param msn_begin First Message Sequence number
  * @param msn_end   Last Message Sequence number
+ * @param msn_count Maximum number of messages to ask for
+ * @retval num Last MSN covered by the sequence set
  *
- * Generates a more complicated sequence set after using the header cache,
- * in case there are missing MSNs in the middle.
+ * Generates a sequence set for, at most, msn_count of the messages between
+ * msn_begin and msn_end.  After using the header cache, there may be missing
+ * MSNs in the middle, so only those are included.
  *
- * There is a suggested limit of 1000 bytes for an IMAP client request.
- * Ideally, we would generate multiple requests if the number of ranges
- * is too big, but for now just abort to using the whole range.
+ * There is a suggested limit of 1000 bytes for an IMAP client request, so
+ * the set is cut short if it has too many ranges.  The caller should continue
+ * from the MSN after the one returned.  If there's nothing to fetch in the
+ * range covered, the buffer is left empty.
  */
-static void imap_fetch_msn_seqset(struct Buffer *b, struct ImapAccountData *adata,
-                                  unsigned int msn_begin, unsigned int msn_end)
+static unsigned int imap_fetch_msn_seqset(struct Buffer *b, struct ImapAccountData *adata,
+                                          bool evalhc, unsigned int msn_begin,
+                                          unsigned int msn_end, unsigned int msn_count)
 {
+  if (!evalhc)
+  {
+    msn_end = MIN(msn_end, msn_begin + msn_count - 1);
+    seqset_add_range(b, msn_begin, msn_end);
+    return msn_end;
+  }
+
   struct ImapMboxData *mdata = adata->mailbox->mdata;
-  int chunks = 0;
-  int state = 0; /* 1: single msn, 2: range of msn */
-  unsigned int range_begin = 0;
+  unsigned int range_begin = 0; /* 0: no range in progress */
   unsigned int range_end = 0;
+  unsigned int wanted = 0;
+  int chunks = 0;
+  unsigned int msn;
 
-  for (unsigned int msn = msn_begin; msn <= (msn_end + 1); msn++)
+  for (msn = msn_begin; msn <= msn_end; msn++)
   {
-    if ((msn <= msn_end) && !mdata->msn_index[msn - 1])
+    if (mdata->msn_index[msn - 1])
     {
-      switch (state)
+      if (range_begin)
       {
-        case 1: /* single: convert to a range */
-          state = 2;
-        /* fallthrough */
-        case 2: /* extend range ending */
-          range_end = msn;
-          break;
-        default:
-          state = 1;
-          range_begin = msn;
+        seqset_add_range(b, range_begin, range_end);
+        range_begin = 0;
+        if ((++chunks == 150) || (mutt_buffer_len(b) > 500))
           break;
       }
+      continue;
     }
-    else if (state)
-    {
-      if (chunks++)
-        mutt_buffer_addch(b, ',');
-      if (chunks == 150)
-        break;
 
-      if (state == 1)
-        mutt_buffer_add_printf(b, "%u", range_begin);
-      else if (state == 2)
-        mutt_buffer_add_printf(b, "%u:%u", range_begin, range_end);
-      state = 0;
-    }
-  }
+    if (wanted == msn_count)
+      break;
+    wanted++;
 
-  /* Too big.  Just query the whole range then. */
-  if ((chunks == 150) || (mutt_str_strlen(b->data) > 500))
-  {
-    b->dptr = b->data;
-    mutt_buffer_add_printf(b, "%u:%u", msn_begin, msn_end);
+    if (!range_begin)
+      range_begin = msn;
+    range_end = msn;
   }
+
+  if (range_begin)
+    seqset_add_range(b, range_begin, range_end);
+
+  return msn - 1;
 }
 
 /**
@@ -995,6 +1055,95 @@ static int read_headers_condstore_qresync_updates(struct ImapAccountData *adata,
 }
 #endif /* USE_HCACHE */
 
+/**
+ * fetch_now - Get a monotonic timestamp
+ * @retval num Time in microseconds
+ */
+static uint64_t fetch_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/**
+ * fetch_pipeline_send - Send a header FETCH, without waiting for the reply
+ * @param adata  Imap Account data
+ * @param fpipe  Pipeline of FETCH commands
+ * @param seqset Messages to fetch
+ * @param hdrreq Headers to fetch
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int fetch_pipeline_send(struct ImapAccountData *adata, struct FetchPipeline *fpipe,
+                               const char *seqset, const char *hdrreq)
+{
+  char *cmd = NULL;
+  safe_asprintf(&cmd, "FETCH %s (UID FLAGS INTERNALDATE RFC822.SIZE %s)", seqset, hdrreq);
+  int rc = imap_cmd_start(adata, cmd);
+  FREE(&cmd);
+  if (rc < 0)
+    return -1;
+
+  mutt_str_strfcpy(fpipe->seq[fpipe->num++], imap_cmd_last_seq(adata), SEQLEN + 1);
+  if (fpipe->sent == 0)
+    fpipe->sent = fetch_now();
+
+  return 0;
+}
+
+/**
+ * fetch_pipeline_done - Is this the completion of one of our FETCHes?
+ * @param fpipe Pipeline of FETCH commands
+ * @param buf   Server response
+ * @retval true The command has been removed from the pipeline
+ */
+static bool fetch_pipeline_done(struct FetchPipeline *fpipe, const char *buf)
+{
+  for (int i = 0; i < fpipe->num; i++)
+  {
+    if (mutt_str_startswith(buf, fpipe->seq[i], CASE_MATCH))
+    {
+      fpipe->num--;
+      memmove(fpipe->seq + i, fpipe->seq + i + 1, (fpipe->num - i) * sizeof(*fpipe->seq));
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * fetch_pipeline_adapt - Size the next FETCH to suit the connection
+ * @param fpipe Pipeline of FETCH commands
+ *
+ * The wait for the first header gives the round-trip time and the headers
+ * since then give the rate at which the server sends them.  The commands in
+ * flight, apart from the one being read, should ask for several round trips'
+ * worth of messages, so the server is never left waiting for the next one.
+ * The size of a FETCH is, at most, doubled each time.
+ */
+static void fetch_pipeline_adapt(struct FetchPipeline *fpipe)
+{
+  const uint64_t now = fetch_now();
+  if ((fpipe->received < 2) || (now <= fpipe->replied))
+    return;
+
+  const double rtt = fpipe->replied - fpipe->sent;
+  const double rate = (fpipe->received - 1) / (double) (now - fpipe->replied);
+  const double want = 4 * rate * rtt / MAX(1, fpipe->depth - 1);
+
+  unsigned int chunk = MIN(2 * fpipe->chunk, FETCH_CHUNK_MAX);
+  if (want < chunk)
+    chunk = MAX((unsigned int) want, fpipe->chunk);
+  if (chunk == fpipe->chunk)
+    return;
+
+  mutt_debug(LL_DEBUG2, "rtt %.1fms, %.0f msgs/s: fetching %u headers per command\n",
+             rtt / 1000, rate * 1000000, chunk);
+  fpipe->chunk = chunk;
+}
+
 /**
  * read_headers_fetch_new - Retrieve new messages from the server
  * @param[in]  m                Imap Selected Mailbox
@@ -1012,11 +1161,13 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
 {
   int rc, mfhrc = 0, retval = -1;
   unsigned int fetch_msn_end = 0;
+  unsigned int next_msn = msn_begin;
   struct Progress progress;
   char *hdrreq = NULL;
   char tempfile[_POSIX_PATH_MAX];
   FILE *fp = NULL;
-  struct ImapHeader h;
+  struct ImapHeader h = { 0 };
+  struct FetchPipeline fpipe = { 0 };
   static const char *const want_headers =
       "DATE FROM SENDER SUBJECT TO CC MESSAGE-ID REFERENCES CONTENT-TYPE "
       "CONTENT-DESCRIPTION IN-REPLY-TO REPLY-TO LINES LIST-POST X-LABEL "
@@ -1059,151 +1210,164 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
   mutt_progress_init(&progress, _("Fetching message headers..."),
                      MUTT_PROGRESS_MSG, ReadInc, msn_end);
 
-  while ((msn_begin <= msn_end) && (fetch_msn_end < msn_end))
-  {
-    struct Buffer *b = mutt_buffer_new();
-    if (evalhc)
-    {
-      /* In case there are holes in the header cache. */
-      evalhc = false;
-      imap_fetch_msn_seqset(b, adata, msn_begin, msn_end);
-    }
-    else
-      mutt_buffer_add_printf(b, "%u:%u", msn_begin, msn_end);
+#ifdef USE_HCACHE
+  /* Write all the new headers in as few transactions as possible */
+  mutt_hcache_begin(mdata->hcache);
+#endif
 
-    fetch_msn_end = msn_end;
-    char *cmd = NULL;
-    safe_asprintf(&cmd, "FETCH %s (UID FLAGS INTERNALDATE RFC822.SIZE %s)", b->data, hdrreq);
-    imap_cmd_start(adata, cmd);
-    FREE(&cmd);
-    mutt_buffer_free(&b);
+  fpipe.depth = MAX(1, adata->cmdslots - 2);
+  fpipe.seq = mutt_mem_calloc(fpipe.depth, sizeof(*fpipe.seq));
+  fpipe.chunk = FETCH_CHUNK_MIN;
 
-    rc = IMAP_CMD_CONTINUE;
-    for (int msgno = msn_begin; rc == IMAP_CMD_CONTINUE; msgno++)
+  /* Keep several FETCHes in flight and parse the headers as they arrive.
+   * When the last FETCH completes, we're done, unless new mail arrived. */
+  while (true)
+  {
+    while ((next_msn <= msn_end) && (fpipe.num < fpipe.depth) && !imap_cmd_queue_full(adata))
     {
-      if (initial_download && SigInt && query_abort_header_download(adata))
+      struct Buffer *b = mutt_buffer_new();
+      fetch_msn_end = imap_fetch_msn_seqset(b, adata, evalhc, next_msn, msn_end, fpipe.chunk);
+      next_msn = fetch_msn_end + 1;
+      rc = 0;
+      if (mutt_buffer_len(b) > 0)
+        rc = fetch_pipeline_send(adata, &fpipe, b->data, hdrreq);
+      mutt_buffer_free(&b);
+      if (rc < 0)
         goto bail;
+    }
 
-      mutt_progress_update(&progress, msgno, -1);
-
-      rewind(fp);
-      memset(&h, 0, sizeof(h));
-      h.edata = imap_edata_new();
-
-      /* this DO loop does two things:
-       * 1. handles untagged messages, so we can try again on the same msg
-       * 2. fetches the tagged response at the end of the last message.
+    if ((fpipe.num == 0) && (next_msn > msn_end))
+    {
+      /* In case we get new mail while fetching the headers.
+       *
+       * Note: The RFC says we shouldn't get any EXPUNGE responses in the
+       * middle of a FETCH.  But just to be cautious, use the current state
+       * of max_msn, not fetch_msn_end to set the next start range.
        */
-      do
-      {
-        rc = imap_cmd_step(adata);
-        if (rc != IMAP_CMD_CONTINUE)
-          break;
-
-        mfhrc = msg_fetch_header(m, &h, adata->buf, fp);
-        if (mfhrc < 0)
-          continue;
+      if (!(mdata->reopen & IMAP_NEWMAIL_PENDING))
+        break;
 
-        if (!ftello(fp))
-        {
-          mutt_debug(LL_DEBUG2, "ignoring fetch response with no body\n");
-          continue;
-        }
+      /* update to the last value we actually pulled down */
+      fetch_msn_end = mdata->max_msn;
+      next_msn = mdata->max_msn + 1;
+      msn_end = mdata->new_mail_count;
+      evalhc = false;
+      while (msn_end > m->email_max)
+        mx_alloc_memory(m);
+      alloc_msn_index(adata, msn_end);
+      mdata->reopen &= ~IMAP_NEWMAIL_PENDING;
+      mdata->new_mail_count = 0;
+      continue;
+    }
 
-        /* make sure we don't get remnants from older larger message headers */
-        fputs("\n\n", fp);
+    if (initial_download && SigInt && query_abort_header_download(adata))
+      goto bail;
 
-        if ((h.edata->msn < 1) || (h.edata->msn > fetch_msn_end))
-        {
-          mutt_debug(LL_DEBUG1, "skipping FETCH response for unknown message number %d\n",
-                     h.edata->msn);
-          continue;
-        }
+    rc = imap_cmd_step(adata);
+    if (fetch_pipeline_done(&fpipe, adata->buf))
+    {
+      if (!imap_code(adata->buf))
+        goto bail;
+      fetch_pipeline_adapt(&fpipe);
+      continue;
+    }
+    if ((rc != IMAP_CMD_CONTINUE) && (rc != IMAP_CMD_OK))
+      goto bail;
 
-        /* May receive FLAGS updates in a separate untagged response (#2935) */
-        if (mdata->msn_index[h.edata->msn - 1])
-        {
-          mutt_debug(LL_DEBUG2, "skipping FETCH response for duplicate message %d\n",
-                     h.edata->msn);
-          continue;
-        }
+    imap_edata_free((void **) &h.edata);
+    rewind(fp);
+    memset(&h, 0, sizeof(h));
+    h.edata = imap_edata_new();
 
-        m->emails[idx] = mutt_email_new();
+    mfhrc = msg_fetch_header(m, &h, adata->buf, fp);
+    if (mfhrc < -1)
+      goto bail;
+    if (mfhrc < 0)
+      continue;
 
-        mdata->max_msn = MAX(mdata->max_msn, h.edata->msn);
-        mdata->msn_index[h.edata->msn - 1] = m->emails[idx];
-        mutt_hash_int_insert(mdata->uid_hash, h.edata->uid, m->emails[idx]);
+    if (!ftello(fp))
+    {
+      mutt_debug(LL_DEBUG2, "ignoring fetch response with no body\n");
+      continue;
+    }
 
-        m->emails[idx]->index = idx;
-        /* messages which have not been expunged are ACTIVE (borrowed from mh
-         * folders) */
-        m->emails[idx]->active = true;
-        m->emails[idx]->changed = false;
-        m->emails[idx]->read = h.edata->read;
-        m->emails[idx]->old = h.edata->old;
-        m->emails[idx]->deleted = h.edata->deleted;
-        m->emails[idx]->flagged = h.edata->flagged;
-        m->emails[idx]->replied = h.edata->replied;
-        m->emails[idx]->received = h.received;
-        m->emails[idx]->edata = (void *) (h.edata);
-        m->emails[idx]->free_edata = imap_edata_free;
-        STAILQ_INIT(&m->emails[idx]->tags);
+    /* make sure we don't get remnants from older larger message headers */
+    fputs("\n\n", fp);
 
-        /* We take a copy of the tags so we can split the string */
-        char *tags_copy = mutt_str_strdup(h.edata->flags_remote);
-        driver_tags_replace(&m->emails[idx]->tags, tags_copy);
-        FREE(&tags_copy);
+    if ((h.edata->msn < 1) || (h.edata->msn > fetch_msn_end))
+    {
+      mutt_debug(LL_DEBUG1, "skipping FETCH response for unknown message number %d\n",
+                 h.edata->msn);
+      continue;
+    }
 
-        if (*maxuid < h.edata->uid)
-          *maxuid = h.edata->uid;
+    /* May receive FLAGS updates in a separate untagged response (#2935) */
+    if (mdata->msn_index[h.edata->msn - 1])
+    {
+      mutt_debug(LL_DEBUG2, "skipping FETCH response for duplicate message %d\n",
+                 h.edata->msn);
+      continue;
+    }
 
-        rewind(fp);
-        /* NOTE: if Date: header is missing, mutt_rfc822_read_header depends
-         *   on h.received being set */
-        m->emails[idx]->env = mutt_rfc822_read_header(fp, m->emails[idx], false, false);
-        /* content built as a side-effect of mutt_rfc822_read_header */
-        m->emails[idx]->content->length = h.content_length;
-        m->size += h.content_length;
+    if (fpipe.received++ == 0)
+      fpipe.replied = fetch_now();
+    mutt_progress_update(&progress, h.edata->msn, -1);
+
+    m->emails[idx] = mutt_email_new();
+
+    mdata->max_msn = MAX(mdata->max_msn, h.edata->msn);
+    mdata->msn_index[h.edata->msn - 1] = m->emails[idx];
+    mutt_hash_int_insert(mdata->uid_hash, h.edata->uid, m->emails[idx]);
+
+    m->emails[idx]->index = idx;
+    /* messages which have not been expunged are ACTIVE (borrowed from mh
+     * folders) */
+    m->emails[idx]->active = true;
+    m->emails[idx]->changed = false;
+    m->emails[idx]->read = h.edata->read;
+    m->emails[idx]->old = h.edata->old;
+    m->emails[idx]->deleted = h.edata->deleted;
+    m->emails[idx]->flagged = h.edata->flagged;
+    m->emails[idx]->replied = h.edata->replied;
+    m->emails[idx]->received = h.received;
+    m->emails[idx]->edata = (void *) (h.edata);
+    m->emails[idx]->free_edata = imap_edata_free;
+    STAILQ_INIT(&m->emails[idx]->tags);
+
+    /* We take a copy of the tags so we can split the string */
+    char *tags_copy = mutt_str_strdup(h.edata->flags_remote);
+    driver_tags_replace(&m->emails[idx]->tags, tags_copy);
+    FREE(&tags_copy);
+
+    if (*maxuid < h.edata->uid)
+      *maxuid = h.edata->uid;
+
+    rewind(fp);
+    /* NOTE: if Date: header is missing, mutt_rfc822_read_header depends
+     *   on h.received being set */
+    m->emails[idx]->env = mutt_rfc822_read_header(fp, m->emails[idx], false, false);
+    /* content built as a side-effect of mutt_rfc822_read_header */
+    m->emails[idx]->content->length = h.content_length;
+    m->size += h.content_length;
 
 #ifdef USE_HCACHE
-        imap_hcache_put(mdata, m->emails[idx]);
+    imap_hcache_put(mdata, m->emails[idx]);
 #endif /* USE_HCACHE */
 
-        m->msg_count++;
-
-        h.edata = NULL;
-        idx++;
-      } while (mfhrc == -1);
-
-      imap_edata_free((void **) &h.edata);
-
-      if ((mfhrc < -1) || ((rc != IMAP_CMD_CONTINUE) && (rc != IMAP_CMD_OK)))
-        goto bail;
-    }
+    m->msg_count++;
 
-    /* In case we get new mail while fetching the headers.
-     *
-     * Note: The RFC says we shouldn't get any EXPUNGE responses in the
-     * middle of a FETCH.  But just to be cautious, use the current state
-     * of max_msn, not fetch_msn_end to set the next start range.
-     */
-    if (mdata->reopen & IMAP_NEWMAIL_PENDING)
-    {
-      /* update to the last value we actually pulled down */
-      fetch_msn_end = mdata->max_msn;
-      msn_begin = mdata->max_msn + 1;
-      msn_end = mdata->new_mail_count;
-      while (msn_end > m->email_max)
-        mx_alloc_memory(m);
-      alloc_msn_index(adata, msn_end);
-      mdata->reopen &= ~IMAP_NEWMAIL_PENDING;
-      mdata->new_mail_count = 0;
-    }
+    h.edata = NULL;
+    idx++;
   }
 
   retval = 0;
 
 bail:
+#ifdef USE_HCACHE
+  mutt_hcache_commit(mdata->hcache);
+#endif
+  imap_edata_free((void **) &h.edata);
+  FREE(&fpipe.seq);
   mutt_file_fclose(&fp);
   FREE(&hdrreq);
 
@@ -1404,35 +1568,19 @@ bail:
 }
 
 /**
- * imap_append_message - Write an email back to the server
- * @param m   Mailbox
- * @param msg Message to save
+ * append_prepare - Get a message ready to be uploaded
+ * @param app Message to upload
+ * @param msg Message that was written
  * @retval  0 Success
  * @retval -1 Failure
  */
-int imap_append_message(struct Mailbox *m, struct Message *msg)
+static int append_prepare(struct ImapAppend *app, struct Message *msg)
 {
-  if (!m || !msg)
-    return -1;
-
-  FILE *fp = NULL;
-  char buf[LONG_STRING * 2];
-  char internaldate[IMAP_DATELEN];
-  char imap_flags[SHORT_STRING];
-  size_t len;
-  struct Progress progressbar;
-  size_t sent;
-  int c, last;
-  int rc;
-
-  struct ImapAccountData *adata = imap_adata_get(m);
-  struct ImapMboxData *mdata = imap_mdata_get(m);
-
-  fp = fopen(msg->path, "r");
+  FILE *fp = fopen(msg->path, "r");
   if (!fp)
   {
     mutt_perror(msg->path);
-    goto fail;
+    return -1;
   }
 
   /* currently we set the \Seen flag on all messages, but probably we
@@ -1441,20 +1589,19 @@ int imap_append_message(struct Mailbox *m, struct Message *msg)
    * expensive (it'd be nice if we had the file size passed in already
    * by the code that writes the file, but that's a lot of changes.
    * Ideally we'd have a Header structure with flag info here... */
-  for (last = EOF, len = 0; (c = fgetc(fp)) != EOF; last = c)
+  int c, last;
+  for (last = EOF, app->len = 0; (c = fgetc(fp)) != EOF; last = c)
   {
     if (c == '\n' && last != '\r')
-      len++;
+      app->len++;
 
-    len++;
+    app->len++;
   }
-  rewind(fp);
-
-  mutt_progress_init(&progressbar, _("Uploading message..."),
-                     MUTT_PROGRESS_SIZE, NetInc, len);
+  mutt_file_fclose(&fp);
 
-  mutt_date_make_imap(internaldate, sizeof(internaldate), msg->received);
+  mutt_date_make_imap(app->date, sizeof(app->date), msg->received);
 
+  char imap_flags[SHORT_STRING];
   imap_flags[0] = 0;
   imap_flags[1] = 0;
 
@@ -1467,66 +1614,247 @@ int imap_append_message(struct Mailbox *m, struct Message *msg)
   if (msg->flags.draft)
     mutt_str_strcat(imap_flags, sizeof(imap_flags), " \\Draft");
 
-  snprintf(buf, sizeof(buf), "APPEND %s (%s) \"%s\" {%lu}", mdata->munge_name,
-           imap_flags + 1, internaldate, (unsigned long) len);
+  mutt_str_strfcpy(app->flags, imap_flags + 1, sizeof(app->flags));
+  return 0;
+}
 
-  imap_cmd_start(adata, buf);
+/**
+ * append_error - Report why the server refused an APPEND
+ * @param adata Imap Account data
+ */
+static void append_error(struct ImapAccountData *adata)
+{
+  mutt_debug(LL_DEBUG1, "command failed: %s\n", adata->buf);
 
-  do
-    rc = imap_cmd_step(adata);
-  while (rc == IMAP_CMD_CONTINUE);
+  char *pc = adata->buf + SEQLEN;
+  SKIPWS(pc);
+  pc = imap_next_word(pc);
+  mutt_error("%s", pc);
+}
 
-  if (rc != IMAP_CMD_RESPOND)
-  {
-    mutt_debug(LL_DEBUG1, "#1 command failed: %s\n", adata->buf);
+/**
+ * append_messages - Upload messages with a single APPEND command
+ * @param m     Mailbox
+ * @param apps  Messages to upload
+ * @param count Number of messages, more than one needs MULTIAPPEND
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * RFC3502 lets one APPEND carry several messages, which the server stores
+ * all or none of.  Each literal normally waits for the server's go-ahead;
+ * with RFC7888 LITERAL+, or LITERAL- for small messages, it's sent straight
+ * away, so the whole command costs a single round trip.
+ */
+static int append_messages(struct Mailbox *m, struct ImapAppend *apps, int count)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  char buf[LONG_STRING * 2];
+  struct Progress progressbar;
+  size_t total = 0;
+  size_t sent = 0;
+  size_t len;
+  int c, last;
+  int rc;
 
-    char *pc = adata->buf + SEQLEN;
-    SKIPWS(pc);
-    pc = imap_next_word(pc);
-    mutt_error("%s", pc);
-    mutt_file_fclose(&fp);
-    goto fail;
+  /* Check every message before sending anything, so that the batch is
+   * stored all or none */
+  for (int i = 0; i < count; i++)
+  {
+    if (access(apps[i].path, R_OK) != 0)
+    {
+      mutt_perror(apps[i].path);
+      return -1;
+    }
+    total += apps[i].len;
   }
 
-  for (last = EOF, sent = len = 0; (c = fgetc(fp)) != EOF; last = c)
+  mutt_progress_init(&progressbar,
+                     (count == 1) ? _("Uploading message...") : _("Uploading messages..."),
+                     MUTT_PROGRESS_SIZE, NetInc, total);
+
+  for (int i = 0; i < count; i++)
   {
-    if (c == '\n' && last != '\r')
-      buf[len++] = '\r';
+    FILE *fp = fopen(apps[i].path, "r");
+    if (!fp)
+    {
+      mutt_perror(apps[i].path);
+      /* Ending the command here would store the messages sent so far.
+       * Send a bad argument instead, so the server rejects all of them. */
+      if (i > 0)
+      {
+        mutt_socket_send(adata->conn, " (\r\n");
+        do
+          rc = imap_cmd_step(adata);
+        while (rc == IMAP_CMD_CONTINUE);
+      }
+      return -1;
+    }
 
-    buf[len++] = c;
+    const bool nonsync = (adata->capabilities & IMAP_CAP_LITERALPLUS) ||
+                         ((adata->capabilities & IMAP_CAP_LITERALMINUS) &&
+                          (apps[i].len <= 4096));
 
-    if (len > sizeof(buf) - 3)
+    if (i == 0)
     {
-      sent += len;
-      flush_buffer(buf, &len, adata->conn);
-      mutt_progress_update(&progressbar, sent, -1);
+      snprintf(buf, sizeof(buf), "APPEND %s (%s) \"%s\" {%lu%s}", mdata->munge_name,
+               apps[i].flags, apps[i].date, (unsigned long) apps[i].len,
+               nonsync ? "+" : "");
+      imap_cmd_start(adata, buf);
+    }
+    else
+    {
+      snprintf(buf, sizeof(buf), " (%s) \"%s\" {%lu%s}\r\n", apps[i].flags,
+               apps[i].date, (unsigned long) apps[i].len, nonsync ? "+" : "");
+      mutt_socket_send(adata->conn, buf);
     }
-  }
 
-  if (len)
-    flush_buffer(buf, &len, adata->conn);
+    if (!nonsync)
+    {
+      do
+        rc = imap_cmd_step(adata);
+      while (rc == IMAP_CMD_CONTINUE);
 
-  mutt_socket_send(adata->conn, "\r\n");
-  mutt_file_fclose(&fp);
+      if (rc != IMAP_CMD_RESPOND)
+      {
+        append_error(adata);
+        mutt_file_fclose(&fp);
+        return -1;
+      }
+    }
 
-  do
-    rc = imap_cmd_step(adata);
-  while (rc == IMAP_CMD_CONTINUE);
+    for (last = EOF, len = 0; (c = fgetc(fp)) != EOF; last = c)
+    {
+      if (c == '\n' && last != '\r')
+        buf[len++] = '\r';
 
-  if (!imap_code(adata->buf))
-  {
-    mutt_debug(LL_DEBUG1, "#2 command failed: %s\n", adata->buf);
-    char *pc = adata->buf + SEQLEN;
-    SKIPWS(pc);
-    pc = imap_next_word(pc);
-    mutt_error("%s", pc);
-    goto fail;
+      buf[len++] = c;
+
+      if (len > sizeof(buf) - 3)
+      {
+        sent += len;
+        flush_buffer(buf, &len, adata->conn);
+        mutt_progress_update(&progressbar, sent, -1);
+      }
+    }
+
+    if (len)
+    {
+      sent += len;
+      flush_buffer(buf, &len, adata->conn);
+    }
+    mutt_file_fclose(&fp);
+  }
+
+  mutt_socket_send(adata->conn, "\r\n");
+
+  do
+    rc = imap_cmd_step(adata);
+  while (rc == IMAP_CMD_CONTINUE);
+
+  if (!imap_code(adata->buf))
+  {
+    append_error(adata);
+    return -1;
   }
 
   return 0;
+}
 
-fail:
-  return -1;
+/**
+ * imap_append_message - Write an email back to the server
+ * @param m   Mailbox
+ * @param msg Message to save
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * If the Mailbox was opened with #MUTT_BATCH, the message is only uploaded by
+ * imap_append_flush().
+ */
+int imap_append_message(struct Mailbox *m, struct Message *msg)
+{
+  if (!m || !msg)
+    return -1;
+
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  struct ImapAppend app = { 0 };
+
+  if (append_prepare(&app, msg) < 0)
+    return -1;
+
+  if (!mdata->batch)
+  {
+    app.path = msg->path;
+    return append_messages(m, &app, 1);
+  }
+
+  if (mdata->append_count == mdata->append_max)
+  {
+    mdata->append_max = MAX(2 * mdata->append_max, 32);
+    mutt_mem_realloc(&mdata->appends, mdata->append_max * sizeof(*mdata->appends));
+  }
+
+  /* The temporary file is ours now; it's deleted once it's been uploaded */
+  app.path = msg->path;
+  msg->path = NULL;
+  mdata->appends[mdata->append_count++] = app;
+
+  return 0;
+}
+
+/**
+ * imap_append_flush - Upload the messages of a #MUTT_BATCH append
+ * @param m Mailbox
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * With MULTIAPPEND, the messages are sent a few megabytes at a time.
+ * Otherwise, each one needs an APPEND of its own.
+ */
+int imap_append_flush(struct Mailbox *m)
+{
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  struct ImapAccountData *adata = imap_adata_get(m);
+  if (!adata || !mdata)
+    return -1;
+
+  int rc = 0;
+  for (int i = 0; (rc == 0) && (i < mdata->append_count);)
+  {
+    int num = 1;
+    if (adata->capabilities & IMAP_CAP_MULTIAPPEND)
+    {
+      size_t size = mdata->appends[i].len;
+      while ((i + num < mdata->append_count) &&
+             (size + mdata->appends[i + num].len <= IMAP_MULTIAPPEND_SIZE))
+      {
+        size += mdata->appends[i + num].len;
+        num++;
+      }
+    }
+
+    rc = append_messages(m, mdata->appends + i, num);
+    i += num;
+  }
+
+  imap_append_free(mdata);
+  return rc;
+}
+
+/**
+ * imap_append_free - Forget the messages waiting to be uploaded
+ * @param mdata Imap Mailbox data
+ */
+void imap_append_free(struct ImapMboxData *mdata)
+{
+  for (int i = 0; i < mdata->append_count; i++)
+  {
+    unlink(mdata->appends[i].path);
+    FREE(&mdata->appends[i].path);
+  }
+  FREE(&mdata->appends);
+  mdata->append_count = 0;
+  mdata->append_max = 0;
 }
 
 /**
@@ -1724,6 +2052,9 @@ int imap_cache_del(struct Mailbox *m, struct Email *e)
 
   mdata->bcache = msg_cache_open(m);
   char id[64];
+  snprintf(id, sizeof(id), "%u-%u.partial", mdata->uid_validity,
+           imap_edata_get(e)->uid);
+  mutt_bcache_del(mdata->bcache, id);
   snprintf(id, sizeof(id), "%u-%u", mdata->uid_validity, imap_edata_get(e)->uid);
   return mutt_bcache_del(mdata->bcache, id);
 }
@@ -1825,6 +2156,627 @@ char *imap_set_flags(struct Mailbox *m, struct Email *e, char *s, bool *server_c
   return s;
 }
 
+/**
+ * struct PartialBody - One part of a message fetched without its attachments
+ */
+struct PartialBody
+{
+  char *section;             ///< IMAP section, e.g. "2.1", or NULL for the message
+  char *boundary;            ///< Boundary of a multipart
+  bool multipart;            ///< Part contains other parts
+  bool fetch;                ///< Download the content of the part
+  LOFF_T mime_off;           ///< Offset of the part's header in the scratch file
+  LOFF_T mime_len;           ///< Length of the part's header, -1 if not received
+  LOFF_T body_off;           ///< Offset of the content in the scratch file
+  LOFF_T body_len;           ///< Length of the content, -1 if not received
+  struct PartialBody *parts; ///< Parts of a multipart
+  struct PartialBody *next;  ///< Next part of the parent
+};
+
+/**
+ * partial_body_free - Free a tree of PartialBody
+ * @param ptr PartialBody to free
+ */
+static void partial_body_free(struct PartialBody **ptr)
+{
+  if (!ptr)
+    return;
+
+  struct PartialBody *pb = *ptr;
+  while (pb)
+  {
+    struct PartialBody *next = pb->next;
+    partial_body_free(&pb->parts);
+    FREE(&pb->section);
+    FREE(&pb->boundary);
+    FREE(&pb);
+    pb = next;
+  }
+  *ptr = NULL;
+}
+
+/**
+ * partial_body_find - Find a part by its section
+ * @param pb      Parts to search
+ * @param section Section, e.g. "2.1"
+ * @retval ptr  Matching part
+ * @retval NULL Not found
+ */
+static struct PartialBody *partial_body_find(struct PartialBody *pb, const char *section)
+{
+  for (; pb; pb = pb->next)
+  {
+    if (mutt_str_strcmp(pb->section, section) == 0)
+      return pb;
+    struct PartialBody *found = partial_body_find(pb->parts, section);
+    if (found)
+      return found;
+  }
+  return NULL;
+}
+
+/**
+ * partial_body_omits - Will any part be left out?
+ * @param pb Parts to check
+ * @retval true At least one part won't be downloaded
+ */
+static bool partial_body_omits(struct PartialBody *pb)
+{
+  for (; pb; pb = pb->next)
+  {
+    if (pb->multipart ? partial_body_omits(pb->parts) : !pb->fetch)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * bs_parse_string - Parse a string in a BODYSTRUCTURE
+ * @param[in]  s      Text to parse
+ * @param[out] buf    Buffer for the string
+ * @param[in]  buflen Length of the buffer
+ * @retval ptr  Character after the string
+ * @retval NULL Failure
+ *
+ * A quoted string, an atom or a number is accepted.  NIL gives an empty string.
+ * Literals aren't accepted.
+ */
+static char *bs_parse_string(char *s, char *buf, size_t buflen)
+{
+  size_t len = 0;
+
+  SKIPWS(s);
+  if (*s == '"')
+  {
+    for (s++; *s && (*s != '"'); s++)
+    {
+      if ((s[0] == '\\') && s[1])
+        s++;
+      if (len < (buflen - 1))
+        buf[len++] = *s;
+    }
+    if (*s != '"')
+      return NULL;
+    s++;
+  }
+  else
+  {
+    const char *start = s;
+    while (*s && (*s != ' ') && (*s != '(') && (*s != ')') && (*s != '{'))
+      s++;
+    if (s == start)
+      return NULL;
+    if (((s - start) != 3) || (mutt_str_strncasecmp(start, "NIL", 3) != 0))
+    {
+      len = MIN((size_t)(s - start), buflen - 1);
+      memcpy(buf, start, len);
+    }
+  }
+
+  buf[len] = '\0';
+  return s;
+}
+
+/**
+ * bs_skip_value - Skip a value, or a list of values, in a BODYSTRUCTURE
+ * @param s Text to parse
+ * @retval ptr  Character after the value
+ * @retval NULL Failure
+ */
+static char *bs_skip_value(char *s)
+{
+  char tmp[SHORT_STRING];
+  int depth = 0;
+
+  do
+  {
+    SKIPWS(s);
+    if (*s == '(')
+    {
+      depth++;
+      s++;
+    }
+    else if ((*s == ')') && (depth > 0))
+    {
+      depth--;
+      s++;
+    }
+    else if (!(s = bs_parse_string(s, tmp, sizeof(tmp))))
+      return NULL;
+  } while (depth > 0);
+
+  return s;
+}
+
+/**
+ * bs_parse_params - Parse the parameters of a part in a BODYSTRUCTURE
+ * @param[in]  s        Text to parse
+ * @param[out] boundary If not NULL, set to the "boundary" parameter
+ * @retval ptr  Character after the parameters
+ * @retval NULL Failure
+ */
+static char *bs_parse_params(char *s, char **boundary)
+{
+  char attr[SHORT_STRING];
+  char value[LONG_STRING];
+
+  SKIPWS(s);
+  if (*s != '(')
+    return bs_parse_string(s, attr, sizeof(attr));
+
+  for (s++;;)
+  {
+    SKIPWS(s);
+    if (*s == ')')
+      return s + 1;
+    s = bs_parse_string(s, attr, sizeof(attr));
+    if (!s)
+      return NULL;
+    s = bs_parse_string(s, value, sizeof(value));
+    if (!s)
+      return NULL;
+    if (boundary && (mutt_str_strcasecmp(attr, "boundary") == 0))
+      mutt_str_replace(boundary, value);
+  }
+}
+
+/**
+ * bs_parse_body - Parse a part in a BODYSTRUCTURE
+ * @param[in]  s       Text to parse, starting with '('
+ * @param[in]  section Section of the part, "" for the whole message
+ * @param[in]  depth   Nesting level of the part
+ * @param[out] body    Parsed part, to be freed even on failure
+ * @retval ptr  Character after the part
+ * @retval NULL Failure, or the part can't be fetched piecemeal
+ *
+ * Multiparts are parsed recursively.  Any other part, even a message/rfc822,
+ * is treated as a single piece of content.  Signed or encrypted content is
+ * refused, because it can only be checked as a whole.
+ */
+static char *bs_parse_body(char *s, const char *section, int depth, struct PartialBody **body)
+{
+  char type[SHORT_STRING];
+  char subtype[SHORT_STRING];
+  char size[SHORT_STRING];
+
+  SKIPWS(s);
+  if ((*s != '(') || (depth > 16))
+    return NULL;
+  s++;
+
+  struct PartialBody *pb = mutt_mem_calloc(1, sizeof(struct PartialBody));
+  pb->section = mutt_str_strdup(section);
+  pb->mime_len = -1;
+  pb->body_len = -1;
+  *body = pb;
+
+  SKIPWS(s);
+  if (*s == '(')
+  {
+    pb->multipart = true;
+    struct PartialBody **last = &pb->parts;
+    for (int num = 1; *s == '('; num++)
+    {
+      char sub[SHORT_STRING];
+      snprintf(sub, sizeof(sub), "%s%s%d", section, *section ? "." : "", num);
+      s = bs_parse_body(s, sub, depth + 1, last);
+      if (!s)
+        return NULL;
+      last = &(*last)->next;
+      SKIPWS(s);
+    }
+
+    s = bs_parse_string(s, subtype, sizeof(subtype));
+    if (!s || (mutt_str_strcasecmp(subtype, "signed") == 0) ||
+        (mutt_str_strcasecmp(subtype, "encrypted") == 0))
+    {
+      return NULL;
+    }
+    SKIPWS(s);
+    if (*s != ')')
+    {
+      s = bs_parse_params(s, &pb->boundary);
+      if (!s)
+        return NULL;
+    }
+    if (!pb->boundary)
+      return NULL;
+  }
+  else
+  {
+    s = bs_parse_string(s, type, sizeof(type));
+    if (s)
+      s = bs_parse_string(s, subtype, sizeof(subtype));
+    if (!s)
+      return NULL;
+    if ((mutt_str_strcasecmp(type, "application") == 0) &&
+        ((mutt_str_strcasecmp(subtype, "pkcs7-mime") == 0) ||
+         (mutt_str_strcasecmp(subtype, "x-pkcs7-mime") == 0)))
+    {
+      return NULL;
+    }
+
+    /* parameters, id, description, encoding, size */
+    s = bs_parse_params(s, NULL);
+    for (int i = 0; s && (i < 3); i++)
+      s = bs_skip_value(s);
+    if (s)
+      s = bs_parse_string(s, size, sizeof(size));
+    if (!s)
+      return NULL;
+
+    long bytes = 0;
+    if (mutt_str_atol(size, &bytes) < 0)
+      return NULL;
+    pb->fetch = ((mutt_str_strcasecmp(type, "text") == 0) ||
+                 (mutt_str_strcasecmp(type, "message") == 0)) &&
+                (bytes <= ImapPartialFetch);
+  }
+
+  /* skip the rest, e.g. the envelope of a message/rfc822, extension data */
+  while (true)
+  {
+    SKIPWS(s);
+    if (*s == ')')
+      return s + 1;
+    s = bs_skip_value(s);
+    if (!s)
+      return NULL;
+  }
+}
+
+/**
+ * msg_fetch_structure - Get the structure of a message from the server
+ * @param m Selected Imap Mailbox
+ * @param e Email
+ * @retval ptr  Parts of the message
+ * @retval NULL Failure, or the message shouldn't be fetched piecemeal
+ */
+static struct PartialBody *msg_fetch_structure(struct Mailbox *m, struct Email *e)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct PartialBody *root = NULL;
+  char buf[SHORT_STRING];
+  bool usable = true;
+  int rc;
+
+  snprintf(buf, sizeof(buf), "UID FETCH %u BODYSTRUCTURE", imap_edata_get(e)->uid);
+  imap_cmd_start(adata, buf);
+  do
+  {
+    rc = imap_cmd_step(adata);
+    if (rc != IMAP_CMD_CONTINUE)
+      break;
+
+    char *pc = imap_next_word(adata->buf);
+    pc = imap_next_word(pc);
+    if (!mutt_str_startswith(pc, "FETCH", CASE_IGNORE))
+      continue;
+
+    /* A literal (e.g. an 8-bit filename) must be read, but isn't parsed */
+    size_t len = mutt_str_strlen(adata->buf);
+    char *lit = strrchr(adata->buf, '{');
+    if (lit && (len > 0) && (adata->buf[len - 1] == '}'))
+    {
+      usable = false;
+      do
+      {
+        unsigned int bytes;
+        if (imap_get_literal_count(lit, &bytes) < 0)
+          break;
+        for (; bytes > 0; bytes--)
+        {
+          char c;
+          if (mutt_socket_readchar(adata->conn, &c) < 1)
+          {
+            rc = IMAP_CMD_BAD;
+            break;
+          }
+        }
+        if (rc != IMAP_CMD_CONTINUE)
+          break;
+        rc = imap_cmd_step(adata);
+        if (rc != IMAP_CMD_CONTINUE)
+          break;
+        len = mutt_str_strlen(adata->buf);
+        lit = strrchr(adata->buf, '{');
+      } while (lit && (len > 0) && (adata->buf[len - 1] == '}'));
+      if (rc != IMAP_CMD_CONTINUE)
+        break;
+      continue;
+    }
+
+    pc = (char *) mutt_str_stristr(pc, "BODYSTRUCTURE");
+    if (!pc || root)
+      continue;
+    if (!bs_parse_body(pc + 13, "", 0, &root))
+      usable = false;
+  } while (rc == IMAP_CMD_CONTINUE);
+
+  if ((rc != IMAP_CMD_OK) || !usable || !root || !root->multipart ||
+      !partial_body_omits(root))
+  {
+    mutt_debug(LL_DEBUG2, "can't fetch message %u without its attachments\n",
+               imap_edata_get(e)->uid);
+    partial_body_free(&root);
+  }
+
+  return root;
+}
+
+/**
+ * partial_body_items - Build the FETCH items for the parts of a message
+ * @param pb   Parts of the message
+ * @param item "BODY" or "BODY.PEEK"
+ * @param buf  Buffer for the items, each is preceded by a space
+ */
+static void partial_body_items(struct PartialBody *pb, const char *item, struct Buffer *buf)
+{
+  for (; pb; pb = pb->next)
+  {
+    if (pb->section)
+      mutt_buffer_add_printf(buf, " %s[%s.MIME]", item, pb->section);
+    else
+      mutt_buffer_add_printf(buf, " %s[HEADER]", item);
+
+    if (pb->multipart)
+      partial_body_items(pb->parts, item, buf);
+    else if (pb->fetch)
+      mutt_buffer_add_printf(buf, " %s[%s]", item, pb->section);
+  }
+}
+
+/**
+ * partial_copy - Copy a piece of the scratch file
+ * @param fp_in  Scratch file
+ * @param offset Offset of the piece
+ * @param len    Length of the piece
+ * @param fp_out File to write to
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int partial_copy(FILE *fp_in, LOFF_T offset, LOFF_T len, FILE *fp_out)
+{
+  if (len <= 0)
+    return 0;
+  if (fseeko(fp_in, offset, SEEK_SET) != 0)
+    return -1;
+  return mutt_file_copy_bytes(fp_in, fp_out, len);
+}
+
+/**
+ * partial_assemble - Write a message fetched without its attachments
+ * @param pb     Multipart to write
+ * @param fp_in  Scratch file holding the pieces
+ * @param fp_out File to write to
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * The parts that were left out are written with their headers, but no content.
+ */
+static int partial_assemble(struct PartialBody *pb, FILE *fp_in, FILE *fp_out)
+{
+  for (struct PartialBody *part = pb->parts; part; part = part->next)
+  {
+    fprintf(fp_out, "%s--%s\n", (part == pb->parts) ? "" : "\n", pb->boundary);
+    if ((part->mime_len < 0) || (part->fetch && (part->body_len < 0)))
+      return -1;
+    if (partial_copy(fp_in, part->mime_off, part->mime_len, fp_out) < 0)
+      return -1;
+    if (part->multipart)
+    {
+      if (partial_assemble(part, fp_in, fp_out) < 0)
+        return -1;
+    }
+    else if (partial_copy(fp_in, part->body_off, part->body_len, fp_out) < 0)
+      return -1;
+  }
+  fprintf(fp_out, "\n--%s--\n", pb->boundary);
+  return 0;
+}
+
+/**
+ * msg_fetch_partial - Fetch a message without its attachments
+ * @param m Selected Imap Mailbox
+ * @param e Email
+ * @retval ptr  Message cache entry holding the message
+ * @retval NULL Failure, the message should be fetched in full
+ *
+ * The header of the message and of every part is fetched, along with the
+ * content of the small text parts, in a single command.  The pieces are put
+ * back together as a MIME message whose other parts are empty.
+ */
+static FILE *msg_fetch_partial(struct Mailbox *m, struct Email *e)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct PartialBody *root = NULL;
+  struct Buffer *cmd = NULL;
+  FILE *fp_scratch = NULL;
+  FILE *fp = NULL;
+  unsigned int bytes;
+  unsigned int uid;
+  int rc;
+
+  /* mark this header as currently inactive so the command handler won't
+   * also try to update it. See imap_msg_open() */
+  e->active = false;
+
+  root = msg_fetch_structure(m, e);
+  if (!root)
+    goto done;
+
+  fp_scratch = mutt_file_mkstemp();
+  if (!fp_scratch)
+    goto done;
+
+  /* Each item starts with a space, which mustn't follow the parenthesis */
+  struct Buffer *items = mutt_buffer_pool_get();
+  partial_body_items(root, ImapPeek ? "BODY.PEEK" : "BODY", items);
+  cmd = mutt_buffer_pool_get();
+  mutt_buffer_printf(cmd, "UID FETCH %u (%s)", imap_edata_get(e)->uid, mutt_b2s(items) + 1);
+  mutt_buffer_pool_release(&items);
+
+  imap_cmd_start(adata, mutt_b2s(cmd));
+  do
+  {
+    rc = imap_cmd_step(adata);
+    if (rc != IMAP_CMD_CONTINUE)
+      break;
+
+    char *pc = imap_next_word(adata->buf);
+    pc = imap_next_word(pc);
+    if (!mutt_str_startswith(pc, "FETCH", CASE_IGNORE))
+      continue;
+
+    while (*pc)
+    {
+      pc = imap_next_word(pc);
+      if (pc[0] == '(')
+        pc++;
+      if (mutt_str_startswith(pc, "UID", CASE_IGNORE))
+      {
+        pc = imap_next_word(pc);
+        if ((mutt_str_atoui(pc, &uid) < 0) || (uid != imap_edata_get(e)->uid))
+          goto done;
+      }
+      else if (mutt_str_startswith(pc, "BODY[", CASE_IGNORE))
+      {
+        char section[SHORT_STRING];
+        bool mime = false;
+        char *end = strchr(pc, ']');
+        if (!end)
+          goto done;
+        mutt_str_strfcpy(section, pc + 5, MIN(sizeof(section), (size_t)(end - pc - 4)));
+        size_t len = mutt_str_strlen(section);
+        if ((len > 5) && (mutt_str_strcasecmp(section + len - 5, ".MIME") == 0))
+        {
+          section[len - 5] = '\0';
+          mime = true;
+        }
+        else if (mutt_str_strcasecmp(section, "HEADER") == 0)
+        {
+          section[0] = '\0';
+          mime = true;
+        }
+        struct PartialBody *pb = partial_body_find(root, section);
+        if (!pb)
+          goto done;
+
+        if (fseeko(fp_scratch, 0, SEEK_END) != 0)
+          goto done;
+        const LOFF_T offset = ftello(fp_scratch);
+
+        pc = imap_next_word(pc);
+        if (pc[0] == '{')
+        {
+          if (imap_get_literal_count(pc, &bytes) < 0)
+            goto done;
+          if (imap_read_literal(fp_scratch, adata, bytes, NULL, false) < 0)
+            goto done;
+          /* pick up trailing line */
+          rc = imap_cmd_step(adata);
+          if (rc != IMAP_CMD_CONTINUE)
+            goto done;
+          pc = adata->buf;
+        }
+        else
+        {
+          /* A short piece may be sent as a quoted string, or NIL */
+          char str[LONG_STRING];
+          char *next = bs_parse_string(pc, str, sizeof(str));
+          if (!next)
+            goto done;
+          fputs(str, fp_scratch);
+          pc = next;
+        }
+
+        if (mime)
+        {
+          pb->mime_off = offset;
+          pb->mime_len = ftello(fp_scratch) - offset;
+        }
+        else
+        {
+          pb->body_off = offset;
+          pb->body_len = ftello(fp_scratch) - offset;
+        }
+      }
+      else if (mutt_str_startswith(pc, "FLAGS", CASE_IGNORE) && !e->changed)
+      {
+        pc = imap_set_flags(m, e, pc, NULL);
+        if (!pc)
+          goto done;
+      }
+    }
+  } while (rc == IMAP_CMD_CONTINUE);
+
+  if ((rc != IMAP_CMD_OK) || (root->mime_len < 0) || (fflush(fp_scratch) != 0))
+    goto done;
+
+  fp = msg_cache_put(m, e, true);
+  if (!fp)
+    goto done;
+
+  if ((partial_copy(fp_scratch, root->mime_off, root->mime_len, fp) < 0) ||
+      (partial_assemble(root, fp_scratch, fp) < 0) || (fflush(fp) != 0) ||
+      (msg_cache_commit(m, e, true) < 0))
+  {
+    mutt_file_fclose(&fp);
+    goto done;
+  }
+  rewind(fp);
+
+done:
+  e->active = true;
+  mutt_buffer_pool_release(&cmd);
+  mutt_file_fclose(&fp_scratch);
+  partial_body_free(&root);
+  return fp;
+}
+
+/**
+ * msg_update_parts - Keep the parsed parts of an email in step with its file
+ * @param e       Email
+ * @param fp      Message file that is being opened
+ * @param partial True if the file was fetched without its attachments
+ *
+ * The offsets of the parts depend on which file they were parsed from.  If
+ * that, or the file being opened, is a message without its attachments, the
+ * parts are parsed again.
+ */
+static void msg_update_parts(struct Email *e, FILE *fp, bool partial)
+{
+  struct ImapEmailData *edata = imap_edata_get(e);
+
+  if (e->content->parts && (partial || edata->partial))
+  {
+    mutt_body_free(&e->content->parts);
+    mutt_parse_part(fp, e->content);
+    rewind(fp);
+  }
+  edata->partial = partial;
+}
+
 /**
  * imap_msg_open - Implements MxOps::msg_open()
  */
@@ -1840,6 +2792,7 @@ int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
   struct Progress progressbar;
   unsigned int uid;
   bool retried = false;
+  bool partial = false;
   bool read;
   int rc;
 
@@ -1855,22 +2808,50 @@ int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
 
   struct Email *e = m->emails[msgno];
 
-  msg->fp = msg_cache_get(m, e);
+  msg->fp = msg_cache_get(m, e, false);
   if (msg->fp)
   {
     if (imap_edata_get(e)->parsed)
+    {
+      msg_update_parts(e, msg->fp, false);
       return 0;
+    }
     else
       goto parsemsg;
   }
 
+  /* A large message may be displayed without its attachments */
+  const bool want_partial =
+      imap_edata_get(e)->partial_ok && (ImapPartialFetch > 0) &&
+      (e->content->length > ImapPartialFetch) &&
+      (e->content->type == TYPE_MULTIPART) && (adata->capabilities & IMAP_CAP_IMAP4REV1);
+  if (want_partial)
+  {
+    msg->fp = msg_cache_get(m, e, true);
+    if (msg->fp)
+    {
+      partial = true;
+      goto parsemsg;
+    }
+  }
+
   /* This function is called in a few places after endwin()
    * e.g. mutt_pipe_message(). */
   output_progress = !isendwin();
   if (output_progress)
     mutt_message(_("Fetching message..."));
 
-  msg->fp = msg_cache_put(m, e);
+  if (want_partial)
+  {
+    msg->fp = msg_fetch_partial(m, e);
+    if (msg->fp)
+    {
+      partial = true;
+      goto parsemsg;
+    }
+  }
+
+  msg->fp = msg_cache_put(m, e, false);
   if (!msg->fp)
     return -1;
 
@@ -1928,7 +2909,7 @@ int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
                                MUTT_PROGRESS_SIZE, NetInc, bytes);
           }
           if (imap_read_literal(msg->fp, adata, bytes,
-                                output_progress ? &progressbar : NULL) < 0)
+                                output_progress ? &progressbar : NULL, false) < 0)
           {
             goto bail;
           }
@@ -1967,7 +2948,7 @@ int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
   if (!fetched || !imap_code(adata->buf))
     goto bail;
 
-  msg_cache_commit(m, e);
+  msg_cache_commit(m, e, false);
 
 parsemsg:
   /* Update the header information.  Previously, we only downloaded a
@@ -1991,6 +2972,16 @@ parsemsg:
     mutt_set_flag(m, e, MUTT_NEW, read);
   }
 
+  /* The size of the message and its number of lines are those of the whole
+   * message.  The partial body is never longer, so the parts parse correctly. */
+  if (partial)
+  {
+    mutt_clear_error();
+    rewind(msg->fp);
+    msg_update_parts(e, msg->fp, true);
+    return 0;
+  }
+
   e->lines = 0;
   fgets(buf, sizeof(buf), msg->fp);
   while (!feof(msg->fp))
@@ -2013,6 +3004,7 @@ parsemsg:
     goto parsemsg;
   }
 
+  msg_update_parts(e, msg->fp, false);
   return 0;
 
 bail:
@@ -2065,3 +3057,294 @@ int imap_msg_save_hcache(struct Mailbox *m, struct Email *e)
 #endif
   return rc;
 }
+
+/**
+ * msg_fetch_section - Fetch one section of a message
+ * @param m       Selected Imap Mailbox
+ * @param e       Email
+ * @param item    FETCH item, e.g. "BINARY"
+ * @param section Section of the message, e.g. "2.1"
+ * @param binary  If true, don't strip `\r` from the content
+ * @param fp      File to write the content to
+ * @retval  0 Success
+ * @retval -1 Error
+ * @retval -2 The server refused to send the section
+ */
+static int msg_fetch_section(struct Mailbox *m, struct Email *e, const char *item,
+                             const char *section, bool binary, FILE *fp)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  char buf[LONG_STRING];
+  char name[SHORT_STRING];
+  struct Progress progressbar;
+  unsigned int bytes;
+  unsigned int uid;
+  bool fetched = false;
+  int rc;
+
+  /* This function may be called after endwin() */
+  const bool output_progress = !isendwin();
+
+  snprintf(name, sizeof(name), "%s[%s]", item, section);
+  snprintf(buf, sizeof(buf), "UID FETCH %u %s%s[%s]", imap_edata_get(e)->uid,
+           item, ImapPeek ? ".PEEK" : "", section);
+
+  /* mark this header as currently inactive so the command handler won't
+   * also try to update it. See imap_msg_open() */
+  e->active = false;
+
+  imap_cmd_start(adata, buf);
+  do
+  {
+    rc = imap_cmd_step(adata);
+    if (rc != IMAP_CMD_CONTINUE)
+      break;
+
+    char *pc = imap_next_word(adata->buf);
+    pc = imap_next_word(pc);
+    if (!mutt_str_startswith(pc, "FETCH", CASE_IGNORE))
+      continue;
+
+    while (*pc)
+    {
+      pc = imap_next_word(pc);
+      if (pc[0] == '(')
+        pc++;
+      if (mutt_str_startswith(pc, "UID", CASE_IGNORE))
+      {
+        pc = imap_next_word(pc);
+        if ((mutt_str_atoui(pc, &uid) < 0) || (uid != imap_edata_get(e)->uid))
+          goto bail;
+      }
+      else if (mutt_str_startswith(pc, name, CASE_IGNORE))
+      {
+        pc = imap_next_word(pc);
+        /* An empty section may be sent as "" or NIL */
+        if ((pc[0] == '"') || mutt_str_startswith(pc, "NIL", CASE_IGNORE))
+        {
+          fetched = true;
+          continue;
+        }
+        if (imap_get_literal_count(pc, &bytes) < 0)
+        {
+          imap_error("msg_fetch_section()", buf);
+          goto bail;
+        }
+        if (output_progress)
+        {
+          mutt_progress_init(&progressbar, _("Fetching message..."),
+                             MUTT_PROGRESS_SIZE, NetInc, bytes);
+        }
+        if (imap_read_literal(fp, adata, bytes, output_progress ? &progressbar : NULL,
+                              binary) < 0)
+        {
+          goto bail;
+        }
+        /* pick up trailing line */
+        rc = imap_cmd_step(adata);
+        if (rc != IMAP_CMD_CONTINUE)
+          goto bail;
+        pc = adata->buf;
+
+        fetched = true;
+      }
+      else if (mutt_str_startswith(pc, "FLAGS", CASE_IGNORE) && !e->changed)
+      {
+        pc = imap_set_flags(m, e, pc, NULL);
+        if (!pc)
+          goto bail;
+      }
+    }
+  } while (rc == IMAP_CMD_CONTINUE);
+
+  e->active = true;
+
+  if (rc == IMAP_CMD_NO)
+    return -2;
+  if ((rc != IMAP_CMD_OK) || !fetched || (fflush(fp) != 0))
+    return -1;
+
+  return 0;
+
+bail:
+  e->active = true;
+  return -1;
+}
+
+/**
+ * imap_fetch_part - Fetch one part of a message from the server
+ * @param[in]  m       Selected Imap Mailbox
+ * @param[in]  e       Email
+ * @param[in]  section Section of the message, e.g. "2.1"
+ * @param[in]  text    If true, the part is text, so `\r\n` is converted to `\n`
+ * @param[in]  fp      File to write the content to
+ * @param[out] decoded Set to true if the content was decoded by the server
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * If the server supports BINARY (RFC3516), it undoes the part's
+ * Content-Transfer-Encoding before sending it.  That saves sending, then
+ * decoding, a third more data for base64.  Otherwise, or if the server
+ * doesn't understand the part's encoding, the content is sent as it's stored
+ * and the caller has to decode it.
+ */
+int imap_fetch_part(struct Mailbox *m, struct Email *e, const char *section,
+                    bool text, FILE *fp, bool *decoded)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  if (!e || !section || !fp || !decoded || !adata || (adata->mailbox != m))
+    return -1;
+
+  *decoded = false;
+  if (adata->capabilities & IMAP_CAP_BINARY)
+  {
+    const LOFF_T start = ftello(fp);
+    int rc = msg_fetch_section(m, e, "BINARY", section, !text, fp);
+    if (rc == 0)
+    {
+      *decoded = true;
+      return 0;
+    }
+    if (rc == -1)
+      return -1;
+
+    /* [UNKNOWN-CTE] the server can't decode it, so try again without */
+    mutt_debug(LL_DEBUG2, "BINARY fetch of section %s refused\n", section);
+    if ((fseeko(fp, start, SEEK_SET) != 0) || (ftruncate(fileno(fp), start) != 0))
+      return -1;
+  }
+
+  if (msg_fetch_section(m, e, "BODY", section, false, fp) != 0)
+    return -1;
+
+  return 0;
+}
+
+/**
+ * imap_allow_partial - Let an email be opened without its attachments
+ * @param m     Mailbox
+ * @param e     Email
+ * @param allow True if the caller can use a message with some parts left out
+ *
+ * See $imap_partial_fetch.
+ */
+void imap_allow_partial(struct Mailbox *m, struct Email *e, bool allow)
+{
+  if (!m || (m->magic != MUTT_IMAP) || !e || !e->edata)
+    return;
+
+  imap_edata_get(e)->partial_ok = allow;
+}
+
+/**
+ * imap_part_missing - Was a part left out when the message was fetched?
+ * @param m Mailbox
+ * @param e Email
+ * @param b Part of the email, or the email's content
+ * @retval true The content of the part, or of one of its parts, is missing
+ *
+ * See $imap_partial_fetch.
+ */
+bool imap_part_missing(struct Mailbox *m, struct Email *e, struct Body *b)
+{
+  if (!m || (m->magic != MUTT_IMAP) || !e || !b || !imap_edata_get(e)->partial)
+    return false;
+
+  if (b->type != TYPE_MULTIPART)
+    return (b->length == 0);
+
+  for (struct Body *part = b->parts; part; part = part->next)
+    if (imap_part_missing(m, e, part))
+      return true;
+
+  return false;
+}
+
+/**
+ * part_section - Work out the IMAP section of a part
+ * @param[in]  parent Multipart to search
+ * @param[in]  b      Part to find
+ * @param[in]  prefix Section of the parent, "" for the message
+ * @param[out] buf    Buffer for the section
+ * @param[in]  buflen Length of the buffer
+ * @retval true The part was found
+ */
+static bool part_section(struct Body *parent, struct Body *b, const char *prefix,
+                         char *buf, size_t buflen)
+{
+  int num = 1;
+  for (struct Body *part = parent->parts; part; part = part->next, num++)
+  {
+    snprintf(buf, buflen, "%s%s%d", prefix, *prefix ? "." : "", num);
+    if (part == b)
+      return true;
+    if (part->type == TYPE_MULTIPART)
+    {
+      char sub[SHORT_STRING];
+      mutt_str_strfcpy(sub, buf, sizeof(sub));
+      if (part_section(part, b, sub, buf, buflen))
+        return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * imap_fetch_missing_part - Fetch a part that was left out of a message
+ * @param[in]  m      Selected Imap Mailbox
+ * @param[in]  e      Email
+ * @param[in]  b      Part of the email
+ * @param[in]  fp_msg Message file the part was parsed from
+ * @param[out] fp     Temporary file holding the part, if it was fetched
+ * @param[out] part   New part describing the temporary file
+ * @retval  0 Success, or the part wasn't missing (fp is NULL)
+ * @retval  1 The part can't be fetched on its own, the whole message is needed
+ * @retval -1 Error
+ *
+ * The temporary file holds the MIME header of the part, followed by its
+ * content, which is already decoded if the server supports BINARY.  The
+ * email's own parts are left untouched.
+ */
+int imap_fetch_missing_part(struct Mailbox *m, struct Email *e, struct Body *b,
+                            FILE *fp_msg, FILE **fp, struct Body **part)
+{
+  char section[SHORT_STRING];
+  bool decoded = false;
+
+  if (!fp || !part)
+    return -1;
+  *fp = NULL;
+  *part = NULL;
+
+  if (!imap_part_missing(m, e, b))
+    return 0;
+  if ((b->type == TYPE_MULTIPART) || (b->type == TYPE_MESSAGE) ||
+      !part_section(e->content, b, "", section, sizeof(section)))
+  {
+    return 1;
+  }
+
+  FILE *fp_part = mutt_file_mkstemp();
+  if (!fp_part)
+    return -1;
+
+  if ((partial_copy(fp_msg, b->hdr_offset, b->offset - b->hdr_offset, fp_part) < 0) ||
+      (imap_fetch_part(m, e, section, (b->type == TYPE_TEXT), fp_part, &decoded) < 0))
+  {
+    mutt_file_fclose(&fp_part);
+    return -1;
+  }
+  mutt_clear_error();
+
+  const LOFF_T size = ftello(fp_part);
+  rewind(fp_part);
+  struct Body *b_new = mutt_read_mime_header(fp_part, false);
+  b_new->length = size - b_new->offset;
+  if (decoded)
+    b_new->encoding = (b_new->type == TYPE_TEXT) ? ENC_8BIT : ENC_BINARY;
+  rewind(fp_part);
+
+  *fp = fp_part;
+  *part = b_new;
+  return 0;
+}
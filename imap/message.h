@@ -41,6 +41,8 @@ struct ImapEmailData
   bool replied : 1;
 
   bool parsed : 1;
+  bool partial : 1;    /**< Parts were parsed from a message fetched without its attachments */
+  bool partial_ok : 1; /**< The caller can use a message with some parts left out */
 
   unsigned int uid; /**< 32-bit Message UID */
   unsigned int msn; /**< Message Sequence Number */
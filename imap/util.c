@@ -82,6 +82,10 @@ void imap_adata_free(void **ptr)
   FREE(&adata->buf);
   FREE(&adata->cmds);
 
+  for (int i = 0; i < adata->poolsize; i++)
+    imap_adata_free((void **) &adata->pool[i]);
+  FREE(&adata->pool);
+
   if (adata->conn)
   {
     if (adata->conn->conn_close)
@@ -233,6 +237,7 @@ void imap_mdata_free(void **ptr)
   struct ImapMboxData *mdata = *ptr;
 
   imap_mdata_cache_reset(mdata);
+  imap_append_free(mdata);
   mutt_list_free(&mdata->flags);
   FREE(&mdata->name);
   FREE(&mdata->real_name);
@@ -453,6 +458,20 @@ void imap_hcache_close(struct ImapMboxData *mdata)
   mdata->hcache = NULL;
 }
 
+/**
+ * imap_hcache_valid - Check the UIDVALIDITY of a header cache entry - Implements ::hcache_valid_t
+ */
+static bool imap_hcache_valid(const union Validate *valid, void *data)
+{
+  const unsigned int uid_validity = *(unsigned int *) data;
+
+  if (valid->uidvalidity == uid_validity)
+    return true;
+
+  mutt_debug(LL_DEBUG3, "hcache uidvalidity mismatch: %u\n", valid->uidvalidity);
+  return false;
+}
+
 /**
  * imap_hcache_get - Get a header cache entry by its UID
  * @param mdata Imap Mailbox data
@@ -470,13 +489,11 @@ struct Email *imap_hcache_get(struct ImapMboxData *mdata, unsigned int uid)
     return NULL;
 
   sprintf(key, "/%u", uid);
-  uv = mutt_hcache_fetch(mdata->hcache, key, imap_hcache_keylen(key));
+  uv = mutt_hcache_fetch_valid(mdata->hcache, key, imap_hcache_keylen(key),
+                               imap_hcache_valid, &mdata->uid_validity);
   if (uv)
   {
-    if (*(unsigned int *) uv == mdata->uid_validity)
-      e = mutt_hcache_restore(uv);
-    else
-      mutt_debug(LL_DEBUG3, "hcache uidvalidity mismatch: %u\n", *(unsigned int *) uv);
+    e = mutt_hcache_restore(mdata->hcache, uv);
     mutt_hcache_free(mdata->hcache, &uv);
   }
 
@@ -2949,6 +2949,9 @@ void mutt_free_opts(void)
   mutt_regexlist_free(&UnAlternates);
   mutt_regexlist_free(&UnMailLists);
   mutt_regexlist_free(&UnSubscribedLists);
+#ifdef USE_HCACHE
+  mutt_hcache_cleanup();
+#endif
 
   mutt_grouplist_free();
   mutt_hash_free(&ReverseAliases);
@@ -3912,6 +3915,26 @@ int hcache_validator(const struct ConfigSet *cs, const struct ConfigDef *cdef,
   mutt_buffer_printf(err, _("Invalid value for option %s: %s"), cdef->name, str);
   return CSR_ERR_INVALID;
 }
+
+#ifdef USE_HCACHE_COMPRESSION
+/**
+ * hcache_compress_validator - Validate the "header_cache_compress_method" config variable - Implements ::cs_validator()
+ */
+int hcache_compress_validator(const struct ConfigSet *cs, const struct ConfigDef *cdef,
+                              intptr_t value, struct Buffer *err)
+{
+  if (value == 0)
+    return CSR_SUCCESS;
+
+  const char *str = (const char *) value;
+
+  if (mutt_hcache_is_valid_compression(str))
+    return CSR_SUCCESS;
+
+  mutt_buffer_printf(err, _("Invalid value for option %s: %s"), cdef->name, str);
+  return CSR_ERR_INVALID;
+}
+#endif
 #endif
 
 /**
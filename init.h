@@ -119,6 +119,7 @@ bool IgnoreLinearWhiteSpace = false;
 
 int charset_validator  (const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
 int hcache_validator   (const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
+int hcache_compress_validator(const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
 int multipart_validator(const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
 int pager_validator    (const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
 int reply_validator    (const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
@@ -1340,8 +1341,8 @@ struct ConfigDef MuttVars[] = {
   ** be a single global header cache. By default it is \fIunset\fP so no header
   ** caching will be used.
   ** .pp
-  ** Header caching can greatly improve speed when opening POP, IMAP
-  ** MH or Maildir folders, see "$caching" for details.
+  ** Header caching can greatly improve speed when opening POP, IMAP,
+  ** MH, Maildir, mbox or MMDF folders, see "$caching" for details.
   */
   { "header_cache_backend", DT_STRING, R_NONE, &HeaderCacheBackend, 0, hcache_validator },
   /*
@@ -1361,6 +1362,30 @@ struct ConfigDef MuttVars[] = {
   ** cached folders.
   */
 #endif /* HAVE_QDBM */
+#ifdef USE_HCACHE_COMPRESSION
+  { "header_cache_compress_level", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &HeaderCacheCompressLevel, 1 },
+  /*
+  ** .pp
+  ** When NeoMutt is compiled with header cache compression, this option
+  ** sets the compression level used by $$header_cache_compress_method.
+  ** The value is clamped to the range supported by the method: 1-9 for
+  ** zlib and 1-22 for zstd, where higher levels compress better.  For lz4
+  ** it is the acceleration factor, 1-12, where higher levels are faster.
+  */
+  { "header_cache_compress_method", DT_STRING, R_NONE, &HeaderCacheCompressMethod, 0, hcache_compress_validator },
+  /*
+  ** .pp
+  ** When NeoMutt is compiled with header cache compression, this option
+  ** selects the method used to compress the records of the header cache,
+  ** independently of $$header_cache_backend.  By default it is \fIunset\fP
+  ** so the records aren't compressed.
+  ** .pp
+  ** The first records of each header cache are used to train a dictionary,
+  ** which makes the compression of small records much more effective.
+  ** .pp
+  ** Changing the method invalidates the existing records.
+  */
+#endif /* USE_HCACHE_COMPRESSION */
 #if defined(HAVE_GDBM) || defined(HAVE_BDB)
   { "header_cache_pagesize", DT_STRING, R_NONE, &HeaderCachePagesize, IP "16384" },
   /*
@@ -1371,6 +1396,21 @@ struct ConfigDef MuttVars[] = {
   ** or less optimal for most use cases.
   */
 #endif /* HAVE_GDBM || HAVE_BDB */
+  { "header_cache_shared", DT_BOOL, R_NONE, &HeaderCacheShared, false },
+  /*
+  ** .pp
+  ** When $$header_cache points to a directory, NeoMutt normally creates one
+  ** database file per folder.  If this option is set, all the folders of an
+  ** account share one database file instead, and all the local folders
+  ** share another.  This saves disk space and the cost of opening a
+  ** database for every folder, e.g. when checking many folders for new mail.
+  ** .pp
+  ** With the lmdb backend, the shared database stays open until NeoMutt
+  ** exits.  The other backends lock the database file, so it's closed when
+  ** no folder of the account uses it.
+  ** .pp
+  ** Changing this option doesn't move the existing caches.
+  */
 #endif /* USE_HCACHE */
   { "header_color_partial", DT_BOOL, R_PAGER_FLOW, &HeaderColorPartial, false },
   /*
@@ -1564,6 +1604,15 @@ struct ConfigDef MuttVars[] = {
   ** those, and displays worse performance when enabled.  Your
   ** mileage may vary.
   */
+#ifdef USE_ZLIB
+  { "imap_deflate",             DT_BOOL, R_NONE, &ImapDeflate, true },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt will use the COMPRESS=DEFLATE extension (RFC 4978)
+  ** if advertised by the server.  All the traffic of the connection is then
+  ** compressed, which makes downloading headers much faster on slow links.
+  */
+#endif
   { "imap_delim_chars",         DT_STRING, R_NONE, &ImapDelimChars, IP "/." },
   /*
   ** .pp
@@ -1619,6 +1668,15 @@ struct ConfigDef MuttVars[] = {
   ** .pp
   ** This variable defaults to the value of $$imap_user.
   */
+  { "imap_notify",              DT_BOOL, R_NONE, &ImapNotify, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, and the server supports the NOTIFY extension (RFC5465),
+  ** NeoMutt asks the server to report changes to the account's mailboxes
+  ** as they happen, rather than checking each of them with \fCSTATUS\fP
+  ** every $$mail_check seconds.  All the mailboxes are then watched over
+  ** the one connection and only those that change cost a round trip.
+  */
   { "imap_oauth_refresh_command", DT_STRING, R_NONE, &ImapOauthRefreshCmd, 0 },
   /*
   ** .pp
@@ -1627,6 +1685,19 @@ struct ConfigDef MuttVars[] = {
   ** run on every connection attempt that uses the OAUTHBEARER authentication
   ** mechanism.  See "$oauth" for details.
   */
+  { "imap_partial_fetch", DT_LONG|DT_NOT_NEGATIVE, R_NONE, &ImapPartialFetch, 0 },
+  /*
+  ** .pp
+  ** When set to a non-zero value, messages larger than this many bytes are
+  ** displayed without first downloading their attachments.  NeoMutt fetches
+  ** the structure of the message, then only the text parts that are no larger
+  ** than this.  Any other part is downloaded when it's needed, e.g. when it's
+  ** viewed or saved from the attachment menu.  Functions that need the whole
+  ** message, such as replying or forwarding, download it all.
+  ** .pp
+  ** Signed and encrypted messages are always downloaded in full.
+  ** This option needs $$message_cachedir to be set.
+  */
   { "imap_pass",        DT_STRING,  R_NONE|F_SENSITIVE, &ImapPass, 0 },
   /*
   ** .pp
@@ -1694,6 +1765,19 @@ struct ConfigDef MuttVars[] = {
   ** server which are out of the users' hands, you may wish to suppress
   ** them at some point.
   */
+  { "imap_status_connections", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &ImapStatusConnections, 0 },
+  /*
+  ** .pp
+  ** The number of extra connections NeoMutt may open to each IMAP account
+  ** to check the other mailboxes for new mail.  The \fCSTATUS\fP commands
+  ** are spread over these connections and their replies are picked up as
+  ** they arrive, so a large number of mailboxes can be checked without
+  ** holding up the connection to the open mailbox.
+  ** .pp
+  ** The connections are opened when first needed.  If the server refuses
+  ** one, NeoMutt makes do with those it already has.  A value of 0 checks
+  ** every mailbox over the main connection.
+  */
   { "imap_user",        DT_STRING,  R_NONE|F_SENSITIVE, &ImapUser, 0 },
   /*
   ** .pp
@@ -1944,6 +2028,19 @@ struct ConfigDef MuttVars[] = {
   ** files when the header cache is in use.  This incurs one \fCstat(2)\fP per
   ** message every time the folder is opened (which can be very slow for NFS
   ** folders).
+  ** .pp
+  ** Messages whose file has kept its name and inode since the directory was
+  ** last listed aren't checked again.
+  */
+#endif
+#ifdef USE_PTHREADS
+  { "maildir_read_threads", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &MaildirReadThreads, 4 },
+  /*
+  ** .pp
+  ** When opening a Maildir or MH mailbox, the messages that aren't in the
+  ** header cache are read from disk.  This is the number of threads that open
+  ** their files ahead of NeoMutt, which can speed up reading large mailboxes
+  ** on network filesystems.  Set to 0 to open the files one at a time.
   */
 #endif
   { "maildir_trash", DT_BOOL, R_NONE, &MaildirTrash, false },
@@ -1993,6 +2090,20 @@ struct ConfigDef MuttVars[] = {
   ** .pp
   ** Also see the $$move variable.
   */
+  { "mbox_pad_status",  DT_BOOL, R_NONE, &MboxPadStatus, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt always writes the \fCStatus:\fP and
+  ** \fCX-Status:\fP header fields of the messages it writes to mbox and MMDF
+  ** folders, padded with spaces.  When only the flags of such a message
+  ** change, they can be updated in place, instead of rewriting the rest of
+  ** the folder.
+  ** .pp
+  ** Setting this changes what is written to disk: every message that NeoMutt
+  ** writes gets these header fields, even if it has no flags set.  Other
+  ** programs reading the folder will see the padding.  It is \fIunset\fP by
+  ** default, which leaves the folder format unchanged.
+  */
   { "mbox_type",        DT_MAGIC,R_NONE, &MboxType, MUTT_MBOX },
   /*
   ** .pp
@@ -385,6 +385,10 @@ int mutt_mailbox_check(struct Mailbox *m_cur, int force)
     np->mailbox->first_check_stats_done = true;
   }
 
+#ifdef USE_IMAP
+  imap_pool_wait_all();
+#endif
+
   return MailboxCount;
 }
 
@@ -25,11 +25,12 @@
  *
  * Maildir local mailbox type
  *
- * | File              | Description              |
- * | :---------------- | :----------------------- |
- * | maildir/maildir.c | @subpage maildir_maildir |
- * | maildir/mh.c      | @subpage maildir_mh      |
- * | maildir/shared.c  | @subpage maildir_shared  |
+ * | File               | Description               |
+ * | :----------------- | :------------------------ |
+ * | maildir/maildir.c  | @subpage maildir_maildir  |
+ * | maildir/mh.c       | @subpage maildir_mh       |
+ * | maildir/prefetch.c | @subpage maildir_prefetch |
+ * | maildir/shared.c   | @subpage maildir_shared   |
  */
 
 #ifndef MUTT_MAILDIR_LIB_H
@@ -49,6 +50,7 @@ struct Email;
 /* These Config Variables are only used in maildir/mh.c */
 extern bool  CheckNew;
 extern bool  MaildirHeaderCacheVerify;
+extern short MaildirReadThreads;
 extern bool  MhPurge;
 extern char *MhSeqFlagged;
 extern char *MhSeqReplied;
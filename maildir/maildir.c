@@ -354,6 +354,93 @@ static int maildir_mbox_open_append(struct Mailbox *m, int flags)
   return 0;
 }
 
+#ifdef USE_INOTIFY
+/**
+ * struct MaildirDelta - The latest change to a message file
+ */
+struct MaildirDelta
+{
+  char *path; ///< Path of the file, e.g. "cur/1234:2,S"
+  bool added; ///< The file was added, rather than removed
+};
+
+/**
+ * maildir_delta_free - Free a MaildirDelta - Implements ::hashelem_free_t
+ */
+static void maildir_delta_free(int type, void *obj, intptr_t data)
+{
+  struct MaildirDelta *d = obj;
+
+  FREE(&d->path);
+  FREE(&d);
+}
+
+/**
+ * maildir_check_events - Apply the monitor's events to a list of files
+ * @param[in]  m      Mailbox
+ * @param[in]  events Files added to, or removed from, the mailbox
+ * @param[out] last   Last Maildir, see maildir_parse_dir()
+ * @param[out] count  Number of files added to the list
+ * @retval ptr Latest change to each file, keyed by canonical name
+ *
+ * Only the latest change to each message counts, e.g. a message that's been
+ * renamed (for its flags) is simply added under its new name.
+ */
+static struct Hash *maildir_check_events(struct Mailbox *m, struct MonitorEventList *events,
+                                         struct Maildir ***last, int *count)
+{
+  struct Hash *deltas = mutt_hash_new(64, MUTT_HASH_STRDUP_KEYS);
+  mutt_hash_set_destructor(deltas, maildir_delta_free, 0);
+
+  struct Buffer *canon = mutt_buffer_pool_get();
+  struct Buffer *path = mutt_buffer_pool_get();
+  struct MonitorEvent *me = NULL;
+
+  STAILQ_FOREACH(me, events, entries)
+  {
+    if (*me->name == '.')
+      continue;
+
+    maildir_canon_filename(canon, me->name);
+    mutt_buffer_printf(path, "%s/%s", me->dir, me->name);
+
+    struct MaildirDelta *d = mutt_hash_find(deltas, mutt_b2s(canon));
+    if (!d)
+    {
+      d = mutt_mem_calloc(1, sizeof(struct MaildirDelta));
+      mutt_hash_insert(deltas, mutt_b2s(canon), d);
+    }
+    else if (!me->added && (mutt_str_strcmp(d->path, mutt_b2s(path)) != 0))
+    {
+      /* An older name of the message has gone */
+      continue;
+    }
+
+    mutt_str_replace(&d->path, mutt_b2s(path));
+    d->added = me->added;
+  }
+
+  struct HashWalkState state = { 0 };
+  struct HashElem *he = NULL;
+  while ((he = mutt_hash_walk(deltas, &state)))
+  {
+    struct MaildirDelta *d = he->data;
+    if (!d->added)
+      continue;
+
+    char *name = strchr(d->path, '/');
+    *name = '\0';
+    maildir_parse_file(m, last, d->path, name + 1);
+    *name = '/';
+    (*count)++;
+  }
+
+  mutt_buffer_pool_release(&path);
+  mutt_buffer_pool_release(&canon);
+  return deltas;
+}
+#endif
+
 /**
  * maildir_mbox_check - Implements MxOps::mbox_check()
  *
@@ -363,6 +450,9 @@ static int maildir_mbox_open_append(struct Mailbox *m, int flags)
  * We check for newly added messages, and then merge the flags messages we
  * already knew about.  We don't treat either subdirectory differently, as mail
  * could be copied directly into the cur directory from another agent.
+ *
+ * If the mailbox is being monitored, only the files that the monitor has seen
+ * added or removed are looked at, see mutt_monitor_events().
  */
 int maildir_mbox_check(struct Mailbox *m, int *index_hint)
 {
@@ -381,6 +471,7 @@ int maildir_mbox_check(struct Mailbox *m, int *index_hint)
   int count = 0;
   struct Hash *fnames = NULL; /* hash table for quickly looking up the base filename
                                  for a maildir message */
+  struct Hash *deltas = NULL; /* changes seen by the monitor, if complete */
   struct MaildirMboxData *mdata = maildir_mdata_get(m);
 
   /* XXX seems like this check belongs in mx_mbox_check() rather than here.  */
@@ -435,10 +526,21 @@ int maildir_mbox_check(struct Mailbox *m, int *index_hint)
    */
   md = NULL;
   last = &md;
-  if (changed & 1)
-    maildir_parse_dir(m, &last, "new", &count, NULL);
-  if (changed & 2)
-    maildir_parse_dir(m, &last, "cur", &count, NULL);
+#ifdef USE_INOTIFY
+  struct MonitorEventList events = STAILQ_HEAD_INITIALIZER(events);
+  if (mutt_monitor_events(m, &events))
+  {
+    deltas = maildir_check_events(m, &events, &last, &count);
+    mutt_monitor_events_free(&events);
+  }
+  else
+#endif
+  {
+    if (changed & 1)
+      maildir_parse_dir(m, &last, "new", &count, NULL);
+    if (changed & 2)
+      maildir_parse_dir(m, &last, "cur", &count, NULL);
+  }
 
   /* we create a hash table keyed off the canonical (sans flags) filename
    * of each message we scanned.  This is used in the loop over the
@@ -490,6 +592,17 @@ int maildir_mbox_check(struct Mailbox *m, int *index_hint)
       /* this is a duplicate of an existing header, so remove it */
       mutt_email_free(&p->email);
     }
+#ifdef USE_INOTIFY
+    /* The monitor has seen exactly which files went */
+    else if (deltas)
+    {
+      struct MaildirDelta *d = mutt_hash_find(deltas, mutt_b2s(buf));
+      if (d && !d->added && (mutt_str_strcmp(d->path, m->emails[i]->path) == 0))
+        occult = true;
+      else
+        m->emails[i]->active = true;
+    }
+#endif
     /* This message was not in the list of messages we just scanned.
      * Check to see if we have enough information to know if the
      * message has disappeared out from underneath us.
@@ -515,6 +628,7 @@ int maildir_mbox_check(struct Mailbox *m, int *index_hint)
 
   /* destroy the file name hash */
   mutt_hash_free(&fnames);
+  mutt_hash_free(&deltas);
 
   /* If we didn't just get new mail, update the tables. */
   if (occult)
@@ -34,6 +34,7 @@ struct Buffer;
 struct Context;
 struct Email;
 struct Mailbox;
+struct MaildirPrefetch;
 struct Message;
 struct Progress;
 
@@ -54,23 +55,47 @@ struct Maildir
   struct Email *email;
   char *canon_fname;
   bool header_parsed : 1;
+  bool listed : 1;      ///< Unchanged since the directory manifest was saved
+  bool arena : 1;       ///< Allocated by maildir_parse_dir() in a block
+  bool arena_block : 1; ///< First entry of its block
   ino_t inode;
   struct Maildir *next;
 };
 
+#define MH_SEQ_UNSEEN (1 << 0)
+#define MH_SEQ_REPLIED (1 << 1)
+#define MH_SEQ_FLAGGED (1 << 2)
+#define MH_SEQ_MAX 3 ///< Number of sequences we track
+
+/**
+ * struct MhSeqRange - A range of MH message numbers
+ */
+struct MhSeqRange
+{
+  int first; ///< First message number
+  int last;  ///< Last message number (inclusive)
+};
+
+/**
+ * struct MhSeqSet - Message numbers of one MH sequence
+ *
+ * The ranges are sorted, and neither overlap nor touch each other.
+ */
+struct MhSeqSet
+{
+  struct MhSeqRange *ranges; ///< Ranges of message numbers
+  int num;                   ///< Number of ranges used
+  int size;                  ///< Number of ranges allocated
+};
+
 /**
  * struct MhSequences - Set of MH sequence numbers
  */
 struct MhSequences
 {
-  int max;
-  short *flags;
+  struct MhSeqSet seqs[MH_SEQ_MAX]; ///< One set per flag, e.g. #MH_SEQ_UNSEEN
 };
 
-#define MH_SEQ_UNSEEN (1 << 0)
-#define MH_SEQ_REPLIED (1 << 1)
-#define MH_SEQ_FLAGGED (1 << 2)
-
 /* MXAPI shared functions */
 int             maildir_ac_add     (struct Account *a, struct Mailbox *m);
 struct Account *maildir_ac_find    (struct Account *a, const char *path);
@@ -92,6 +117,7 @@ struct MaildirMboxData *maildir_mdata_get      (struct Mailbox *m);
 int                     maildir_mh_open_message(struct Mailbox *m, struct Message *msg, int msgno, bool is_maildir);
 int                     maildir_move_to_context(struct Mailbox *m, struct Maildir **md);
 int                     maildir_parse_dir      (struct Mailbox *m, struct Maildir ***last, const char *subdir, int *count, struct Progress *progress);
+void                    maildir_parse_file     (struct Mailbox *m, struct Maildir ***last, const char *subdir, const char *name);
 void                    maildir_parse_flags    (struct Email *e, const char *path);
 struct Email *          maildir_parse_message  (enum MailboxType magic, const char *fname, bool is_old, struct Email *e);
 bool                    maildir_update_flags   (struct Mailbox *m, struct Email *o, struct Email *n);
@@ -101,6 +127,7 @@ int                     mh_commit_msg          (struct Mailbox *m, struct Messag
 int                     mh_mkstemp             (struct Mailbox *m, FILE **fp, char **tgt);
 int                     mh_read_dir            (struct Mailbox *m, const char *subdir);
 int                     mh_read_sequences      (struct MhSequences *mhs, const char *path);
+void                    mh_sequences_add_one   (struct Mailbox *m, int n, bool unseen, bool flagged, bool replied);
 short                   mhs_check              (struct MhSequences *mhs, int i);
 void                    mhs_free_sequences     (struct MhSequences *mhs);
 short                   mhs_set                (struct MhSequences *mhs, int i, short f);
@@ -109,6 +136,13 @@ void                    mh_update_maildir      (struct Maildir *md, struct MhSeq
 void                    mh_update_sequences    (struct Mailbox *m);
 bool                    mh_valid_message       (const char *s);
 
+/* Prefetch functions */
+size_t                  maildir_prefetch_add   (struct MaildirPrefetch *pf, const char *path);
+void                    maildir_prefetch_free  (struct MaildirPrefetch **ptr);
+FILE *                  maildir_prefetch_get   (struct MaildirPrefetch *pf, size_t index);
+struct MaildirPrefetch *maildir_prefetch_new   (size_t num_files);
+void                    maildir_prefetch_start (struct MaildirPrefetch *pf);
+
 int mh_sync_message(struct Mailbox *m, int msgno);
 int maildir_sync_message(struct Mailbox *m, int msgno);
 int mh_rewrite_message(struct Mailbox *m, int msgno);
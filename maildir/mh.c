@@ -53,26 +53,125 @@
 #include "monitor.h"
 #include "muttlib.h"
 #include "mx.h"
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
+
+/* Index of a flag's set in MhSequences::seqs, e.g. #MH_SEQ_UNSEEN */
+#define MHS_INDEX(f) (((f) == MH_SEQ_UNSEEN) ? 0 : ((f) == MH_SEQ_REPLIED) ? 1 : 2)
+
+/**
+ * mhs_find - Find the range that could hold a message number
+ * @param set Sequence
+ * @param i   Message number
+ * @retval num Index of the first range that ends at, or after, @a i
+ */
+static int mhs_find(const struct MhSeqSet *set, int i)
+{
+  int lo = 0;
+  int hi = set->num;
+
+  while (lo < hi)
+  {
+    const int mid = lo + (hi - lo) / 2;
+    if (set->ranges[mid].last < i)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
 
 /**
- * mhs_alloc - Allocate more memory for sequences
- * @param mhs Existing sequences
- * @param i   Number required
+ * mhs_add_range - Add a range of message numbers to a sequence
+ * @param set   Sequence
+ * @param first First message number
+ * @param last  Last message number
  *
- * @note Memory is allocated in blocks of 128.
+ * Any ranges that overlap, or touch, the new one are merged with it.
  */
-static void mhs_alloc(struct MhSequences *mhs, int i)
+static void mhs_add_range(struct MhSeqSet *set, int first, int last)
 {
-  if ((i <= mhs->max) && mhs->flags)
+  /* The first range that overlaps, touches, or follows the new one */
+  const int pos = mhs_find(set, first - 1);
+
+  int end = pos;
+  while ((end < set->num) && (set->ranges[end].first - 1 <= last))
+    end++;
+
+  if (end == pos)
+  {
+    if (set->num == set->size)
+    {
+      set->size += 32;
+      mutt_mem_realloc(&set->ranges, set->size * sizeof(struct MhSeqRange));
+    }
+    memmove(&set->ranges[pos + 1], &set->ranges[pos],
+            (set->num - pos) * sizeof(struct MhSeqRange));
+    set->ranges[pos].first = first;
+    set->ranges[pos].last = last;
+    set->num++;
     return;
+  }
 
-  const int newmax = i + 128;
-  int j = mhs->flags ? mhs->max + 1 : 0;
-  mutt_mem_realloc(&mhs->flags, sizeof(mhs->flags[0]) * (newmax + 1));
-  while (j <= newmax)
-    mhs->flags[j++] = 0;
+  struct MhSeqRange *r = &set->ranges[pos];
+  r->first = MIN(r->first, first);
+  r->last = MAX(set->ranges[end - 1].last, last);
+  memmove(r + 1, &set->ranges[end], (set->num - end) * sizeof(struct MhSeqRange));
+  set->num -= end - pos - 1;
+}
 
-  mhs->max = newmax;
+/**
+ * mhs_set_range - Set a flag for a range of message numbers
+ * @param mhs   Sequences
+ * @param first First message number
+ * @param last  Last message number
+ * @param f     Flags, e.g. #MH_SEQ_UNSEEN
+ */
+static void mhs_set_range(struct MhSequences *mhs, int first, int last, short f)
+{
+  if ((first < 0) || (first > last))
+    return;
+
+  for (int i = 0; i < MH_SEQ_MAX; i++)
+    if (f & (1 << i))
+      mhs_add_range(&mhs->seqs[i], first, last);
+}
+
+/**
+ * mhs_count - Count the message numbers in a sequence
+ * @param set Sequence
+ * @retval num Number of messages
+ */
+static int mhs_count(const struct MhSeqSet *set)
+{
+  int count = 0;
+  for (int i = 0; i < set->num; i++)
+    count += set->ranges[i].last - set->ranges[i].first + 1;
+  return count;
+}
+
+/**
+ * mhs_equal - Are two sets of sequences the same?
+ * @param a First set
+ * @param b Second set
+ * @retval true They hold the same message numbers
+ */
+static bool mhs_equal(const struct MhSequences *a, const struct MhSequences *b)
+{
+  for (int i = 0; i < MH_SEQ_MAX; i++)
+  {
+    if (a->seqs[i].num != b->seqs[i].num)
+      return false;
+    if ((a->seqs[i].num != 0) &&
+        (memcmp(a->seqs[i].ranges, b->seqs[i].ranges,
+                a->seqs[i].num * sizeof(struct MhSeqRange)) != 0))
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
 /**
@@ -81,7 +180,12 @@ static void mhs_alloc(struct MhSequences *mhs, int i)
  */
 void mhs_free_sequences(struct MhSequences *mhs)
 {
-  FREE(&mhs->flags);
+  for (int i = 0; i < MH_SEQ_MAX; i++)
+  {
+    FREE(&mhs->seqs[i].ranges);
+    mhs->seqs[i].num = 0;
+    mhs->seqs[i].size = 0;
+  }
 }
 
 /**
@@ -92,10 +196,17 @@ void mhs_free_sequences(struct MhSequences *mhs)
  */
 short mhs_check(struct MhSequences *mhs, int i)
 {
-  if (!mhs->flags || (i > mhs->max))
-    return 0;
-  else
-    return mhs->flags[i];
+  short f = 0;
+
+  for (int j = 0; j < MH_SEQ_MAX; j++)
+  {
+    const struct MhSeqSet *set = &mhs->seqs[j];
+    const int pos = mhs_find(set, i);
+    if ((pos < set->num) && (set->ranges[pos].first <= i))
+      f |= (1 << j);
+  }
+
+  return f;
 }
 
 /**
@@ -107,98 +218,68 @@ short mhs_check(struct MhSequences *mhs, int i)
  */
 short mhs_set(struct MhSequences *mhs, int i, short f)
 {
-  mhs_alloc(mhs, i);
-  mhs->flags[i] |= f;
-  return mhs->flags[i];
+  mhs_set_range(mhs, i, i, f);
+  return mhs_check(mhs, i);
 }
 
 /**
  * mhs_write_one_sequence - Write a flag sequence to a file
  * @param fp  File to write to
- * @param mhs Sequence list
- * @param f   Flag, e.g. MH_SEQ_UNSEEN
+ * @param set Sequence
  * @param tag string tag, e.g. "unseen"
  */
-static void mhs_write_one_sequence(FILE *fp, struct MhSequences *mhs, short f, const char *tag)
+static void mhs_write_one_sequence(FILE *fp, const struct MhSeqSet *set, const char *tag)
 {
   fprintf(fp, "%s:", tag);
 
-  int first = -1;
-  int last = -1;
-
-  for (int i = 0; i <= mhs->max; i++)
+  for (int i = 0; i < set->num; i++)
   {
-    if ((mhs_check(mhs, i) & f))
-    {
-      if (first < 0)
-        first = i;
-      else
-        last = i;
-    }
-    else if (first >= 0)
-    {
-      if (last < 0)
-        fprintf(fp, " %d", first);
-      else
-        fprintf(fp, " %d-%d", first, last);
-
-      first = -1;
-      last = -1;
-    }
-  }
-
-  if (first >= 0)
-  {
-    if (last < 0)
-      fprintf(fp, " %d", first);
+    const struct MhSeqRange *r = &set->ranges[i];
+    if (r->first == r->last)
+      fprintf(fp, " %d", r->first);
     else
-      fprintf(fp, " %d-%d", first, last);
+      fprintf(fp, " %d-%d", r->first, r->last);
   }
 
   fputc('\n', fp);
 }
 
 /**
- * mh_update_sequences - Update sequence numbers
- * @param m Mailbox
+ * mh_write_sequences - Replace our sequences in the .mh_sequences file
+ * @param m   Mailbox
+ * @param mhs Sequences to write
  *
- * XXX we don't currently remove deleted messages from sequences we don't know.
- * Should we?
+ * Sequences we don't know about are copied unchanged.  The new file is
+ * written next to the old one, synced, and renamed over it, so that
+ * .mh_sequences always exists, in its old or new version.
  */
-void mh_update_sequences(struct Mailbox *m)
+static void mh_write_sequences(struct Mailbox *m, struct MhSequences *mhs)
 {
   FILE *ofp = NULL, *nfp = NULL;
 
   char sequences[PATH_MAX];
   char *tmpfname = NULL;
   char *buf = NULL;
-  char *p = NULL;
   size_t s;
   int l = 0;
-  int i;
-
-  int unseen = 0;
-  int flagged = 0;
-  int replied = 0;
 
   char seq_unseen[STRING];
   char seq_replied[STRING];
   char seq_flagged[STRING];
 
-  struct MhSequences mhs = { 0 };
-
   snprintf(seq_unseen, sizeof(seq_unseen), "%s:", NONULL(MhSeqUnseen));
   snprintf(seq_replied, sizeof(seq_replied), "%s:", NONULL(MhSeqReplied));
   snprintf(seq_flagged, sizeof(seq_flagged), "%s:", NONULL(MhSeqFlagged));
 
+  if (snprintf(sequences, sizeof(sequences), "%s/.mh_sequences", m->path) >= sizeof(sequences))
+    return;
+
   if (mh_mkstemp(m, &nfp, &tmpfname) != 0)
   {
     /* error message? */
     return;
   }
 
-  snprintf(sequences, sizeof(sequences), "%s/.mh_sequences", m->path);
-
   /* first, copy unknown sequences */
   ofp = fopen(sequences, "r");
   if (ofp)
@@ -214,60 +295,130 @@ void mh_update_sequences(struct Mailbox *m)
     }
   }
   mutt_file_fclose(&ofp);
+  FREE(&buf);
 
-  /* now, update our unseen, flagged, and replied sequences */
-  for (l = 0; l < m->msg_count; l++)
+  /* write out the new sequences */
+  const struct MhSeqSet *unseen = &mhs->seqs[MHS_INDEX(MH_SEQ_UNSEEN)];
+  const struct MhSeqSet *flagged = &mhs->seqs[MHS_INDEX(MH_SEQ_FLAGGED)];
+  const struct MhSeqSet *replied = &mhs->seqs[MHS_INDEX(MH_SEQ_REPLIED)];
+  if (unseen->num != 0)
+    mhs_write_one_sequence(nfp, unseen, NONULL(MhSeqUnseen));
+  if (flagged->num != 0)
+    mhs_write_one_sequence(nfp, flagged, NONULL(MhSeqFlagged));
+  if (replied->num != 0)
+    mhs_write_one_sequence(nfp, replied, NONULL(MhSeqReplied));
+
+  if ((mutt_file_fsync_close(&nfp) != 0) || (rename(tmpfname, sequences) != 0))
   {
-    if (m->emails[l]->deleted)
+    mutt_perror(sequences);
+    unlink(tmpfname);
+  }
+
+  FREE(&tmpfname);
+}
+
+/**
+ * mh_update_sequences - Update sequence numbers
+ * @param m Mailbox
+ *
+ * The file is only rewritten if one of our sequences has changed.
+ *
+ * XXX we don't currently remove deleted messages from sequences we don't know.
+ * Should we?
+ */
+void mh_update_sequences(struct Mailbox *m)
+{
+  struct MhSequences mhs = { 0 };
+  struct MhSequences old = { 0 };
+  char sequences[PATH_MAX];
+  char *p = NULL;
+  int i;
+
+  for (int l = 0; l < m->msg_count; l++)
+  {
+    struct Email *e = m->emails[l];
+    if (e->deleted)
       continue;
 
-    p = strrchr(m->emails[l]->path, '/');
+    p = strrchr(e->path, '/');
     if (p)
       p++;
     else
-      p = m->emails[l]->path;
+      p = e->path;
 
     if (mutt_str_atoi(p, &i) < 0)
       continue;
 
-    if (!m->emails[l]->read)
-    {
-      mhs_set(&mhs, i, MH_SEQ_UNSEEN);
-      unseen++;
-    }
-    if (m->emails[l]->flagged)
-    {
-      mhs_set(&mhs, i, MH_SEQ_FLAGGED);
-      flagged++;
-    }
-    if (m->emails[l]->replied)
-    {
-      mhs_set(&mhs, i, MH_SEQ_REPLIED);
-      replied++;
-    }
+    short f = 0;
+    if (!e->read)
+      f |= MH_SEQ_UNSEEN;
+    if (e->flagged)
+      f |= MH_SEQ_FLAGGED;
+    if (e->replied)
+      f |= MH_SEQ_REPLIED;
+
+    if (f != 0)
+      mhs_set(&mhs, i, f);
   }
 
-  /* write out the new sequences */
+  /* An unreadable file gets replaced */
+  if (snprintf(sequences, sizeof(sequences), "%s/.mh_sequences", m->path) >= sizeof(sequences))
+  {
+    mhs_free_sequences(&mhs);
+    return;
+  }
+
+  if ((access(sequences, F_OK) == 0) && (mh_read_sequences(&old, m->path) == 0) &&
+      mhs_equal(&mhs, &old))
+  {
+    mutt_debug(LL_DEBUG2, "%s is unchanged\n", sequences);
+  }
+  else
+  {
+    mh_write_sequences(m, &mhs);
+  }
+
+  mhs_free_sequences(&old);
+  mhs_free_sequences(&mhs);
+}
+
+/**
+ * mh_sequences_add_one - Update the flags for one sequence
+ * @param m       Mailbox
+ * @param n       Sequence number to update
+ * @param unseen  Update the unseen sequence
+ * @param flagged Update the flagged sequence
+ * @param replied Update the replied sequence
+ */
+void mh_sequences_add_one(struct Mailbox *m, int n, bool unseen, bool flagged, bool replied)
+{
+  struct MhSequences mhs = { 0 };
+  char sequences[PATH_MAX];
+
+  if (snprintf(sequences, sizeof(sequences), "%s/.mh_sequences", m->path) >= sizeof(sequences))
+    return;
+
+  short f = 0;
   if (unseen)
-    mhs_write_one_sequence(nfp, &mhs, MH_SEQ_UNSEEN, NONULL(MhSeqUnseen));
+    f |= MH_SEQ_UNSEEN;
   if (flagged)
-    mhs_write_one_sequence(nfp, &mhs, MH_SEQ_FLAGGED, NONULL(MhSeqFlagged));
+    f |= MH_SEQ_FLAGGED;
   if (replied)
-    mhs_write_one_sequence(nfp, &mhs, MH_SEQ_REPLIED, NONULL(MhSeqReplied));
+    f |= MH_SEQ_REPLIED;
 
-  mhs_free_sequences(&mhs);
-
-  /* try to commit the changes - no guarantee here */
-  mutt_file_fclose(&nfp);
+  if (mh_read_sequences(&mhs, m->path) < 0)
+  {
+    mutt_debug(LL_DEBUG1, "can't parse the sequences of %s\n", m->path);
+    return;
+  }
 
-  unlink(sequences);
-  if (mutt_file_safe_rename(tmpfname, sequences) != 0)
+  if (((mhs_check(&mhs, n) & f) != f) || (access(sequences, F_OK) != 0))
   {
-    /* report an error? */
-    unlink(tmpfname);
+    mhs_set_range(&mhs, n, n, f);
+    mh_write_sequences(m, &mhs);
   }
 
-  FREE(&tmpfname);
+  mhs_free_sequences(&mhs);
 }
 
 /**
@@ -342,8 +493,7 @@ int mh_read_sequences(struct MhSequences *mhs, const char *path)
         rc = -1;
         goto out;
       }
-      for (; first <= last; first++)
-        mhs_set(mhs, first, f);
+      mhs_set_range(mhs, first, last, f);
     }
   }
 
@@ -442,30 +592,20 @@ static int mh_mbox_check_stats(struct Mailbox *m, int flags)
     return false;
 
   m->msg_count = 0;
-  m->msg_unread = 0;
-  m->msg_flagged = 0;
 
-  for (int i = mhs.max; i > 0; i--)
+  const struct MhSeqSet *unseen = &mhs.seqs[MHS_INDEX(MH_SEQ_UNSEEN)];
+  m->msg_flagged = mhs_count(&mhs.seqs[MHS_INDEX(MH_SEQ_FLAGGED)]);
+  m->msg_unread = mhs_count(unseen);
+
+  if (unseen->num != 0)
   {
-    if ((mhs_check(&mhs, i) & MH_SEQ_FLAGGED))
-      m->msg_flagged++;
-    if (mhs_check(&mhs, i) & MH_SEQ_UNSEEN)
+    /* if the highest unseen message was in the mailbox during the last
+     * visit, don't notify about it */
+    const int i = unseen->ranges[unseen->num - 1].last;
+    if (!MailCheckRecent || (mh_already_notified(m, i) == 0))
     {
-      m->msg_unread++;
-      if (check_new)
-      {
-        /* if the first unseen message we encounter was in the m during the
-           last visit, don't notify about it */
-        if (!MailCheckRecent || mh_already_notified(m, i) == 0)
-        {
-          m->has_new = true;
-          rc = true;
-        }
-        /* Because we are traversing from high to low, we can stop
-         * checking for new mail after the first unseen message.
-         * Whether it resulted in "new mail" or not. */
-        check_new = false;
-      }
+      m->has_new = true;
+      rc = true;
     }
   }
 
@@ -686,6 +826,14 @@ int mh_mbox_check(struct Mailbox *m, int *index_hint)
     m->emails[i]->active = false;
 
     p = mutt_hash_find(fnames, m->emails[i]->path);
+#ifdef USE_HCACHE
+    if (p && p->email)
+    {
+      /* compare like with like */
+      mutt_hcache_restore_deferred(m->emails[i]);
+      mutt_hcache_restore_deferred(p->email);
+    }
+#endif
     if (p && p->email && mutt_email_cmp_strict(m->emails[i], p->email))
     {
       m->emails[i]->active = true;
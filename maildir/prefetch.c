@@ -0,0 +1,279 @@
+/**
+ * @file
+ * Open Maildir/MH message files ahead of the parser
+ *
+ * @authors
+ * Copyright (C) 2019 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page maildir_prefetch Open message files ahead of the parser
+ *
+ * When a mailbox is opened, every message missing from the header cache is
+ * opened and its header parsed.  On slow (e.g. network) filesystems, most of
+ * the time goes in waiting for open(2) and the first read(2).
+ *
+ * A pool of worker threads opens the files, in order, a little ahead of the
+ * parser, and fills the stdio buffer of each one.  The header parser itself
+ * isn't thread-safe, so it stays on the main thread, as do the header cache
+ * and the progress bar.
+ *
+ * Without thread support, the files are simply opened on demand.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdio.h>
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+#include "maildir_private.h"
+#include "mutt/mutt.h"
+#include "lib.h"
+
+/* The number of files each thread may open ahead of the parser */
+#define PREFETCH_WINDOW 16
+
+/**
+ * struct PrefetchFile - A message file to open
+ */
+struct PrefetchFile
+{
+  char *path; ///< Path of the file
+  FILE *fp;   ///< Open file, or NULL on error
+  bool done;  ///< The file has been opened (or failed)
+};
+
+/**
+ * struct MaildirPrefetch - Open message files ahead of the parser
+ */
+struct MaildirPrefetch
+{
+  struct PrefetchFile *files; ///< Files to open, in order
+  size_t num_files;           ///< Number of files
+  size_t next;                ///< Next file to open
+  size_t wanted;              ///< File the parser is waiting for
+#ifdef USE_PTHREADS
+  pthread_mutex_t lock;       ///< Protects everything above
+  pthread_cond_t work;        ///< Signalled when the parser moves on
+  pthread_cond_t opened;      ///< Signalled when a file has been opened
+  pthread_t *threads;         ///< Worker threads
+  int num_threads;            ///< Number of worker threads
+  size_t window;              ///< How far ahead of the parser to open files
+  bool stop;                  ///< Ask the workers to quit
+#endif
+};
+
+/**
+ * prefetch_open - Open a message file and fill its buffer
+ * @param path Path of the file
+ * @retval ptr  Open file
+ * @retval NULL Error
+ */
+static FILE *prefetch_open(const char *path)
+{
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+    return NULL;
+
+  /* Reading a character fills the stdio buffer, usually with the whole header */
+  int c = fgetc(fp);
+  if (c != EOF)
+    ungetc(c, fp);
+  return fp;
+}
+
+#ifdef USE_PTHREADS
+/**
+ * prefetch_worker - Open files until there are none left
+ * @param arg Prefetch state
+ * @retval NULL Always
+ */
+static void *prefetch_worker(void *arg)
+{
+  struct MaildirPrefetch *pf = arg;
+
+  pthread_mutex_lock(&pf->lock);
+  while (true)
+  {
+    while (!pf->stop && (pf->next < pf->num_files) && (pf->next >= pf->wanted + pf->window))
+      pthread_cond_wait(&pf->work, &pf->lock);
+
+    if (pf->stop || (pf->next >= pf->num_files))
+      break;
+
+    struct PrefetchFile *pff = &pf->files[pf->next++];
+    pthread_mutex_unlock(&pf->lock);
+
+    FILE *fp = prefetch_open(pff->path);
+
+    pthread_mutex_lock(&pf->lock);
+    pff->fp = fp;
+    pff->done = true;
+    pthread_cond_broadcast(&pf->opened);
+  }
+  pthread_mutex_unlock(&pf->lock);
+
+  return NULL;
+}
+#endif
+
+/**
+ * maildir_prefetch_new - Start opening message files
+ * @param num_files Number of files
+ * @retval ptr New prefetch state
+ *
+ * Add the files with maildir_prefetch_add(), then call
+ * maildir_prefetch_start().
+ */
+struct MaildirPrefetch *maildir_prefetch_new(size_t num_files)
+{
+  struct MaildirPrefetch *pf = mutt_mem_calloc(1, sizeof(struct MaildirPrefetch));
+  pf->files = mutt_mem_calloc(num_files, sizeof(struct PrefetchFile));
+  return pf;
+}
+
+/**
+ * maildir_prefetch_add - Add a file to open
+ * @param pf   Prefetch state
+ * @param path Path of the file
+ * @retval num Index of the file
+ */
+size_t maildir_prefetch_add(struct MaildirPrefetch *pf, const char *path)
+{
+  pf->files[pf->num_files].path = mutt_str_strdup(path);
+  return pf->num_files++;
+}
+
+/**
+ * maildir_prefetch_start - Start the worker threads
+ * @param pf Prefetch state
+ *
+ * Up to $maildir_read_threads threads are started, fewer if there are only
+ * a few files.
+ */
+void maildir_prefetch_start(struct MaildirPrefetch *pf)
+{
+#ifdef USE_PTHREADS
+  int num = MIN((size_t) MaildirReadThreads, pf->num_files / 2);
+  if (num < 1)
+    return;
+
+  if (pthread_mutex_init(&pf->lock, NULL) != 0)
+    return;
+  if (pthread_cond_init(&pf->work, NULL) != 0)
+    goto fail_work;
+  if (pthread_cond_init(&pf->opened, NULL) != 0)
+    goto fail_opened;
+
+  pf->window = num * PREFETCH_WINDOW;
+  pf->threads = mutt_mem_calloc(num, sizeof(pthread_t));
+
+  for (; pf->num_threads < num; pf->num_threads++)
+  {
+    if (pthread_create(&pf->threads[pf->num_threads], NULL, prefetch_worker, pf) != 0)
+    {
+      mutt_debug(LL_DEBUG1, "can't create thread %d\n", pf->num_threads);
+      break;
+    }
+  }
+  mutt_debug(LL_DEBUG2, "opening %zu files with %d threads\n", pf->num_files,
+             pf->num_threads);
+  if (pf->num_threads > 0)
+    return;
+
+  /* No threads, the files will be opened on demand */
+  FREE(&pf->threads);
+  pthread_cond_destroy(&pf->opened);
+fail_opened:
+  pthread_cond_destroy(&pf->work);
+fail_work:
+  pthread_mutex_destroy(&pf->lock);
+#endif
+}
+
+/**
+ * maildir_prefetch_get - Get an open message file
+ * @param pf    Prefetch state
+ * @param index Index of the file, see maildir_prefetch_add()
+ * @retval ptr  Open file, to be closed by the caller
+ * @retval NULL Error
+ *
+ * The files must be got in order.
+ */
+FILE *maildir_prefetch_get(struct MaildirPrefetch *pf, size_t index)
+{
+  struct PrefetchFile *pff = &pf->files[index];
+
+#ifdef USE_PTHREADS
+  if (pf->num_threads > 0)
+  {
+    pthread_mutex_lock(&pf->lock);
+    pf->wanted = index;
+    pthread_cond_broadcast(&pf->work);
+    while (!pff->done)
+      pthread_cond_wait(&pf->opened, &pf->lock);
+    FILE *fp = pff->fp;
+    pff->fp = NULL;
+    pthread_mutex_unlock(&pf->lock);
+    return fp;
+  }
+#endif
+
+  pf->wanted = index;
+  return prefetch_open(pff->path);
+}
+
+/**
+ * maildir_prefetch_free - Stop opening message files
+ * @param ptr Prefetch state
+ *
+ * Any files that were opened, but not got, are closed.
+ */
+void maildir_prefetch_free(struct MaildirPrefetch **ptr)
+{
+  if (!ptr || !*ptr)
+    return;
+
+  struct MaildirPrefetch *pf = *ptr;
+
+#ifdef USE_PTHREADS
+  if (pf->num_threads > 0)
+  {
+    pthread_mutex_lock(&pf->lock);
+    pf->stop = true;
+    pthread_cond_broadcast(&pf->work);
+    pthread_mutex_unlock(&pf->lock);
+
+    for (int i = 0; i < pf->num_threads; i++)
+      pthread_join(pf->threads[i], NULL);
+
+    pthread_cond_destroy(&pf->opened);
+    pthread_cond_destroy(&pf->work);
+    pthread_mutex_destroy(&pf->lock);
+  }
+  FREE(&pf->threads);
+#endif
+
+  for (size_t i = 0; i < pf->num_files; i++)
+  {
+    mutt_file_fclose(&pf->files[i].fp);
+    FREE(&pf->files[i].path);
+  }
+  FREE(&pf->files);
+  FREE(ptr);
+}
@@ -72,6 +72,7 @@
 /* These Config Variables are only used in maildir/mh.c */
 bool CheckNew; ///< Config: (maildir,mh) Check for new mail while the mailbox is open
 bool MaildirHeaderCacheVerify; ///< Config: (hcache) Check for maildir changes when opening mailbox
+short MaildirReadThreads; ///< Config: Number of threads opening message files
 bool MhPurge;       ///< Config: Really delete files in MH mailboxes
 char *MhSeqFlagged; ///< Config: MH sequence for flagged message
 char *MhSeqReplied; ///< Config: MH sequence to tag replied messages
@@ -79,6 +80,12 @@ char *MhSeqUnseen;  ///< Config: MH sequence for unseen messages
 
 #define INS_SORT_THRESHOLD 6
 
+/* The size of the buffer used to read a directory */
+#define MAILDIR_DIRENT_BUF (256 * 1024)
+/* The number of Maildir entries in the first and largest blocks */
+#define MAILDIR_ARENA_MIN 16
+#define MAILDIR_ARENA_MAX 4096
+
 /**
  * maildir_mdata_free - Free data attached to the Mailbox
  * @param[out] ptr Maildir data
@@ -183,84 +190,6 @@ int mh_mkstemp(struct Mailbox *m, FILE **fp, char **tgt)
   return 0;
 }
 
-/**
- * mh_sequences_add_one - Update the flags for one sequence
- * @param m       Mailbox
- * @param n       Sequence number to update
- * @param unseen  Update the unseen sequence
- * @param flagged Update the flagged sequence
- * @param replied Update the replied sequence
- */
-static void mh_sequences_add_one(struct Mailbox *m, int n, bool unseen, bool flagged, bool replied)
-{
-  bool unseen_done = false;
-  bool flagged_done = false;
-  bool replied_done = false;
-
-  FILE *ofp = NULL, *nfp = NULL;
-
-  char *tmpfname = NULL;
-  char sequences[PATH_MAX];
-
-  char seq_unseen[STRING];
-  char seq_replied[STRING];
-  char seq_flagged[STRING];
-
-  char *buf = NULL;
-  int line = 0;
-  size_t sz;
-
-  if (mh_mkstemp(m, &nfp, &tmpfname) == -1)
-    return;
-
-  snprintf(seq_unseen, sizeof(seq_unseen), "%s:", NONULL(MhSeqUnseen));
-  snprintf(seq_replied, sizeof(seq_replied), "%s:", NONULL(MhSeqReplied));
-  snprintf(seq_flagged, sizeof(seq_flagged), "%s:", NONULL(MhSeqFlagged));
-
-  snprintf(sequences, sizeof(sequences), "%s/.mh_sequences", m->path);
-  ofp = fopen(sequences, "r");
-  if (ofp)
-  {
-    while ((buf = mutt_file_read_line(buf, &sz, ofp, &line, 0)))
-    {
-      if (unseen && (strncmp(buf, seq_unseen, mutt_str_strlen(seq_unseen)) == 0))
-      {
-        fprintf(nfp, "%s %d\n", buf, n);
-        unseen_done = true;
-      }
-      else if (flagged && (strncmp(buf, seq_flagged, mutt_str_strlen(seq_flagged)) == 0))
-      {
-        fprintf(nfp, "%s %d\n", buf, n);
-        flagged_done = true;
-      }
-      else if (replied && (strncmp(buf, seq_replied, mutt_str_strlen(seq_replied)) == 0))
-      {
-        fprintf(nfp, "%s %d\n", buf, n);
-        replied_done = true;
-      }
-      else
-        fprintf(nfp, "%s\n", buf);
-    }
-  }
-  mutt_file_fclose(&ofp);
-  FREE(&buf);
-
-  if (!unseen_done && unseen)
-    fprintf(nfp, "%s: %d\n", NONULL(MhSeqUnseen), n);
-  if (!flagged_done && flagged)
-    fprintf(nfp, "%s: %d\n", NONULL(MhSeqFlagged), n);
-  if (!replied_done && replied)
-    fprintf(nfp, "%s: %d\n", NONULL(MhSeqReplied), n);
-
-  mutt_file_fclose(&nfp);
-
-  unlink(sequences);
-  if (mutt_file_safe_rename(tmpfname, sequences) != 0)
-    unlink(tmpfname);
-
-  FREE(&tmpfname);
-}
-
 /**
  * maildir_free_entry - Free a Maildir object
  * @param[out] md Maildir to free
@@ -286,13 +215,33 @@ static void maildir_free_maildir(struct Maildir **md)
   if (!md || !*md)
     return;
 
-  struct Maildir *p = NULL, *q = NULL;
+  struct Maildir *p = NULL, *q = NULL, *blocks = NULL;
 
   for (p = *md; p; p = q)
   {
     q = p->next;
-    maildir_free_entry(&p);
+    if (p->arena)
+    {
+      /* The entries of a block are freed together, once the list is done */
+      FREE(&p->canon_fname);
+      mutt_email_free(&p->email);
+      if (p->arena_block)
+      {
+        p->next = blocks;
+        blocks = p;
+      }
+    }
+    else
+      maildir_free_entry(&p);
+  }
+
+  for (p = blocks; p; p = q)
+  {
+    q = p->next;
+    FREE(&p);
   }
+
+  *md = NULL;
 }
 
 /**
@@ -325,6 +274,257 @@ static void maildir_update_mtime(struct Mailbox *m)
     mutt_file_get_stat_timespec(&m->mtime, &st, MUTT_STAT_MTIME);
 }
 
+/**
+ * struct MaildirArena - Allocate the Maildir entries of a scan in blocks
+ */
+struct MaildirArena
+{
+  struct Maildir *block; ///< Current block
+  size_t used;           ///< Number of entries used in the block
+  size_t size;           ///< Number of entries in the block
+};
+
+/**
+ * maildir_arena_alloc - Allocate a Maildir entry
+ * @param arena Arena
+ * @retval ptr New Maildir entry
+ *
+ * The blocks grow as the scan goes on, so that small directories stay cheap.
+ * They're freed by maildir_free_maildir().
+ */
+static struct Maildir *maildir_arena_alloc(struct MaildirArena *arena)
+{
+  if (arena->used == arena->size)
+  {
+    arena->size = arena->size ? MIN(arena->size * 2, MAILDIR_ARENA_MAX) : MAILDIR_ARENA_MIN;
+    arena->block = mutt_mem_calloc(arena->size, sizeof(struct Maildir));
+    arena->block[0].arena_block = true;
+    arena->used = 0;
+  }
+
+  struct Maildir *md = &arena->block[arena->used++];
+  md->arena = true;
+  return md;
+}
+
+/**
+ * struct MaildirScan - Read the entries of a directory
+ */
+struct MaildirScan
+{
+#ifdef HAVE_GETDENTS64
+  int fd;     ///< Directory
+  char *buf;  ///< Batch of entries
+  size_t len; ///< Length of the batch
+  size_t pos; ///< Position of the next entry in the batch
+#else
+  DIR *dirp;  ///< Directory
+#endif
+};
+
+/**
+ * maildir_scan_open - Open a directory
+ * @param scan Scan state
+ * @param path Path of the directory
+ * @retval true Success
+ */
+static bool maildir_scan_open(struct MaildirScan *scan, const char *path)
+{
+#ifdef HAVE_GETDENTS64
+  scan->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (scan->fd < 0)
+    return false;
+  scan->buf = mutt_mem_malloc(MAILDIR_DIRENT_BUF);
+  scan->len = 0;
+  scan->pos = 0;
+  return true;
+#else
+  scan->dirp = opendir(path);
+  return scan->dirp;
+#endif
+}
+
+/**
+ * maildir_scan_next - Read the next entry of a directory
+ * @param[in]  scan  Scan state
+ * @param[out] inode Inode of the entry
+ * @param[out] type  Type of the entry, e.g. DT_REG, if known
+ * @retval ptr  Name of the entry, valid until the next call
+ * @retval NULL No more entries
+ *
+ * With getdents64(2), the entries are read in large batches.
+ */
+static const char *maildir_scan_next(struct MaildirScan *scan, ino_t *inode,
+                                     unsigned char *type)
+{
+#ifdef HAVE_GETDENTS64
+  while (scan->pos >= scan->len)
+  {
+    ssize_t n = getdents64(scan->fd, scan->buf, MAILDIR_DIRENT_BUF);
+    if (n <= 0)
+      return NULL;
+    scan->len = n;
+    scan->pos = 0;
+  }
+
+  struct dirent64 *de = (struct dirent64 *) (scan->buf + scan->pos);
+  scan->pos += de->d_reclen;
+  *inode = de->d_ino;
+  *type = de->d_type;
+  return de->d_name;
+#else
+  struct dirent *de = readdir(scan->dirp);
+  if (!de)
+    return NULL;
+  *inode = de->d_ino;
+#ifdef DT_UNKNOWN
+  *type = de->d_type;
+#else
+  *type = 0;
+#endif
+  return de->d_name;
+#endif
+}
+
+/**
+ * maildir_scan_close - Close a directory
+ * @param scan Scan state
+ */
+static void maildir_scan_close(struct MaildirScan *scan)
+{
+#ifdef HAVE_GETDENTS64
+  close(scan->fd);
+  FREE(&scan->buf);
+#else
+  closedir(scan->dirp);
+#endif
+}
+
+/**
+ * maildir_scan_is_file - Might a directory entry be a message file?
+ * @param type Type of the entry, see maildir_scan_next()
+ * @retval true The entry may be a file
+ *
+ * Directories and special files are skipped without needing stat(2).
+ */
+static bool maildir_scan_is_file(unsigned char type)
+{
+#ifdef DT_UNKNOWN
+  return (type == DT_REG) || (type == DT_LNK) || (type == DT_UNKNOWN);
+#else
+  return true;
+#endif
+}
+
+/**
+ * maildir_entry_new - Create a Maildir entry for a message file
+ * @param m      Mailbox
+ * @param arena  Arena to allocate the entry from (OPTIONAL)
+ * @param subdir Subdirectory, e.g. 'new'
+ * @param name   Name of the file
+ * @param inode  Inode of the file
+ * @param is_old Mark the message as old
+ * @retval ptr New Maildir entry
+ */
+static struct Maildir *maildir_entry_new(struct Mailbox *m, struct MaildirArena *arena,
+                                         const char *subdir, const char *name,
+                                         ino_t inode, bool is_old)
+{
+  mutt_debug(LL_DEBUG2, "queueing %s\n", name);
+
+  struct Email *e = mutt_email_new();
+  e->old = is_old;
+  if (m->magic == MUTT_MAILDIR)
+    maildir_parse_flags(e, name);
+
+  if (subdir)
+  {
+    size_t slen = strlen(subdir);
+    size_t nlen = strlen(name);
+    e->path = mutt_mem_malloc(slen + nlen + 2);
+    memcpy(e->path, subdir, slen);
+    e->path[slen] = '/';
+    memcpy(e->path + slen + 1, name, nlen + 1);
+  }
+  else
+    e->path = mutt_str_strdup(name);
+
+  struct Maildir *entry = arena ? maildir_arena_alloc(arena) :
+                                  mutt_mem_calloc(1, sizeof(struct Maildir));
+  entry->email = e;
+  entry->inode = inode;
+  return entry;
+}
+
+#ifdef USE_HCACHE
+/**
+ * struct MaildirManifest - Cached listing of a Maildir/MH directory
+ *
+ * The header is followed by @a count entries, each made of the inode of the
+ * file and its nul-terminated name.
+ */
+struct MaildirManifest
+{
+  struct timespec mtime; ///< Modification time of the directory
+  unsigned int count;    ///< Number of files
+};
+
+/**
+ * maildir_manifest_next - Get the next entry of a manifest
+ * @param[in]  entry Current entry
+ * @param[out] inode Inode of the file
+ * @param[out] name  Name of the file
+ * @retval ptr Next entry
+ */
+static const char *maildir_manifest_next(const char *entry, ino_t *inode, const char **name)
+{
+  memcpy(inode, entry, sizeof(ino_t));
+  *name = entry + sizeof(ino_t);
+  return *name + strlen(*name) + 1;
+}
+
+/**
+ * maildir_manifest_store - Save the listing of a directory in the header cache
+ * @param hc     Header cache handle
+ * @param key    Key of the manifest
+ * @param md     Entries of the directory
+ * @param subdir Subdirectory, e.g. 'new'
+ * @param mtime  Modification time of the directory when it was read
+ *
+ * A directory changed within the current second may change again without
+ * its mtime moving, so its listing isn't worth saving.
+ */
+static void maildir_manifest_store(header_cache_t *hc, const char *key,
+                                   struct Maildir *md, const char *subdir,
+                                   const struct timespec *mtime)
+{
+  if (mtime->tv_sec >= time(NULL))
+  {
+    mutt_debug(LL_DEBUG2, "%s: directory too recently changed\n", key);
+    mutt_hcache_delete(hc, key, strlen(key));
+    return;
+  }
+
+  const size_t skip = subdir ? strlen(subdir) + 1 : 0;
+  struct MaildirManifest mf = { *mtime, 0 };
+  struct Buffer *buf = mutt_buffer_pool_get();
+
+  mutt_buffer_addstr_n(buf, (const char *) &mf, sizeof(mf));
+  for (; md; md = md->next)
+  {
+    if (!md->email)
+      continue;
+    mutt_buffer_addstr_n(buf, (const char *) &md->inode, sizeof(ino_t));
+    mutt_buffer_addstr_n(buf, md->email->path + skip, strlen(md->email->path + skip) + 1);
+    mf.count++;
+  }
+  memcpy(buf->data, &mf, sizeof(mf));
+
+  mutt_hcache_store_raw(hc, key, strlen(key), buf->data, mutt_buffer_len(buf));
+  mutt_buffer_pool_release(&buf);
+}
+#endif
+
 /**
  * maildir_parse_dir - Read a Maildir mailbox
  * @param[in]  m        Mailbox
@@ -335,14 +535,22 @@ static void maildir_update_mtime(struct Mailbox *m)
  * @retval  0 Success
  * @retval -1 Error
  * @retval -2 Aborted
+ *
+ * With the header cache, the listing of the directory is saved as a manifest.
+ * If the directory hasn't changed since, it's listed from the manifest instead
+ * of being read.  Otherwise, the files that the manifest already listed are
+ * marked, so that they don't need checking with stat(2).
  */
 int maildir_parse_dir(struct Mailbox *m, struct Maildir ***last,
                       const char *subdir, int *count, struct Progress *progress)
 {
-  struct dirent *de = NULL;
   int rc = 0, is_old = 0;
   struct Maildir *entry = NULL;
-  struct Email *e = NULL;
+  struct MaildirArena arena = { 0 };
+  struct MaildirScan scan;
+  const char *name = NULL;
+  ino_t inode;
+  unsigned char type;
 
   struct Buffer *buf = mutt_buffer_pool_get();
 
@@ -354,28 +562,87 @@ int maildir_parse_dir(struct Mailbox *m, struct Maildir ***last,
   else
     mutt_buffer_strcpy(buf, m->path);
 
-  DIR *dirp = opendir(mutt_b2s(buf));
-  if (!dirp)
+#ifdef USE_HCACHE
+  char key[STRING];
+  struct Hash *listed = NULL;
+  struct timespec mtime = { 0 };
+  struct timespec listed_mtime = { 0 };
+  struct Maildir **first = *last;
+  struct stat st;
+
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, m->path, NULL);
+  snprintf(key, sizeof(key), "/MANIFEST/%s", NONULL(subdir));
+  void *data = mutt_hcache_fetch_raw(hc, key, strlen(key));
+  const struct MaildirManifest *mf = data;
+
+  if (stat(mutt_b2s(buf), &st) == 0)
+    mutt_file_get_stat_timespec(&mtime, &st, MUTT_STAT_MTIME);
+
+  if (mf)
+    listed_mtime = mf->mtime;
+
+  if (mf && (mutt_file_timespec_compare(&listed_mtime, &mtime) == 0))
+  {
+    mutt_debug(LL_DEBUG2, "%s: listing %u files from the manifest\n",
+               mutt_b2s(buf), mf->count);
+    const char *p = (const char *) (mf + 1);
+    for (unsigned int i = 0; i < mf->count; i++)
+    {
+      p = maildir_manifest_next(p, &inode, &name);
+      entry = maildir_entry_new(m, &arena, subdir, name, inode, is_old);
+      entry->listed = true;
+      if (count)
+      {
+        (*count)++;
+        if (!m->quiet && progress)
+          mutt_progress_update(progress, *count, -1);
+      }
+      **last = entry;
+      *last = &entry->next;
+    }
+    goto cleanup;
+  }
+
+  if (mf)
+  {
+    /* The directory has changed: remember which files were there before */
+    listed = mutt_hash_new(mf->count * 2, 0);
+    const char *p = (const char *) (mf + 1);
+    for (unsigned int i = 0; i < mf->count; i++)
+    {
+      const char *next = maildir_manifest_next(p, &inode, &name);
+      mutt_hash_insert(listed, name, (void *) p);
+      p = next;
+    }
+  }
+#endif
+
+  if (!maildir_scan_open(&scan, mutt_b2s(buf)))
   {
     rc = -1;
     goto cleanup;
   }
 
-  while (((de = readdir(dirp))) && (SigInt != 1))
+  while (((name = maildir_scan_next(&scan, &inode, &type))) && (SigInt != 1))
   {
-    if (((m->magic == MUTT_MH) && !mh_valid_message(de->d_name)) ||
-        ((m->magic == MUTT_MAILDIR) && (*de->d_name == '.')))
+    if (((m->magic == MUTT_MH) && !mh_valid_message(name)) ||
+        ((m->magic == MUTT_MAILDIR) && (*name == '.')) || !maildir_scan_is_file(type))
     {
       continue;
     }
 
-    /* FOO - really ignore the return value? */
-    mutt_debug(LL_DEBUG2, "queueing %s\n", de->d_name);
+    entry = maildir_entry_new(m, &arena, subdir, name, inode, is_old);
 
-    e = mutt_email_new();
-    e->old = is_old;
-    if (m->magic == MUTT_MAILDIR)
-      maildir_parse_flags(e, de->d_name);
+#ifdef USE_HCACHE
+    const char *prev = listed ? mutt_hash_find(listed, name) : NULL;
+    if (prev)
+    {
+      ino_t prev_inode;
+      const char *prev_name = NULL;
+      maildir_manifest_next(prev, &prev_inode, &prev_name);
+      entry->listed = (prev_inode == inode);
+    }
+#endif
 
     if (count)
     {
@@ -384,35 +651,55 @@ int maildir_parse_dir(struct Mailbox *m, struct Maildir ***last,
         mutt_progress_update(progress, *count, -1);
     }
 
-    if (subdir)
-    {
-      mutt_buffer_printf(buf, "%s/%s", subdir, de->d_name);
-      e->path = mutt_str_strdup(mutt_b2s(buf));
-    }
-    else
-      e->path = mutt_str_strdup(de->d_name);
-
-    entry = mutt_mem_calloc(1, sizeof(struct Maildir));
-    entry->email = e;
-    entry->inode = de->d_ino;
     **last = entry;
     *last = &entry->next;
   }
 
-  closedir(dirp);
+  maildir_scan_close(&scan);
 
   if (SigInt == 1)
   {
     SigInt = 0;
-    return -2; /* action aborted */
+    rc = -2; /* action aborted */
+    goto cleanup;
   }
 
+#ifdef USE_HCACHE
+  mutt_hcache_free(hc, &data);
+  maildir_manifest_store(hc, key, *first, subdir, &mtime);
+#endif
+
 cleanup:
+#ifdef USE_HCACHE
+  mutt_hash_free(&listed);
+  mutt_hcache_free(hc, &data);
+  mutt_hcache_close(hc);
+#endif
   mutt_buffer_pool_release(&buf);
 
   return rc;
 }
 
+/**
+ * maildir_parse_file - Queue a single message file of a Maildir mailbox
+ * @param[in]  m      Mailbox
+ * @param[out] last   Last Maildir
+ * @param[in]  subdir Subdirectory, e.g. 'new'
+ * @param[in]  name   Name of the file
+ *
+ * This is the equivalent of maildir_parse_dir(), for a file already known to
+ * be in the directory.  The inode isn't known, so it's left as 0.
+ */
+void maildir_parse_file(struct Mailbox *m, struct Maildir ***last,
+                        const char *subdir, const char *name)
+{
+  bool is_old = MarkOld ? (mutt_str_strcmp("cur", subdir) == 0) : false;
+  struct Maildir *entry = maildir_entry_new(m, NULL, subdir, name, 0, is_old);
+
+  **last = entry;
+  *last = &entry->next;
+}
+
 /**
  * maildir_add_to_context - Add the Maildir list to the Mailbox
  * @param m   Mailbox
@@ -493,6 +780,14 @@ size_t maildir_hcache_keylen(const char *fn)
   const char *p = strrchr(fn, ':');
   return p ? (size_t)(p - fn) : mutt_str_strlen(fn);
 }
+
+/**
+ * maildir_hcache_valid - Was the cache entry written after the file? - Implements ::hcache_valid_t
+ */
+static bool maildir_hcache_valid(const union Validate *valid, void *data)
+{
+  return *(time_t *) data <= valid->timeval.tv_sec;
+}
 #endif
 
 /**
@@ -702,13 +997,19 @@ static struct Maildir *skip_duplicates(struct Maildir *p, struct Maildir **last)
  * @param[in]  m  Mailbox
  * @param[out] md Maildir to parse
  * @param[in]  progress Progress bar
+ *
+ * The emails found in the header cache are restored first.  The others are
+ * parsed afterwards, while their files are opened ahead of the parser, see
+ * @ref maildir_prefetch.
  */
 void maildir_delayed_parsing(struct Mailbox *m, struct Maildir **md, struct Progress *progress)
 {
   struct Maildir *p, *last = NULL;
   char fn[PATH_MAX];
-  int count;
+  int count = 0;
   bool sort = false;
+  struct Maildir **pending = NULL;
+  size_t num_pending = 0, max_pending = 0;
 #ifdef USE_HCACHE
   const char *key = NULL;
   size_t keylen;
@@ -718,9 +1019,11 @@ void maildir_delayed_parsing(struct Mailbox *m, struct Maildir **md, struct Prog
 
 #ifdef USE_HCACHE
   header_cache_t *hc = mutt_hcache_open(HeaderCache, m->path, NULL);
+  /* Write all the newly parsed headers in as few transactions as possible */
+  mutt_hcache_begin(hc);
 #endif
 
-  for (p = *md, count = 0; p; p = p->next, count++)
+  for (p = *md; p; p = p->next)
   {
     if (!(p && p->email && !p->header_parsed))
     {
@@ -728,9 +1031,6 @@ void maildir_delayed_parsing(struct Mailbox *m, struct Maildir **md, struct Prog
       continue;
     }
 
-    if (!m->quiet && progress)
-      mutt_progress_update(progress, count, -1);
-
     if (!sort)
     {
       mutt_debug(LL_DEBUG3, "maildir: need to sort %s by inode\n", m->path);
@@ -747,7 +1047,7 @@ void maildir_delayed_parsing(struct Mailbox *m, struct Maildir **md, struct Prog
     snprintf(fn, sizeof(fn), "%s/%s", m->path, p->email->path);
 
 #ifdef USE_HCACHE
-    if (MaildirHeaderCacheVerify)
+    if (MaildirHeaderCacheVerify && !p->listed)
     {
       ret = stat(fn, &lastchanged);
     }
@@ -767,24 +1067,62 @@ void maildir_delayed_parsing(struct Mailbox *m, struct Maildir **md, struct Prog
       key = p->email->path + 3;
       keylen = maildir_hcache_keylen(key);
     }
-    void *data = mutt_hcache_fetch(hc, key, keylen);
-    struct timeval *when = data;
+    void *data = NULL;
+    if (ret == 0)
+      data = mutt_hcache_fetch_valid(hc, key, keylen, maildir_hcache_valid,
+                                     &lastchanged.st_mtime);
 
-    if (data && !ret && lastchanged.st_mtime <= when->tv_sec)
+    if (data)
     {
-      struct Email *e = mutt_hcache_restore((unsigned char *) data);
+      struct Email *e = mutt_hcache_restore(hc, (unsigned char *) data);
       e->old = p->email->old;
       e->path = mutt_str_strdup(p->email->path);
       mutt_email_free(&p->email);
       p->email = e;
       if (m->magic == MUTT_MAILDIR)
         maildir_parse_flags(p->email, fn);
+
+      if (!m->quiet && progress)
+        mutt_progress_update(progress, ++count, -1);
     }
     else
     {
 #endif
 
-      if (maildir_parse_message(m->magic, fn, p->email->old, p->email))
+      /* Parse it later, once all the files to open are known */
+      if (num_pending == max_pending)
+      {
+        max_pending += 256;
+        mutt_mem_realloc(&pending, max_pending * sizeof(struct Maildir *));
+      }
+      pending[num_pending++] = p;
+#ifdef USE_HCACHE
+    }
+    mutt_hcache_free(hc, &data);
+#endif
+    last = p;
+  }
+
+  if (num_pending > 0)
+  {
+    struct MaildirPrefetch *pf = maildir_prefetch_new(num_pending);
+    for (size_t i = 0; i < num_pending; i++)
+    {
+      snprintf(fn, sizeof(fn), "%s/%s", m->path, pending[i]->email->path);
+      maildir_prefetch_add(pf, fn);
+    }
+    maildir_prefetch_start(pf);
+
+    for (size_t i = 0; i < num_pending; i++)
+    {
+      p = pending[i];
+
+      if (!m->quiet && progress)
+        mutt_progress_update(progress, ++count, -1);
+
+      snprintf(fn, sizeof(fn), "%s/%s", m->path, p->email->path);
+      FILE *fp = maildir_prefetch_get(pf, i);
+      if (fp && maildir_parse_stream(m->magic, fp, fn, p->email->old, p->email))
       {
         p->header_parsed = 1;
 #ifdef USE_HCACHE
@@ -803,13 +1141,15 @@ void maildir_delayed_parsing(struct Mailbox *m, struct Maildir **md, struct Prog
       }
       else
         mutt_email_free(&p->email);
-#ifdef USE_HCACHE
+      mutt_file_fclose(&fp);
     }
-    mutt_hcache_free(hc, &data);
-#endif
-    last = p;
+
+    maildir_prefetch_free(&pf);
+    FREE(&pending);
   }
+
 #ifdef USE_HCACHE
+  mutt_hcache_commit(hc);
   mutt_hcache_close(hc);
 #endif
 
@@ -1424,6 +1764,41 @@ struct Email *maildir_parse_message(enum MailboxType magic, const char *fname,
   return e;
 }
 
+/**
+ * mh_sync_needed - Does an email need saving to the mailbox?
+ * @param m Mailbox
+ * @param e Email
+ * @retval true mh_sync_mailbox_message() has work to do
+ */
+static bool mh_sync_needed(struct Mailbox *m, struct Email *e)
+{
+  return e->deleted || e->changed || e->attach_del ||
+         ((m->magic == MUTT_MAILDIR) && (MaildirTrash || e->trash) && (e->deleted != e->trash));
+}
+
+/**
+ * mh_fsync_dir - Flush the renames and deletions in a directory to disk
+ * @param m      Mailbox
+ * @param subdir Subdirectory, e.g. 'cur', or NULL for the mailbox itself
+ */
+static void mh_fsync_dir(struct Mailbox *m, const char *subdir)
+{
+  char path[PATH_MAX];
+
+  if (subdir)
+    snprintf(path, sizeof(path), "%s/%s", m->path, subdir);
+  else
+    mutt_str_strfcpy(path, m->path, sizeof(path));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  if (fsync(fd) != 0)
+    mutt_debug(LL_DEBUG1, "fsync failed for %s: %s\n", path, strerror(errno));
+  close(fd);
+}
+
 /**
  * mh_sync_mailbox_message - Save changes to the mailbox
  * @param m     Mailbox
@@ -1777,36 +2152,61 @@ int mh_mbox_sync(struct Mailbox *m, int *index_hint)
   if (i != 0)
     return i;
 
+  /* Find the emails to save first, so the progress bar only counts them */
+  int *todo = mutt_mem_calloc(m->msg_count + 1, sizeof(int));
+  int num_todo = 0;
+  for (i = 0; i < m->msg_count; i++)
+    if (mh_sync_needed(m, m->emails[i]))
+      todo[num_todo++] = i;
+
+  mutt_debug(LL_DEBUG2, "%d of %d emails to save\n", num_todo, m->msg_count);
+
 #ifdef USE_HCACHE
   if (m->magic == MUTT_MAILDIR || m->magic == MUTT_MH)
     hc = mutt_hcache_open(HeaderCache, m->path, NULL);
+  /* Store all the changed headers in one transaction */
+  mutt_hcache_begin(hc);
 #endif
 
   if (!m->quiet)
   {
     snprintf(msgbuf, sizeof(msgbuf), _("Writing %s..."), m->path);
-    mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, WriteInc, m->msg_count);
+    mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, WriteInc, num_todo);
   }
 
-  for (i = 0; i < m->msg_count; i++)
+  for (j = 0; j < num_todo; j++)
   {
     if (!m->quiet)
-      mutt_progress_update(&progress, i, -1);
+      mutt_progress_update(&progress, j, -1);
 
 #ifdef USE_HCACHE
-    if (mh_sync_mailbox_message(m, i, hc) == -1)
+    if (mh_sync_mailbox_message(m, todo[j], hc) == -1)
       goto err;
 #else
-    if (mh_sync_mailbox_message(m, i) == -1)
+    if (mh_sync_mailbox_message(m, todo[j]) == -1)
       goto err;
 #endif
   }
 
 #ifdef USE_HCACHE
+  mutt_hcache_commit(hc);
   if (m->magic == MUTT_MAILDIR || m->magic == MUTT_MH)
     mutt_hcache_close(hc);
 #endif
 
+  /* Make all the renames and deletions durable at once */
+  if (num_todo > 0)
+  {
+    if (m->magic == MUTT_MAILDIR)
+    {
+      mh_fsync_dir(m, "cur");
+      mh_fsync_dir(m, "new");
+    }
+    else
+      mh_fsync_dir(m, NULL);
+  }
+  FREE(&todo);
+
   if (m->magic == MUTT_MH)
     mh_update_sequences(m);
 
@@ -1829,9 +2229,11 @@ int mh_mbox_sync(struct Mailbox *m, int *index_hint)
 
 err:
 #ifdef USE_HCACHE
+  mutt_hcache_commit(hc);
   if (m->magic == MUTT_MAILDIR || m->magic == MUTT_MH)
     mutt_hcache_close(hc);
 #endif
+  FREE(&todo);
   return -1;
 }
 
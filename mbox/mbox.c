@@ -35,7 +35,9 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -56,6 +58,9 @@
 #include "progress.h"
 #include "protos.h"
 #include "sort.h"
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
 
 /**
  * struct MUpdate - Store of new offsets, used by mutt_sync_mailbox()
@@ -332,103 +337,257 @@ static int mmdf_parse_mailbox(struct Mailbox *m)
 }
 
 /**
- * mbox_parse_mailbox - Read a mailbox from disk
- * @param m Mailbox
+ * mbox_finish_email - Set the length of a message, if it's not known yet
+ * @param e     Email
+ * @param end   Offset of the end of the message
+ * @param lines Number of lines following the header, including the separator
+ */
+static void mbox_finish_email(struct Email *e, LOFF_T end, int lines)
+{
+  if (e->content->length < 0)
+  {
+    e->content->length = end - e->content->offset - 1;
+    if (e->content->length < 0)
+      e->content->length = 0;
+  }
+
+  if (!e->lines)
+    e->lines = lines ? lines - 1 : 0;
+}
+
+/**
+ * mbox_new_email - Add an Email to the Mailbox and read its header
+ * @param m           Mailbox
+ * @param fp          File, positioned after the From_ line
+ * @param loc         Offset of the From_ line
+ * @param t           Time from the From_ line
+ * @param return_path Return path from the From_ line
+ * @retval ptr New Email
+ */
+static struct Email *mbox_new_email(struct Mailbox *m, FILE *fp, LOFF_T loc,
+                                    time_t t, const char *return_path)
+{
+  if (m->msg_count == m->email_max)
+    mx_alloc_memory(m);
+
+  struct Email *e = mutt_email_new();
+  m->emails[m->msg_count] = e;
+  e->received = t - mutt_date_local_tz(t);
+  e->offset = loc;
+  e->index = m->msg_count;
+
+  e->env = mutt_rfc822_read_header(fp, e, false, false);
+
+  m->msg_count++;
+
+  if (!e->env->return_path && return_path[0])
+    e->env->return_path = mutt_addr_parse_list(e->env->return_path, return_path);
+
+  if (!e->env->from)
+    e->env->from = mutt_addr_copy_list(e->env->return_path, false);
+
+  return e;
+}
+
+/**
+ * mbox_next_from - Find the next line that starts with "From "
+ * @param p   Start of a line
+ * @param end End of the data
+ * @retval ptr Start of the line, or @a end if there isn't one
+ */
+static const char *mbox_next_from(const char *p, const char *end)
+{
+  if (((end - p) >= 5) && (memcmp(p, "From ", 5) == 0))
+    return p;
+
+  const char *q = memmem(p, end - p, "\nFrom ", 6);
+  return q ? q + 1 : end;
+}
+
+/**
+ * mbox_count_lines - Count the newlines in some data
+ * @param p   Start of the data
+ * @param end End of the data
+ * @retval num Number of newlines
+ */
+static int mbox_count_lines(const char *p, const char *end)
+{
+  int lines = 0;
+
+  while ((p < end) && (p = memchr(p, '\n', end - p)))
+  {
+    lines++;
+    p++;
+  }
+
+  return lines;
+}
+
+/**
+ * mbox_parse_map - Read the messages of a memory-mapped mbox
+ * @param m        Mailbox
+ * @param fp       File of the mailbox, used to read the headers
+ * @param map      Contents of the file
+ * @param loc      Offset of the first message to read
+ * @param progress Progress bar, or NULL
  * @retval  0 Success
- * @retval -1 Error
  * @retval -2 Aborted
  *
- * Note that this function is also called when new mail is appended to the
- * currently open folder, and NOT just when the mailbox is initially read.
- *
- * NOTE: it is assumed that the mailbox being read has been locked before this
- * routine gets called.  Strange things could happen if it's not!
+ * Only the From_ lines and the headers are inspected.  The bodies are skipped
+ * by searching for the next "\nFrom ", or by trusting a Content-Length that
+ * leads to a message separator.
  */
-static int mbox_parse_mailbox(struct Mailbox *m)
+static int mbox_parse_map(struct Mailbox *m, FILE *fp, const char *map,
+                          LOFF_T loc, struct Progress *progress)
 {
-  if (!m)
-    return -1;
-
-  struct MboxAccountData *adata = mbox_adata_get(m);
-  if (!adata)
-    return -1;
-
-  struct stat sb;
   char buf[HUGE_STRING], return_path[STRING];
-  struct Email *e_cur = NULL;
+  const char *end = map + m->size;
+  const char *p = map + loc;
+  const char *body = p;
+  struct Email *e = NULL;
+  int count = 0;
   time_t t;
-  int count = 0, lines = 0;
-  LOFF_T loc;
-  struct Progress progress;
 
-  /* Save information about the folder at the time we opened it. */
-  if (stat(m->path, &sb) == -1)
+  while ((p < end) && (SigInt != 1))
   {
-    mutt_perror(m->path);
-    return -1;
-  }
+    const char *from = mbox_next_from(p, end);
+    if (from == end)
+    {
+      p = end;
+      break;
+    }
 
-  m->size = sb.st_size;
-  mutt_file_get_stat_timespec(&m->mtime, &sb, MUTT_STAT_MTIME);
-  mutt_file_get_stat_timespec(&adata->atime, &sb, MUTT_STAT_ATIME);
+    const char *eol = memchr(from, '\n', end - from);
+    const char *next = eol ? eol + 1 : end;
+    const size_t len = MIN((size_t)(next - from), sizeof(buf) - 1);
+    memcpy(buf, from, len);
+    buf[len] = '\0';
 
-  if (!m->readonly)
-    m->readonly = access(m->path, W_OK) ? true : false;
+    if (!is_from(buf, return_path, sizeof(return_path), &t))
+    {
+      p = next;
+      continue;
+    }
 
-  if (!m->quiet)
+    /* Save the Content-Length of the previous message */
+    if (e)
+      mbox_finish_email(e, from - map, mbox_count_lines(body, from));
+
+    count++;
+    if (progress)
+      mutt_progress_update(progress, count, (int) ((from - map) / (m->size / 100 + 1)));
+
+    if (fseeko(fp, next - map, SEEK_SET) != 0)
+    {
+      mutt_debug(LL_DEBUG1, "fseek() failed\n");
+      break;
+    }
+
+    e = mbox_new_email(m, fp, from - map, t, return_path);
+
+    loc = MIN(e->content->offset, m->size);
+    p = map + loc;
+    body = p;
+
+    /* if we know how long this message is, either just skip over the body,
+     * or if we don't know how many lines there are, count them now (this will
+     * save time by not having to search for the next message marker).
+     */
+    if (e->content->length > 0)
+    {
+      /* The test below avoids a potential integer overflow if the
+       * content-length is huge (thus necessarily invalid).
+       */
+      LOFF_T tmploc = (e->content->length < m->size) ?
+                          (loc + e->content->length + 1) :
+                          -1;
+
+      if ((tmploc > 0) && (tmploc < m->size))
+      {
+        /* check to see if the content-length looks valid.  we expect to
+         * to see a valid message separator at this point in the stream
+         */
+        if (((m->size - tmploc) < 5) || (memcmp(map + tmploc, "From ", 5) != 0))
+        {
+          mutt_debug(LL_DEBUG1, "bad content-length in message %d (cl=" OFF_T_FMT ")\n",
+                     e->index, e->content->length);
+          e->content->length = -1;
+        }
+      }
+      else if (tmploc != m->size)
+      {
+        /* content-length would put us past the end of the file, so it
+         * must be wrong
+         */
+        e->content->length = -1;
+      }
+
+      if (e->content->length != -1)
+      {
+        if (e->lines == 0)
+          e->lines = mbox_count_lines(p, p + e->content->length);
+
+        p = map + tmploc;
+        body = p;
+      }
+    }
+  }
+
+  /* Only set the content-length of the previous message if we have read more
+   * than one message during _this_ invocation.  If this routine is called
+   * when new mail is received, we need to make sure not to clobber what
+   * previously was the last message since the headers may be sorted.
+   */
+  if (e)
   {
-    char msgbuf[STRING];
-    snprintf(msgbuf, sizeof(msgbuf), _("Reading %s..."), m->path);
-    mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, ReadInc, 0);
+    int lines = mbox_count_lines(body, p);
+    if ((p > body) && (p[-1] != '\n'))
+      lines++;
+    mbox_finish_email(e, p - map, lines);
   }
 
-  if (!m->emails)
+  if (SigInt == 1)
   {
-    /* Allocate some memory to get started */
-    m->email_max = m->msg_count;
-    m->msg_count = 0;
-    m->msg_unread = 0;
-    m->vcount = 0;
-    mx_alloc_memory(m);
+    SigInt = 0;
+    return -2; /* action aborted */
   }
 
-  loc = ftello(adata->fp);
-  while ((fgets(buf, sizeof(buf), adata->fp)) && (SigInt != 1))
+  return 0;
+}
+
+/**
+ * mbox_parse_stream - Read the messages of an mbox, line by line
+ * @param m        Mailbox
+ * @param fp       File of the mailbox, positioned at the first message to read
+ * @param progress Progress bar, or NULL
+ * @retval  0 Success
+ * @retval -2 Aborted
+ *
+ * This is used if the file can't be mapped into memory.
+ */
+static int mbox_parse_stream(struct Mailbox *m, FILE *fp, struct Progress *progress)
+{
+  char buf[HUGE_STRING], return_path[STRING];
+  struct Email *e_cur = NULL;
+  time_t t;
+  int count = 0, lines = 0;
+  LOFF_T loc;
+
+  loc = ftello(fp);
+  while ((fgets(buf, sizeof(buf), fp)) && (SigInt != 1))
   {
     if (is_from(buf, return_path, sizeof(return_path), &t))
     {
       /* Save the Content-Length of the previous message */
       if (count > 0)
-      {
-        struct Email *e = m->emails[m->msg_count - 1];
-        if (e->content->length < 0)
-        {
-          e->content->length = loc - e->content->offset - 1;
-          if (e->content->length < 0)
-            e->content->length = 0;
-        }
-        if (!e->lines)
-          e->lines = lines ? lines - 1 : 0;
-      }
+        mbox_finish_email(m->emails[m->msg_count - 1], loc, lines);
 
       count++;
 
-      if (!m->quiet)
-      {
-        mutt_progress_update(&progress, count,
-                             (int) (ftello(adata->fp) / (m->size / 100 + 1)));
-      }
-
-      if (m->msg_count == m->email_max)
-        mx_alloc_memory(m);
-
-      m->emails[m->msg_count] = mutt_email_new();
-      e_cur = m->emails[m->msg_count];
-      e_cur->received = t - mutt_date_local_tz(t);
-      e_cur->offset = loc;
-      e_cur->index = m->msg_count;
+      if (progress)
+        mutt_progress_update(progress, count, (int) (ftello(fp) / (m->size / 100 + 1)));
 
-      e_cur->env = mutt_rfc822_read_header(adata->fp, e_cur, false, false);
+      e_cur = mbox_new_email(m, fp, loc, t, return_path);
 
       /* if we know how long this message is, either just skip over the body,
        * or if we don't know how many lines there are, count them now (this will
@@ -438,7 +597,7 @@ static int mbox_parse_mailbox(struct Mailbox *m)
       {
         LOFF_T tmploc;
 
-        loc = ftello(adata->fp);
+        loc = ftello(fp);
 
         /* The test below avoids a potential integer overflow if the
          * content-length is huge (thus necessarily invalid).
@@ -452,15 +611,14 @@ static int mbox_parse_mailbox(struct Mailbox *m)
           /* check to see if the content-length looks valid.  we expect to
            * to see a valid message separator at this point in the stream
            */
-          if (fseeko(adata->fp, tmploc, SEEK_SET) != 0 ||
-              !fgets(buf, sizeof(buf), adata->fp) ||
+          if (fseeko(fp, tmploc, SEEK_SET) != 0 || !fgets(buf, sizeof(buf), fp) ||
               !mutt_str_startswith(buf, "From ", CASE_MATCH))
           {
             mutt_debug(LL_DEBUG1, "bad content-length in message %d (cl=" OFF_T_FMT ")\n",
                        e_cur->index, e_cur->content->length);
             mutt_debug(LL_DEBUG1, "\tLINE: %s", buf);
             /* nope, return the previous position */
-            if ((loc < 0) || (fseeko(adata->fp, loc, SEEK_SET) != 0))
+            if ((loc < 0) || (fseeko(fp, loc, SEEK_SET) != 0))
             {
               mutt_debug(LL_DEBUG1, "#1 fseek() failed\n");
             }
@@ -475,76 +633,551 @@ static int mbox_parse_mailbox(struct Mailbox *m)
           e_cur->content->length = -1;
         }
 
-        if (e_cur->content->length != -1)
-        {
-          /* good content-length.  check to see if we know how many lines
-           * are in this message.
-           */
-          if (e_cur->lines == 0)
-          {
-            int cl = e_cur->content->length;
+        if (e_cur->content->length != -1)
+        {
+          /* good content-length.  check to see if we know how many lines
+           * are in this message.
+           */
+          if (e_cur->lines == 0)
+          {
+            int cl = e_cur->content->length;
+
+            /* count the number of lines in this message */
+            if ((loc < 0) || (fseeko(fp, loc, SEEK_SET) != 0))
+              mutt_debug(LL_DEBUG1, "#2 fseek() failed\n");
+            while (cl-- > 0)
+            {
+              if (fgetc(fp) == '\n')
+                e_cur->lines++;
+            }
+          }
+
+          /* return to the offset of the next message separator */
+          if (fseeko(fp, tmploc, SEEK_SET) != 0)
+            mutt_debug(LL_DEBUG1, "#3 fseek() failed\n");
+        }
+      }
+
+      lines = 0;
+    }
+    else
+      lines++;
+
+    loc = ftello(fp);
+  }
+
+  /* Only set the content-length of the previous message if we have read more
+   * than one message during _this_ invocation.  If this routine is called
+   * when new mail is received, we need to make sure not to clobber what
+   * previously was the last message since the headers may be sorted.
+   */
+  if (count > 0)
+    mbox_finish_email(m->emails[m->msg_count - 1], ftello(fp), lines);
+
+  if (SigInt == 1)
+  {
+    SigInt = 0;
+    return -2; /* action aborted */
+  }
+
+  return 0;
+}
+
+/**
+ * mbox_parse_mailbox - Read a mailbox from disk
+ * @param m Mailbox
+ * @retval  0 Success
+ * @retval -1 Error
+ * @retval -2 Aborted
+ *
+ * Note that this function is also called when new mail is appended to the
+ * currently open folder, and NOT just when the mailbox is initially read.
+ *
+ * The file is mapped into memory, so that the bodies of the messages can be
+ * skipped without reading them line by line.
+ *
+ * NOTE: it is assumed that the mailbox being read has been locked before this
+ * routine gets called.  Strange things could happen if it's not!
+ */
+static int mbox_parse_mailbox(struct Mailbox *m)
+{
+  if (!m)
+    return -1;
+
+  struct MboxAccountData *adata = mbox_adata_get(m);
+  if (!adata)
+    return -1;
+
+  struct stat sb;
+  struct Progress progress;
+  int rc;
+
+  /* Save information about the folder at the time we opened it. */
+  if (stat(m->path, &sb) == -1)
+  {
+    mutt_perror(m->path);
+    return -1;
+  }
+
+  m->size = sb.st_size;
+  mutt_file_get_stat_timespec(&m->mtime, &sb, MUTT_STAT_MTIME);
+  mutt_file_get_stat_timespec(&adata->atime, &sb, MUTT_STAT_ATIME);
+
+  if (!m->readonly)
+    m->readonly = access(m->path, W_OK) ? true : false;
+
+  if (!m->quiet)
+  {
+    char msgbuf[STRING];
+    snprintf(msgbuf, sizeof(msgbuf), _("Reading %s..."), m->path);
+    mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, ReadInc, 0);
+  }
+
+  if (!m->emails)
+  {
+    /* Allocate some memory to get started */
+    m->email_max = m->msg_count;
+    m->msg_count = 0;
+    m->msg_unread = 0;
+    m->vcount = 0;
+    mx_alloc_memory(m);
+  }
+
+  const LOFF_T loc = ftello(adata->fp);
+  void *map = MAP_FAILED;
+  if ((loc >= 0) && (loc < m->size) && ((uint64_t) m->size <= SIZE_MAX))
+    map = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fileno(adata->fp), 0);
+
+  if (map != MAP_FAILED)
+  {
+    posix_madvise(map, m->size, POSIX_MADV_SEQUENTIAL);
+    rc = mbox_parse_map(m, adata->fp, map, loc, m->quiet ? NULL : &progress);
+    munmap(map, m->size);
+  }
+  else
+  {
+    rc = mbox_parse_stream(m, adata->fp, m->quiet ? NULL : &progress);
+  }
+
+  return rc;
+}
+
+#ifdef USE_HCACHE
+#define MBOX_INDEX_VERSION 3
+
+/**
+ * struct MboxIndex - Index of an mbox, saved in the header cache
+ *
+ * The index is followed by one MboxIndexEntry per message, in file order.
+ * The Emails themselves are stored under their offset, with the hash of
+ * their entry as validity datum, see mbox_hcache_validity().
+ */
+struct MboxIndex
+{
+  unsigned int version;  ///< Layout of the index, #MBOX_INDEX_VERSION
+  unsigned int count;    ///< Number of entries
+  size_t len;            ///< Length of the record, including the entries
+  uint64_t hash;         ///< Hash of the entries
+  LOFF_T size;           ///< Size of the file covered by the index
+  struct timespec mtime; ///< Modification time of the file, or 0 if unreliable
+};
+
+/**
+ * struct MboxIndexEntry - A message in the index of an mbox
+ */
+struct MboxIndexEntry
+{
+  LOFF_T offset;  ///< Offset of the header
+  LOFF_T hdr_len; ///< Length of the header
+  uint64_t hash;  ///< Hash of the header
+};
+
+/**
+ * mbox_hash - Hash the header of a message, or the entries of the index
+ * @param p   Start of the data
+ * @param len Length of the data
+ * @retval num Hash (FNV-1a)
+ *
+ * The From_ line is part of a header, so is any Status line that may be
+ * rewritten in place.
+ */
+static uint64_t mbox_hash(const unsigned char *p, size_t len)
+{
+  uint64_t h = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+/**
+ * mbox_hcache_key - Get the header cache key of a message
+ * @param buf    Buffer for the key
+ * @param buflen Length of the buffer
+ * @param offset Offset of the message
+ * @retval num Length of the key
+ */
+static size_t mbox_hcache_key(char *buf, size_t buflen, LOFF_T offset)
+{
+  return snprintf(buf, buflen, "/" OFF_T_FMT, offset);
+}
+
+/**
+ * mbox_hcache_validity - Get the validity datum of a cached message
+ * @param hash Hash of the message's header, see mbox_hash()
+ * @retval num Validity datum, never 0
+ *
+ * This ties the cached Email to its entry in the index.
+ */
+static unsigned int mbox_hcache_validity(uint64_t hash)
+{
+  return (unsigned int) (hash >> 32) | 1;
+}
+
+/**
+ * mbox_hcache_valid - Does a cached message match its index entry? - Implements ::hcache_valid_t
+ */
+static bool mbox_hcache_valid(const union Validate *valid, void *data)
+{
+  const struct MboxIndexEntry *entry = data;
+  return valid->uidvalidity == mbox_hcache_validity(entry->hash);
+}
+
+/**
+ * mbox_index_fetch - Fetch the index of an mbox from the header cache
+ * @param[in]  hc  Header cache
+ * @param[out] idx Header of the index
+ * @retval ptr  Record, the entries follow the header
+ * @retval NULL No usable index
+ *
+ * An index written by another version, or whose length or hash don't match
+ * its entries, e.g. a truncated record, is ignored.  The record must be freed with mutt_hcache_free().
+ */
+static void *mbox_index_fetch(header_cache_t *hc, struct MboxIndex *idx)
+{
+  size_t len = 0;
+  void *data = mutt_hcache_fetch_raw_len(hc, "/INDEX", 6, &len);
+  if (!data)
+    return NULL;
+
+  memset(idx, 0, sizeof(*idx));
+  if (len >= sizeof(*idx))
+    memcpy(idx, data, sizeof(*idx));
+
+  const size_t elen = (size_t) idx->count * sizeof(struct MboxIndexEntry);
+  if ((idx->version != MBOX_INDEX_VERSION) || (idx->len != len) ||
+      (len != sizeof(*idx) + elen) ||
+      (mbox_hash((const unsigned char *) data + sizeof(*idx), elen) != idx->hash))
+  {
+    mutt_debug(LL_DEBUG1, "ignoring an invalid index\n");
+    mutt_hcache_free(hc, &data);
+    return NULL;
+  }
+
+  return data;
+}
+
+/**
+ * mbox_cmp_offset - Compare two Emails by their offset - Implements ::sort_t
+ */
+static int mbox_cmp_offset(const void *a, const void *b)
+{
+  const struct Email *ea = *(struct Email const *const *) a;
+  const struct Email *eb = *(struct Email const *const *) b;
+
+  return (ea->offset > eb->offset) - (ea->offset < eb->offset);
+}
+
+/**
+ * mbox_is_boundary - Does a message start at this offset?
+ * @param m    Mailbox
+ * @param map  Contents of the file
+ * @param size Size of the file
+ * @param loc  Offset to check
+ * @retval true A message separator starts at @a loc, or it's the end of the file
+ */
+static bool mbox_is_boundary(struct Mailbox *m, const char *map, LOFF_T size, LOFF_T loc)
+{
+  if (loc == size)
+    return true;
+  if ((loc < 0) || (loc > size))
+    return false;
+
+  if (m->magic == MUTT_MMDF)
+  {
+    const size_t len = sizeof(MMDF_SEP) - 1;
+    return ((size - loc) >= len) && (memcmp(map + loc, MMDF_SEP, len) == 0);
+  }
+
+  char buf[HUGE_STRING];
+  const char *eol = memchr(map + loc, '\n', size - loc);
+  const size_t len = MIN((size_t)((eol ? eol : map + size) - (map + loc)), sizeof(buf) - 1);
+  memcpy(buf, map + loc, len);
+  buf[len] = '\0';
+  return is_from(buf, NULL, 0, NULL);
+}
+
+/**
+ * mbox_map - Map a mailbox file into memory
+ * @param m    Mailbox
+ * @param size Number of bytes to map
+ * @retval ptr  Contents of the file
+ * @retval NULL Error
+ */
+static const char *mbox_map(struct Mailbox *m, LOFF_T size)
+{
+  struct MboxAccountData *adata = mbox_adata_get(m);
+  if (!adata || !adata->fp || (size <= 0) || ((uint64_t) size > SIZE_MAX))
+    return NULL;
+
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(adata->fp), 0);
+  return (map == MAP_FAILED) ? NULL : map;
+}
+
+/**
+ * mbox_hcache_restore - Restore the unchanged messages from the header cache
+ * @param[in]  m        Mailbox
+ * @param[out] uptodate Set to true if the index matches the file exactly
+ * @retval num Offset from which the file needs parsing
+ *
+ * If the file has the size and mtime recorded in the index, all the messages
+ * are restored.  Otherwise, the header of each message is checked against its
+ * hash, and the messages are restored up to the first one that changed.
+ */
+static LOFF_T mbox_hcache_restore(struct Mailbox *m, bool *uptodate)
+{
+  struct MboxAccountData *adata = mbox_adata_get(m);
+  struct stat st;
+  char key[32];
+
+  *uptodate = false;
+  if (!adata || (fstat(fileno(adata->fp), &st) != 0))
+    return 0;
+
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, m->path, NULL);
+  struct MboxIndex idx;
+  void *data = mbox_index_fetch(hc, &idx);
+  if (!data)
+  {
+    mutt_hcache_close(hc);
+    return 0;
+  }
+
+  const struct MboxIndexEntry *entries = (const struct MboxIndexEntry *) ((char *) data + sizeof(idx));
+
+  struct timespec mtime;
+  mutt_file_get_stat_timespec(&mtime, &st, MUTT_STAT_MTIME);
+  const bool unchanged = (idx.size == st.st_size) && (idx.mtime.tv_sec != 0) &&
+                         (mutt_file_timespec_compare(&idx.mtime, &mtime) == 0);
+
+  const char *map = NULL;
+  if (!unchanged)
+  {
+    map = mbox_map(m, st.st_size);
+    if (!map)
+    {
+      mutt_hcache_free(hc, &data);
+      mutt_hcache_close(hc);
+      return 0;
+    }
+  }
+
+  struct Progress progress;
+  if (!m->quiet)
+  {
+    char msgbuf[STRING];
+    snprintf(msgbuf, sizeof(msgbuf), _("Reading %s..."), m->path);
+    mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, ReadInc, idx.count);
+  }
+
+  unsigned int i;
+  for (i = 0; i < idx.count; i++)
+  {
+    struct MboxIndexEntry entry;
+    memcpy(&entry, &entries[i], sizeof(entry));
+
+    if (!unchanged && ((entry.offset + entry.hdr_len > st.st_size) ||
+                       (mbox_hash((const unsigned char *) map + entry.offset,
+                                         entry.hdr_len) != entry.hash)))
+    {
+      break;
+    }
 
-            /* count the number of lines in this message */
-            if ((loc < 0) || (fseeko(adata->fp, loc, SEEK_SET) != 0))
-              mutt_debug(LL_DEBUG1, "#2 fseek() failed\n");
-            while (cl-- > 0)
-            {
-              if (fgetc(adata->fp) == '\n')
-                e_cur->lines++;
-            }
-          }
+    const size_t keylen = mbox_hcache_key(key, sizeof(key), entry.offset);
+    void *edata = mutt_hcache_fetch_valid(hc, key, keylen, mbox_hcache_valid, &entry);
+    if (!edata)
+      break;
 
-          /* return to the offset of the next message separator */
-          if (fseeko(adata->fp, tmploc, SEEK_SET) != 0)
-            mutt_debug(LL_DEBUG1, "#3 fseek() failed\n");
-        }
-      }
+    struct Email *e = mutt_hcache_restore(hc, edata);
+    mutt_hcache_free(hc, &edata);
+    if ((e->offset != entry.offset) || (e->content->offset != entry.offset + entry.hdr_len))
+    {
+      mutt_debug(LL_DEBUG1, "cached message at " OFF_T_FMT " doesn't match the index\n",
+                 entry.offset);
+      mutt_email_free(&e);
+      break;
+    }
 
-      m->msg_count++;
+    if (m->msg_count == m->email_max)
+      mx_alloc_memory(m);
+    e->index = m->msg_count;
+    m->emails[m->msg_count++] = e;
 
-      if (!e_cur->env->return_path && return_path[0])
-      {
-        e_cur->env->return_path = mutt_addr_parse_list(e_cur->env->return_path, return_path);
-      }
+    if (!m->quiet)
+      mutt_progress_update(&progress, m->msg_count, -1);
+  }
 
-      if (!e_cur->env->from)
-        e_cur->env->from = mutt_addr_copy_list(e_cur->env->return_path, false);
+  LOFF_T resume = idx.size;
+  if (i < idx.count)
+  {
+    memcpy(&resume, &entries[i].offset, sizeof(resume));
+    if (m->magic == MUTT_MMDF)
+      resume -= sizeof(MMDF_SEP) - 1;
+  }
 
-      lines = 0;
+  if (map)
+  {
+    /* The data following the last restored message must be a new message */
+    if ((m->msg_count > 0) && !mbox_is_boundary(m, map, st.st_size, resume))
+    {
+      mutt_debug(LL_DEBUG1, "no message at " OFF_T_FMT ", reading the whole file\n", resume);
+      for (int j = 0; j < m->msg_count; j++)
+        mutt_email_free(&m->emails[j]);
+      m->msg_count = 0;
     }
-    else
-      lines++;
+    munmap((void *) map, st.st_size);
+  }
+
+  mutt_debug(LL_DEBUG2, "restored %d of %u messages, parsing from " OFF_T_FMT "\n",
+             m->msg_count, idx.count, resume);
+
+  *uptodate = unchanged && (m->msg_count == idx.count);
+  mutt_hcache_free(hc, &data);
+  mutt_hcache_close(hc);
+  return (m->msg_count > 0) ? resume : 0;
+}
+
+/**
+ * mbox_hcache_save - Save the messages and the index of an mbox
+ * @param m    Mailbox
+ * @param from First Email that isn't in the header cache yet
+ *
+ * The Emails are taken in file order, whatever the sort of the Mailbox.  The
+ * first @a from of them must already be in the header cache.  The rest must
+ * match the file, e.g. they were just read or written.  Deleted Emails are
+ * skipped: they aren't in the file any more.
+ */
+static void mbox_hcache_save(struct Mailbox *m, int from)
+{
+  struct MboxAccountData *adata = mbox_adata_get(m);
+  struct stat st;
+  char key[32];
+
+  if (!adata || !adata->fp || (fstat(fileno(adata->fp), &st) != 0) || (st.st_size < m->size))
+    return;
 
-    loc = ftello(adata->fp);
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, m->path, NULL);
+  if (!hc)
+    return;
+
+  const char *map = mbox_map(m, m->size);
+  if (!map)
+  {
+    mutt_hcache_delete(hc, "/INDEX", 6);
+    mutt_hcache_close(hc);
+    return;
   }
 
-  /* Only set the content-length of the previous message if we have read more
-   * than one message during _this_ invocation.  If this routine is called
-   * when new mail is received, we need to make sure not to clobber what
-   * previously was the last message since the headers may be sorted.
-   */
-  if (count > 0)
+  /* New mail is appended, so it follows the Emails already cached */
+  struct Email **emails = mutt_mem_calloc(m->msg_count, sizeof(struct Email *));
+  memcpy(emails, m->emails, m->msg_count * sizeof(struct Email *));
+  qsort(emails, m->msg_count, sizeof(struct Email *), mbox_cmp_offset);
+
+  struct MboxIndex idx = { 0 };
+  struct Buffer *buf = mutt_buffer_pool_get();
+  mutt_buffer_addstr_n(buf, (const char *) &idx, sizeof(idx));
+
+  /* Keep the entries of the Emails that were already cached */
+  struct MboxIndex old;
+  void *data = mbox_index_fetch(hc, &old);
+  if (data)
   {
-    struct Email *e = m->emails[m->msg_count - 1];
-    if (e->content->length < 0)
+    const struct MboxIndexEntry *entries = (const struct MboxIndexEntry *) ((char *) data + sizeof(old));
+    while ((idx.count < old.count) && (idx.count < (unsigned int) from))
     {
-      e->content->length = ftello(adata->fp) - e->content->offset - 1;
-      if (e->content->length < 0)
-        e->content->length = 0;
+      struct MboxIndexEntry entry;
+      memcpy(&entry, &entries[idx.count], sizeof(entry));
+      if (entry.offset != emails[idx.count]->offset)
+        break;
+      mutt_buffer_addstr_n(buf, (const char *) &entry, sizeof(entry));
+      idx.count++;
     }
+    mutt_hcache_free(hc, &data);
+  }
+
+  /* The index must list every message, in order, so it ends at the first gap */
+  int next = idx.count;
+  if (idx.count == (unsigned int) from)
+  {
+    mutt_hcache_begin(hc);
+    for (; next < m->msg_count; next++)
+    {
+      struct Email *e = emails[next];
+      if (e->deleted)
+        continue;
+
+      struct MboxIndexEntry entry = { 0 };
+      entry.offset = e->offset;
+      entry.hdr_len = e->content->offset - e->offset;
+      if ((entry.hdr_len < 0) || (entry.offset + entry.hdr_len > m->size))
+        break;
+      entry.hash = mbox_hash((const unsigned char *) map + entry.offset, entry.hdr_len);
 
-    if (!e->lines)
-      e->lines = lines ? lines - 1 : 0;
+      const size_t keylen = mbox_hcache_key(key, sizeof(key), e->offset);
+      if (mutt_hcache_store(hc, key, keylen, e, mbox_hcache_validity(entry.hash)) != 0)
+        break;
+
+      mutt_buffer_addstr_n(buf, (const char *) &entry, sizeof(entry));
+      idx.count++;
+    }
   }
 
-  if (SigInt == 1)
+  if (next < m->msg_count)
   {
-    SigInt = 0;
-    return -2; /* action aborted */
+    /* The rest of the file will be read again */
+    idx.size = emails[next]->offset;
+    if (m->magic == MUTT_MMDF)
+      idx.size -= sizeof(MMDF_SEP) - 1;
+  }
+  else
+  {
+    /* A file changed within the current second may change again without its
+     * mtime moving, and something may have been appended since we read it. */
+    idx.size = m->size;
+    if ((st.st_size == m->size) && (st.st_mtime < time(NULL)))
+      mutt_file_get_stat_timespec(&idx.mtime, &st, MUTT_STAT_MTIME);
   }
+  idx.version = MBOX_INDEX_VERSION;
+  idx.len = mutt_buffer_len(buf);
+  idx.hash = mbox_hash((const unsigned char *) buf->data + sizeof(idx),
+                       idx.len - sizeof(idx));
+  memcpy(buf->data, &idx, sizeof(idx));
 
-  return 0;
+  mutt_hcache_store_raw(hc, "/INDEX", 6, buf->data, mutt_buffer_len(buf));
+  mutt_hcache_commit(hc);
+
+  mutt_debug(LL_DEBUG2, "saved %u messages in the index\n", idx.count);
+
+  mutt_buffer_pool_release(&buf);
+  FREE(&emails);
+  munmap((void *) map, m->size);
+  mutt_hcache_close(hc);
 }
+#endif
 
 /**
  * reopen_mailbox - Close and reopen a mailbox
@@ -659,6 +1292,14 @@ static int reopen_mailbox(struct Mailbox *m, int *index_hint)
 
   if (!m->readonly)
   {
+#ifdef USE_HCACHE
+    /* compare like with like: the old Emails may have come from the cache */
+    for (j = 0; j < old_msgcount; j++)
+      mutt_hcache_restore_deferred(old_hdrs[j]);
+    for (i = 0; i < m->msg_count; i++)
+      mutt_hcache_restore_deferred(m->emails[i]);
+#endif
+
     for (i = 0; i < m->msg_count; i++)
     {
       bool found = false;
@@ -938,6 +1579,14 @@ static int mbox_mbox_open(struct Mailbox *m)
     return -1;
   }
 
+#ifdef USE_HCACHE
+  bool uptodate = false;
+  const LOFF_T resume = mbox_hcache_restore(m, &uptodate);
+  const int restored = m->msg_count;
+  if (fseeko(adata->fp, resume, SEEK_SET) != 0)
+    mutt_debug(LL_DEBUG1, "fseek() failed\n");
+#endif
+
   int rc;
   if (m->magic == MUTT_MBOX)
     rc = mbox_parse_mailbox(m);
@@ -947,6 +1596,11 @@ static int mbox_mbox_open(struct Mailbox *m)
     rc = -1;
   mutt_file_touch_atime(fileno(adata->fp));
 
+#ifdef USE_HCACHE
+  if ((rc == 0) && (!uptodate || (m->msg_count > restored)))
+    mbox_hcache_save(m, restored);
+#endif
+
   mbox_unlock_mailbox(m);
   mutt_sig_unblock();
   return rc;
@@ -982,6 +1636,7 @@ static int mbox_mbox_open_append(struct Mailbox *m, int flags)
   }
 
   fseek(adata->fp, 0, SEEK_END);
+  adata->batch = (flags & MUTT_BATCH);
 
   return 0;
 }
@@ -1071,6 +1726,11 @@ static int mbox_mbox_check(struct Mailbox *m, int *index_hint)
           else
             mmdf_parse_mailbox(m);
 
+#ifdef USE_HCACHE
+          if (m->msg_count > old_msg_count)
+            mbox_hcache_save(m, old_msg_count);
+#endif
+
           if (m->msg_count > old_msg_count)
             mutt_mailbox_changed(m, MBN_INVALID);
 
@@ -1121,6 +1781,191 @@ static int mbox_mbox_check(struct Mailbox *m, int *index_hint)
   return -1;
 }
 
+/**
+ * struct StatusField - Location of a status field in the file
+ */
+struct StatusField
+{
+  LOFF_T offset; ///< Offset of the value, following the colon, or -1 if missing
+  size_t len;    ///< Length of the value, excluding the newline
+};
+
+/**
+ * mbox_find_status - Find the Status: and X-Status: fields of a message
+ * @param[in]  fp      File of the mailbox
+ * @param[in]  e       Email
+ * @param[out] status  Location of the Status: field
+ * @param[out] xstatus Location of the X-Status: field
+ * @retval true Success
+ * @retval false Error, or a field is repeated or too long
+ */
+static bool mbox_find_status(FILE *fp, struct Email *e, struct StatusField *status,
+                             struct StatusField *xstatus)
+{
+  char buf[LONG_STRING];
+  LOFF_T loc = e->offset;
+  bool bol = true;
+
+  status->offset = -1;
+  xstatus->offset = -1;
+
+  if (fseeko(fp, loc, SEEK_SET) != 0)
+    return false;
+
+  while ((loc < e->content->offset) && fgets(buf, sizeof(buf), fp))
+  {
+    size_t len = strlen(buf);
+    const bool eol = (len > 0) && (buf[len - 1] == '\n');
+
+    if (bol)
+    {
+      struct StatusField *field = NULL;
+      size_t taglen = mutt_str_startswith(buf, "Status:", CASE_IGNORE);
+      if (taglen != 0)
+        field = status;
+      else if ((taglen = mutt_str_startswith(buf, "X-Status:", CASE_IGNORE)) != 0)
+        field = xstatus;
+
+      if (field)
+      {
+        if ((field->offset >= 0) || !eol)
+          return false;
+        field->offset = loc + taglen;
+        field->len = len - taglen - 1;
+        if ((field->len > 0) && (buf[len - 2] == '\r'))
+          field->len--;
+      }
+    }
+
+    bol = eol;
+    loc += len;
+  }
+
+  return !ferror(fp);
+}
+
+/**
+ * mbox_write_status - Overwrite the value of a status field
+ * @param fp    File of the mailbox
+ * @param field Location of the field
+ * @param value New value, without the leading space
+ * @param write If false, only check that the value fits
+ * @retval true The value fits (and was written)
+ * @retval false The value doesn't fit, or the write failed
+ *
+ * The value is padded with spaces, which the parser ignores.
+ */
+static bool mbox_write_status(FILE *fp, const struct StatusField *field,
+                              const char *value, bool write)
+{
+  char buf[STRING];
+
+  if (field->offset < 0)
+    return (value[0] == '\0');
+
+  const size_t need = (value[0] != '\0') ? strlen(value) + 1 : 0;
+  if ((field->len < need) || (field->len >= sizeof(buf)))
+    return false;
+  if (!write)
+    return true;
+
+  memset(buf, ' ', field->len);
+  if (need > 0)
+    memcpy(buf + 1, value, need - 1);
+
+  return (fseeko(fp, field->offset, SEEK_SET) == 0) &&
+         (fwrite(buf, 1, field->len, fp) == field->len);
+}
+
+/**
+ * mbox_update_status - Update the flags of a message in place
+ * @param fp    File of the mailbox, opened for reading and writing
+ * @param e     Email
+ * @param write If false, only check that the message can be updated in place
+ * @retval true The flags fit in the existing fields (and were written)
+ * @retval false The message must be rewritten
+ *
+ * The fields are written the same way as mutt_copy_header() does.
+ */
+static bool mbox_update_status(FILE *fp, struct Email *e, bool write)
+{
+  struct StatusField status, xstatus;
+  char xvalue[3];
+  int n = 0;
+
+  if (!mbox_find_status(fp, e, &status, &xstatus))
+    return false;
+
+  if (e->replied)
+    xvalue[n++] = 'A';
+  if (e->flagged)
+    xvalue[n++] = 'F';
+  xvalue[n] = '\0';
+
+  const char *value = e->read ? "RO" : (e->old ? "O" : "");
+
+  /* Check both fields before writing either */
+  if (!mbox_write_status(fp, &status, value, false) ||
+      !mbox_write_status(fp, &xstatus, xvalue, false))
+  {
+    return false;
+  }
+
+  return !write || (mbox_write_status(fp, &status, value, true) &&
+                    mbox_write_status(fp, &xstatus, xvalue, true));
+}
+
+/**
+ * mbox_sync_in_place - Finish a sync that didn't rewrite any messages
+ * @param m       Mailbox, locked, with signals blocked
+ * @param st      State of the file before the sync
+ * @param first   First message whose flags were updated
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int mbox_sync_in_place(struct Mailbox *m, struct stat *st, int first)
+{
+  struct MboxAccountData *adata = mbox_adata_get(m);
+
+  mbox_unlock_mailbox(m);
+
+  if (mutt_file_fclose(&adata->fp) != 0)
+  {
+    mutt_sig_unblock();
+    mx_fastclose_mailbox(m);
+    mutt_perror(m->path);
+    return -1;
+  }
+
+  /* Restore the previous access/modification times */
+  mbox_reset_atime(m, st);
+
+  /* reopen the mailbox in read-only mode */
+  adata->fp = fopen(m->path, "r");
+  mutt_sig_unblock();
+  if (!adata->fp)
+  {
+    mx_fastclose_mailbox(m);
+    mutt_error(_("Fatal error!  Could not reopen mailbox!"));
+    return -1;
+  }
+
+  mutt_debug(LL_DEBUG2, "updated the flags in place from message %d\n", first);
+
+#ifdef USE_HCACHE
+  mbox_hcache_save(m, first);
+#endif
+
+  if (CheckMboxSize)
+  {
+    struct Mailbox *tmp = mutt_find_mailbox(m->path);
+    if (tmp && !tmp->has_new)
+      mutt_update_mailbox(tmp);
+  }
+
+  return 0;
+}
+
 /**
  * mbox_mbox_sync - Implements MxOps::mbox_sync()
  */
@@ -1137,9 +1982,10 @@ static int mbox_mbox_sync(struct Mailbox *m, int *index_hint)
   char buf[32];
   int i, j, save_sort = SORT_ORDER;
   int rc = -1;
-  int need_sort = 0; /* flag to resort mailbox if new mail arrives */
-  int first = -1;    /* first message to be written */
-  LOFF_T offset;     /* location in mailbox to write changed messages */
+  int need_sort = 0;      /* flag to resort mailbox if new mail arrives */
+  int first = -1;         /* first message to be written */
+  int first_changed = -1; /* first message to be written or updated in place */
+  LOFF_T offset;          /* location in mailbox to write changed messages */
   struct stat statbuf;
   struct MUpdate *new_offset = NULL;
   struct MUpdate *old_offset = NULL;
@@ -1191,29 +2037,25 @@ static int mbox_mbox_sync(struct Mailbox *m, int *index_hint)
     return -1;
   }
 
-  /* Create a temporary file to write the new version of the mailbox in. */
-  mutt_mktemp(tempfile, sizeof(tempfile));
-  i = open(tempfile, O_WRONLY | O_EXCL | O_CREAT, 0600);
-  if ((i == -1) || !(fp = fdopen(i, "w")))
-  {
-    if (-1 != i)
-    {
-      close(i);
-      unlink(tempfile);
-    }
-    mutt_error(_("Could not create temporary file"));
-    goto bail;
-  }
-
   /* find the first deleted/changed message.  we save a lot of time by only
    * rewriting the mailbox from the point where it has actually changed.
+   * Before that point, messages whose flags are the only change are updated
+   * in place, if their status fields are wide enough.
    */
-  for (i = 0; (i < m->msg_count) && !m->emails[i]->deleted &&
-              !m->emails[i]->changed && !m->emails[i]->attach_del;
-       i++)
+  for (i = 0; i < m->msg_count; i++)
   {
+    struct Email *e = m->emails[i];
+    if (e->deleted || e->attach_del ||
+        (e->changed && (e->env->changed || !mbox_update_status(adata->fp, e, false))))
+    {
+      break;
+    }
+    if (e->changed && (first_changed < 0))
+      first_changed = i;
   }
-  if (i == m->msg_count)
+  if (first_changed < 0)
+    first_changed = i;
+  if (first_changed == m->msg_count)
   {
     /* this means ctx->changed or m->msg_deleted was set, but no
      * messages were found to be changed or deleted.  This should
@@ -1222,7 +2064,39 @@ static int mbox_mbox_sync(struct Mailbox *m, int *index_hint)
     mutt_error(
         _("sync: mbox modified, but no modified messages (report this bug)"));
     mutt_debug(LL_DEBUG1, "no modified messages.\n");
-    unlink(tempfile);
+    goto bail;
+  }
+
+  /* Save the state of this folder. */
+  if (stat(m->path, &statbuf) == -1)
+  {
+    mutt_perror(m->path);
+    goto bail;
+  }
+
+  for (j = first_changed; j < i; j++)
+  {
+    if (m->emails[j]->changed && !mbox_update_status(adata->fp, m->emails[j], true))
+    {
+      mutt_perror(m->path);
+      goto bail;
+    }
+  }
+
+  if (i == m->msg_count)
+    return mbox_sync_in_place(m, &statbuf, first_changed);
+
+  /* Create a temporary file to write the new version of the mailbox in. */
+  mutt_mktemp(tempfile, sizeof(tempfile));
+  j = open(tempfile, O_WRONLY | O_EXCL | O_CREAT, 0600);
+  if ((j == -1) || !(fp = fdopen(j, "w")))
+  {
+    if (-1 != j)
+    {
+      close(j);
+      unlink(tempfile);
+    }
+    mutt_error(_("Could not create temporary file"));
     goto bail;
   }
 
@@ -1282,7 +2156,8 @@ static int mbox_mbox_sync(struct Mailbox *m, int *index_hint)
       new_offset[i - first].hdr = ftello(fp) + offset;
 
       if (mutt_copy_message_ctx(fp, m, m->emails[i], MUTT_CM_UPDATE,
-                                CH_FROM | CH_UPDATE | CH_UPDATE_LEN) != 0)
+                                CH_FROM | CH_UPDATE | CH_UPDATE_LEN |
+                                    (MboxPadStatus ? CH_PAD_STATUS : 0)) != 0)
       {
         mutt_perror(tempfile);
         unlink(tempfile);
@@ -1329,14 +2204,6 @@ static int mbox_mbox_sync(struct Mailbox *m, int *index_hint)
   }
   fp = NULL;
 
-  /* Save the state of this folder. */
-  if (stat(m->path, &statbuf) == -1)
-  {
-    mutt_perror(m->path);
-    unlink(tempfile);
-    goto bail;
-  }
-
   fp = fopen(tempfile, "r");
   if (!fp)
   {
@@ -1445,6 +2312,10 @@ static int mbox_mbox_sync(struct Mailbox *m, int *index_hint)
   unlink(tempfile); /* remove partial copy of the mailbox */
   mutt_sig_unblock();
 
+#ifdef USE_HCACHE
+  mbox_hcache_save(m, first_changed);
+#endif
+
   if (CheckMboxSize)
   {
     struct Mailbox *tmp = mutt_find_mailbox(m->path);
@@ -1496,6 +2367,24 @@ bail: /* Come here in case of disaster */
   return rc;
 }
 
+/**
+ * mbox_mbox_flush - Implements MxOps::mbox_flush()
+ */
+static int mbox_mbox_flush(struct Mailbox *m)
+{
+  struct MboxAccountData *adata = mbox_adata_get(m);
+  if (!adata || !adata->fp)
+    return -1;
+
+  if ((fflush(adata->fp) == EOF) || (fsync(fileno(adata->fp)) == -1))
+  {
+    mutt_perror(_("Can't write message"));
+    return -1;
+  }
+
+  return 0;
+}
+
 /**
  * mbox_mbox_close - Implements MxOps::mbox_close()
  */
@@ -1511,6 +2400,10 @@ static int mbox_mbox_close(struct Mailbox *m)
   if (!adata->fp)
     return 0;
 
+  /* Don't leave a batch of messages in the buffer if the caller didn't flush it */
+  if (adata->batch)
+    mbox_mbox_flush(m);
+
   if (adata->append)
   {
     mutt_file_unlock(fileno(adata->fp));
@@ -1583,6 +2476,11 @@ static int mbox_msg_commit(struct Mailbox *m, struct Message *msg)
   if (fputc('\n', msg->fp) == EOF)
     return -1;
 
+  /* A batch is written once, by mbox_mbox_flush() */
+  struct MboxAccountData *adata = mbox_adata_get(m);
+  if (adata && adata->batch)
+    return 0;
+
   if ((fflush(msg->fp) == EOF) || (fsync(fileno(msg->fp)) == -1))
   {
     mutt_perror(_("Can't write message"));
@@ -1736,6 +2634,10 @@ static int mmdf_msg_commit(struct Mailbox *m, struct Message *msg)
   if (fputs(MMDF_SEP, msg->fp) == EOF)
     return -1;
 
+  struct MboxAccountData *adata = mbox_adata_get(m);
+  if (adata && adata->batch)
+    return 0;
+
   if ((fflush(msg->fp) == EOF) || (fsync(fileno(msg->fp)) == -1))
   {
     mutt_perror(_("Can't write message"));
@@ -1824,6 +2726,7 @@ struct MxOps MxMboxOps = {
   .mbox_check_stats = mbox_mbox_check_stats,
   .mbox_sync        = mbox_mbox_sync,
   .mbox_close       = mbox_mbox_close,
+  .mbox_flush       = mbox_mbox_flush,
   .msg_open         = mbox_msg_open,
   .msg_open_new     = mbox_msg_open_new,
   .msg_commit       = mbox_msg_commit,
@@ -1852,6 +2755,7 @@ struct MxOps MxMmdfOps = {
   .mbox_check_stats = mbox_mbox_check_stats,
   .mbox_sync        = mbox_mbox_sync,
   .mbox_close       = mbox_mbox_close,
+  .mbox_flush       = mbox_mbox_flush,
   .msg_open         = mbox_msg_open,
   .msg_open_new     = mbox_msg_open_new,
   .msg_commit       = mmdf_msg_commit,
@@ -49,6 +49,7 @@ struct MboxAccountData
 
   bool locked : 1; /**< is the mailbox locked? */
   bool append : 1; /**< mailbox is opened in append mode */
+  bool batch : 1;  /**< appended messages are only flushed by mbox_mbox_flush() */
 };
 
 extern struct MxOps MxMboxOps;
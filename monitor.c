@@ -56,9 +56,19 @@ static size_t PollFdsLen = 0;
 static struct pollfd *PollFds = NULL;
 
 static int MonitorContextDescriptor = -1;
+static int MonitorContextCurDescriptor = -1;
+
+static struct MonitorEventList ContextEvents = STAILQ_HEAD_INITIALIZER(ContextEvents);
+static size_t ContextEventsCount = 0;
+static bool ContextEventsValid = false;
 
 #define INOTIFY_MASK_DIR (IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE | IN_ISDIR)
 #define INOTIFY_MASK_FILE IN_CLOSE_WRITE
+/* Extra events for the "new" and "cur" directories of the current Maildir */
+#define INOTIFY_MASK_MAILDIR (IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+/* Beyond this many queued events, rescanning the mailbox is cheaper */
+#define MONITOR_EVENTS_MAX 65536
 
 #define EVENT_BUFLEN MAX(4096, sizeof(struct inotify_event) + NAME_MAX + 1)
 
@@ -141,6 +151,59 @@ static int mutt_poll_fd_remove(int fd)
   return 0;
 }
 
+/**
+ * mutt_monitor_events_free - Free a list of events
+ * @param events List to free
+ */
+void mutt_monitor_events_free(struct MonitorEventList *events)
+{
+  struct MonitorEvent *me = NULL, *tmp = NULL;
+  STAILQ_FOREACH_SAFE(me, events, entries, tmp)
+  {
+    FREE(&me->name);
+    FREE(&me);
+  }
+  STAILQ_INIT(events);
+}
+
+/**
+ * monitor_events_clear - Forget the queued events of the current mailbox
+ * @param valid Will the queue hold all the changes from now on?
+ */
+static void monitor_events_clear(bool valid)
+{
+  mutt_monitor_events_free(&ContextEvents);
+  ContextEventsCount = 0;
+  ContextEventsValid = valid;
+}
+
+/**
+ * monitor_queue_event - Queue a change to a file of the current mailbox
+ * @param event Event from inotify
+ */
+static void monitor_queue_event(const struct inotify_event *event)
+{
+  if (!ContextEventsValid || (event->len == 0) || (event->mask & IN_ISDIR) ||
+      !(event->mask & INOTIFY_MASK_MAILDIR))
+  {
+    return;
+  }
+
+  if (ContextEventsCount == MONITOR_EVENTS_MAX)
+  {
+    mutt_debug(LL_DEBUG3, "too many events, the mailbox will be rescanned\n");
+    monitor_events_clear(false);
+    return;
+  }
+
+  struct MonitorEvent *me = mutt_mem_calloc(1, sizeof(struct MonitorEvent));
+  me->dir = (event->wd == MonitorContextCurDescriptor) ? "cur" : "new";
+  me->name = mutt_str_strdup(event->name);
+  me->added = (event->mask & (IN_MOVED_TO | IN_CREATE));
+  STAILQ_INSERT_TAIL(&ContextEvents, me, entries);
+  ContextEventsCount++;
+}
+
 /**
  * monitor_init - Set up file monitoring
  * @retval  0 Success
@@ -173,6 +236,8 @@ static void monitor_check_free(void)
     close(INotifyFd);
     INotifyFd = -1;
     MonitorFilesChanged = 0;
+    MonitorContextCurDescriptor = -1;
+    monitor_events_clear(false);
   }
 }
 
@@ -236,6 +301,13 @@ static int monitor_handle_ignore(int desc)
   struct Monitor *iter = Monitor;
   struct stat sb;
 
+  if (desc == MonitorContextCurDescriptor)
+  {
+    MonitorContextCurDescriptor = -1;
+    monitor_events_clear(false);
+    return -1;
+  }
+
   while (iter && (iter->desc != desc))
     iter = iter->next;
 
@@ -344,6 +416,48 @@ static int monitor_resolve(struct MonitorInfo *info, struct Mailbox *m)
   return iter ? RESOLVERES_OK_EXISTING : RESOLVERES_OK_NOTEXISTING;
 }
 
+/**
+ * monitor_read_events - Read and dispatch the pending inotify events
+ */
+static void monitor_read_events(void)
+{
+  char buf[EVENT_BUFLEN] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *event = NULL;
+
+  while (true)
+  {
+    int len = read(INotifyFd, buf, sizeof(buf));
+    if (len == -1)
+    {
+      if (errno != EAGAIN)
+        mutt_debug(LL_DEBUG2, "read inotify events failed, errno=%d %s\n",
+                   errno, strerror(errno));
+      break;
+    }
+
+    char *ptr = buf;
+    while (ptr < (buf + len))
+    {
+      event = (const struct inotify_event *) ptr;
+      mutt_debug(LL_DEBUG3, "+ detail: descriptor=%d mask=0x%x\n", event->wd, event->mask);
+      if (event->mask & IN_Q_OVERFLOW)
+      {
+        MonitorContextChanged = 1;
+        monitor_events_clear(false);
+      }
+      else if (event->mask & IN_IGNORED)
+        monitor_handle_ignore(event->wd);
+      else if ((event->wd == MonitorContextDescriptor) ||
+               (event->wd == MonitorContextCurDescriptor))
+      {
+        MonitorContextChanged = 1;
+        monitor_queue_event(event);
+      }
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+  }
+}
+
 /**
  * mutt_monitor_poll - Check for filesystem changes
  * @retval -3 unknown/unexpected events: poll timeout / fds not handled by us
@@ -361,7 +475,6 @@ static int monitor_resolve(struct MonitorInfo *info, struct Mailbox *m)
 int mutt_monitor_poll(void)
 {
   int rc = 0;
-  char buf[EVENT_BUFLEN] __attribute__((aligned(__alignof__(struct inotify_event))));
 
   MonitorFilesChanged = 0;
 
@@ -393,32 +506,7 @@ int mutt_monitor_poll(void)
           {
             MonitorFilesChanged = 1;
             mutt_debug(LL_DEBUG3, "file change(s) detected\n");
-            char *ptr = buf;
-            const struct inotify_event *event;
-
-            while (true)
-            {
-              int len = read(INotifyFd, buf, sizeof(buf));
-              if (len == -1)
-              {
-                if (errno != EAGAIN)
-                  mutt_debug(LL_DEBUG2, "read inotify events failed, errno=%d %s\n",
-                             errno, strerror(errno));
-                break;
-              }
-
-              while (ptr < (buf + len))
-              {
-                event = (const struct inotify_event *) ptr;
-                mutt_debug(LL_DEBUG3, "+ detail: descriptor=%d mask=0x%x\n",
-                           event->wd, event->mask);
-                if (event->mask & IN_IGNORED)
-                  monitor_handle_ignore(event->wd);
-                else if (event->wd == MonitorContextDescriptor)
-                  MonitorContextChanged = 1;
-                ptr += sizeof(struct inotify_event) + event->len;
-              }
-            }
+            monitor_read_events();
           }
         }
       }
@@ -430,6 +518,79 @@ int mutt_monitor_poll(void)
   return rc;
 }
 
+/**
+ * monitor_add_context_maildir - Follow the files of the current Maildir mailbox
+ * @param info Monitor info of the mailbox's "new" directory
+ *
+ * The watch on "new" also gets the creations, deletions and renames, and
+ * "cur" is watched for them too.  This lets mutt_monitor_events() follow
+ * every file of the mailbox.
+ */
+static void monitor_add_context_maildir(struct MonitorInfo *info)
+{
+  char path[PATH_MAX];
+
+  if (!Context || (Context->mailbox->magic != MUTT_MAILDIR) ||
+      (MonitorContextDescriptor == -1) || (MonitorContextCurDescriptor != -1))
+  {
+    return;
+  }
+
+  if (snprintf(path, sizeof(path), "%s/cur", Context->mailbox->realpath) >= sizeof(path))
+    return;
+
+  if (inotify_add_watch(INotifyFd, info->path, INOTIFY_MASK_DIR | INOTIFY_MASK_MAILDIR) == -1)
+  {
+    mutt_debug(LL_DEBUG2, "inotify_add_watch failed for '%s', errno=%d %s\n",
+               info->path, errno, strerror(errno));
+    return;
+  }
+
+  MonitorContextCurDescriptor = inotify_add_watch(INotifyFd, path, INOTIFY_MASK_MAILDIR);
+  if (MonitorContextCurDescriptor == -1)
+  {
+    mutt_debug(LL_DEBUG2, "inotify_add_watch failed for '%s', errno=%d %s\n",
+               path, errno, strerror(errno));
+  }
+  else
+  {
+    mutt_debug(LL_DEBUG3, "inotify_add_watch descriptor=%d for '%s'\n",
+               MonitorContextCurDescriptor, path);
+  }
+
+  /* The events can't be trusted until the mailbox has been checked once */
+  monitor_events_clear(false);
+}
+
+/**
+ * mutt_monitor_events - Get the files added to, or removed from, the current mailbox
+ * @param[in]  m      Mailbox
+ * @param[out] events List for the events
+ * @retval true  @a events holds all the changes since the previous call
+ * @retval false Changes may have been missed, the mailbox should be rescanned
+ *
+ * Only the "new" and "cur" directories of the current Maildir mailbox are
+ * followed.  Whatever the result, the changes made after the call are queued
+ * for the next one.
+ */
+bool mutt_monitor_events(struct Mailbox *m, struct MonitorEventList *events)
+{
+  if (!Context || (Context->mailbox != m) || (MonitorContextCurDescriptor == -1))
+    return false;
+
+  /* Catch up with the changes that happened before the caller looked */
+  monitor_read_events();
+
+  bool valid = ContextEventsValid;
+  if (valid)
+    STAILQ_CONCAT(events, &ContextEvents);
+
+  mutt_debug(LL_DEBUG3, "%zu events, %s\n", ContextEventsCount,
+             valid ? "incremental" : "rescan");
+  monitor_events_clear(true);
+  return valid;
+}
+
 /**
  * mutt_monitor_add - Add a watch for a mailbox
  * @param m Mailbox to watch
@@ -446,7 +607,10 @@ int mutt_monitor_add(struct Mailbox *m)
   if (desc != RESOLVERES_OK_NOTEXISTING)
   {
     if (!m && (desc == RESOLVERES_OK_EXISTING))
+    {
       MonitorContextDescriptor = info.monitor->desc;
+      monitor_add_context_maildir(&info);
+    }
     return (desc == RESOLVERES_OK_EXISTING) ? 0 : -1;
   }
 
@@ -460,10 +624,13 @@ int mutt_monitor_add(struct Mailbox *m)
   }
 
   mutt_debug(LL_DEBUG3, "inotify_add_watch descriptor=%d for '%s'\n", desc, info.path);
+  monitor_new(&info, desc);
   if (!m)
+  {
     MonitorContextDescriptor = desc;
+    monitor_add_context_maildir(&info);
+  }
 
-  monitor_new(&info, desc);
   return 0;
 }
 
@@ -484,6 +651,12 @@ int mutt_monitor_remove(struct Mailbox *m)
   {
     MonitorContextDescriptor = -1;
     MonitorContextChanged = 0;
+    if (MonitorContextCurDescriptor != -1)
+    {
+      inotify_rm_watch(INotifyFd, MonitorContextCurDescriptor);
+      MonitorContextCurDescriptor = -1;
+    }
+    monitor_events_clear(false);
   }
 
   if (monitor_resolve(&info, m) != RESOLVERES_OK_EXISTING)
@@ -502,7 +675,12 @@ int mutt_monitor_remove(struct Mailbox *m)
     else
     {
       if (mutt_find_mailbox(Context->mailbox->realpath))
+      {
+        /* The mailbox list only needs the usual events on "new" */
+        if (info.isdir)
+          inotify_add_watch(INotifyFd, info.path, INOTIFY_MASK_DIR);
         return 1;
+      }
     }
   }
 
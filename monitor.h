@@ -23,13 +23,30 @@
 #ifndef MUTT_MONITOR_H
 #define MUTT_MONITOR_H
 
+#include <stdbool.h>
+#include "mutt/queue.h"
+
 extern int MonitorFilesChanged;   ///< true after a monitored file has changed
 extern int MonitorContextChanged; ///< true after the current mailbox has changed
 
 struct Mailbox;
 
-int mutt_monitor_add(struct Mailbox *m);
-int mutt_monitor_remove(struct Mailbox *m);
-int mutt_monitor_poll(void);
+/**
+ * struct MonitorEvent - A file added to, or removed from, the current mailbox
+ */
+struct MonitorEvent
+{
+  const char *dir; ///< Subdirectory of the mailbox, e.g. "new"
+  char *name;      ///< Name of the file
+  bool added;      ///< The file was added, rather than removed
+  STAILQ_ENTRY(MonitorEvent) entries;
+};
+STAILQ_HEAD(MonitorEventList, MonitorEvent);
+
+int  mutt_monitor_add(struct Mailbox *m);
+bool mutt_monitor_events(struct Mailbox *m, struct MonitorEventList *events);
+void mutt_monitor_events_free(struct MonitorEventList *events);
+int  mutt_monitor_remove(struct Mailbox *m);
+int  mutt_monitor_poll(void);
 
 #endif /* MUTT_MONITOR_H */
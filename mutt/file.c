@@ -34,12 +34,16 @@
 #include <libgen.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 #include <utime.h>
 #include "file.h"
 #include "logging.h"
@@ -57,6 +61,9 @@ static const char safe_chars[] =
 
 #define MAX_LOCK_ATTEMPTS 5
 
+/* Smaller copies aren't worth the extra system calls of copy_in_kernel() */
+#define KERNEL_COPY_MIN 16384
+
 /* This is defined in POSIX:2008 which isn't a build requirement */
 #ifndef O_NOFOLLOW
 #define O_NOFOLLOW 0
@@ -225,6 +232,94 @@ void mutt_file_unlink(const char *s)
   }
 }
 
+/**
+ * copy_in_kernel - Copy some content between two files, without reading it
+ * @param[in]     in   Source file
+ * @param[in]     out  Destination file
+ * @param[in,out] size Maximum number of bytes to copy, set to the number left
+ * @retval  0 Success, or the rest must be copied through stdio
+ * @retval -1 Error, see errno
+ *
+ * If both files are regular files, the data is copied by copy_file_range(2),
+ * or sendfile(2), at the current positions of the streams, which are then
+ * moved past it.  The kernel won't write to an append-only file, so that is
+ * left to stdio.
+ */
+static int copy_in_kernel(FILE *in, FILE *out, size_t *size)
+{
+#if defined(HAVE_COPY_FILE_RANGE) || (defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H))
+  if (*size < KERNEL_COPY_MIN)
+    return 0;
+
+  const int fd_in = fileno(in);
+  const int fd_out = fileno(out);
+  if ((fd_in < 0) || (fd_out < 0))
+    return 0;
+
+  struct stat st;
+  if ((fstat(fd_in, &st) != 0) || !S_ISREG(st.st_mode) ||
+      (fstat(fd_out, &st) != 0) || !S_ISREG(st.st_mode))
+  {
+    return 0;
+  }
+
+  const int flags = fcntl(fd_out, F_GETFL);
+  if ((flags == -1) || (flags & O_APPEND) || (fflush(out) != 0))
+    return 0;
+
+  off_t off_in = ftello(in);
+  off_t off_out = ftello(out);
+  if ((off_in < 0) || (off_out < 0))
+    return 0;
+
+  bool use_range = true;
+  while (*size > 0)
+  {
+    const size_t chunk = MIN(*size, (size_t) 1 << 30);
+    ssize_t n = -1;
+
+#ifdef HAVE_COPY_FILE_RANGE
+    if (use_range)
+    {
+      n = copy_file_range(fd_in, &off_in, fd_out, &off_out, chunk, 0);
+      if ((n < 0) && (errno != EINTR))
+        use_range = false;
+    }
+#else
+    use_range = false;
+#endif
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+    if (!use_range)
+    {
+      /* sendfile() writes at, and moves, the file offset of the destination */
+      if (lseek(fd_out, off_out, SEEK_SET) != off_out)
+        break;
+      n = sendfile(fd_out, fd_in, &off_in, chunk);
+      if (n > 0)
+        off_out += n;
+    }
+#endif
+
+    if ((n < 0) && (errno == EINTR))
+      continue;
+    if (n <= 0)
+      break;
+    *size -= n;
+  }
+
+  if ((fseeko(in, off_in, SEEK_SET) != 0) || (fseeko(out, off_out, SEEK_SET) != 0))
+    return -1;
+
+  /* At the end of the source, there's nothing left for stdio to copy */
+  if (*size > 0)
+  {
+    if ((fstat(fd_in, &st) == 0) && (off_in >= st.st_size))
+      *size = 0;
+  }
+#endif
+  return 0;
+}
+
 /**
  * mutt_file_copy_bytes - Copy some content from one file to another
  * @param in   Source file
@@ -235,6 +330,9 @@ void mutt_file_unlink(const char *s)
  */
 int mutt_file_copy_bytes(FILE *in, FILE *out, size_t size)
 {
+  if (copy_in_kernel(in, out, &size) != 0)
+    return -1;
+
   while (size > 0)
   {
     char buf[2048];
@@ -262,9 +360,14 @@ int mutt_file_copy_bytes(FILE *in, FILE *out, size_t size)
  */
 int mutt_file_copy_stream(FILE *fin, FILE *fout)
 {
-  size_t l;
+  size_t l = SIZE_MAX;
   char buf[LONG_STRING];
 
+  if (copy_in_kernel(fin, fout, &l) != 0)
+    return -1;
+  if (l == 0)
+    return 0;
+
   while ((l = fread(buf, 1, sizeof(buf), fin)) > 0)
   {
     if (fwrite(buf, 1, l, fout) != l)
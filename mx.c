@@ -70,6 +70,9 @@
 #ifdef USE_COMPRESSED
 #include "compress.h"
 #endif
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
 #ifdef USE_IMAP
 #include "imap/imap.h"
 #endif
@@ -499,7 +502,7 @@ static int trash_append(struct Mailbox *m)
 #endif
 
   struct Mailbox *m_trash = mx_path_resolve(Trash);
-  struct Context *ctx_trash = mx_mbox_open(m_trash, MUTT_APPEND);
+  struct Context *ctx_trash = mx_mbox_open(m_trash, MUTT_APPEND | MUTT_BATCH);
   if (ctx_trash)
   {
     /* continue from initial scan above */
@@ -515,6 +518,13 @@ static int trash_append(struct Mailbox *m)
       }
     }
 
+    /* The messages will be purged, so they must be safely on disk */
+    if (mx_mbox_flush(ctx_trash->mailbox) != 0)
+    {
+      mx_mbox_close(&ctx_trash);
+      return -1;
+    }
+
     mx_mbox_close(&ctx_trash);
   }
   else
@@ -676,33 +686,47 @@ int mx_mbox_close(struct Context **ptr)
 #endif
     {
       struct Mailbox *m_read = mx_path_resolve(mbox);
-      struct Context *ctx_read = mx_mbox_open(m_read, MUTT_APPEND);
+      struct Context *ctx_read = mx_mbox_open(m_read, MUTT_APPEND | MUTT_BATCH);
       if (!ctx_read)
       {
         mailbox_free(&m_read);
         return -1;
       }
 
-      for (i = 0; i < m->msg_count; i++)
+      /* The originals are only deleted once all the copies have been flushed */
+      int rc = 0;
+      int moved = 0;
+      for (; moved < m->msg_count; moved++)
+      {
+        if (m->emails[moved]->read && !m->emails[moved]->deleted &&
+            !(m->emails[moved]->flagged && KeepFlagged))
+        {
+          rc = mutt_append_message(ctx_read->mailbox, ctx->mailbox,
+                                   m->emails[moved], 0, CH_UPDATE_LEN);
+          if (rc != 0)
+            break;
+        }
+      }
+
+      if (mx_mbox_flush(ctx_read->mailbox) != 0)
+      {
+        mx_mbox_close(&ctx_read);
+        return -1;
+      }
+
+      for (i = 0; i < moved; i++)
       {
         if (m->emails[i]->read && !m->emails[i]->deleted &&
             !(m->emails[i]->flagged && KeepFlagged))
         {
-          if (mutt_append_message(ctx_read->mailbox, ctx->mailbox, m->emails[i],
-                                  0, CH_UPDATE_LEN) == 0)
-          {
-            mutt_set_flag(m, m->emails[i], MUTT_DELETE, true);
-            mutt_set_flag(m, m->emails[i], MUTT_PURGE, true);
-          }
-          else
-          {
-            mx_mbox_close(&ctx_read);
-            return -1;
-          }
+          mutt_set_flag(m, m->emails[i], MUTT_DELETE, true);
+          mutt_set_flag(m, m->emails[i], MUTT_PURGE, true);
         }
       }
 
       mx_mbox_close(&ctx_read);
+      if (rc != 0)
+        return -1;
     }
   }
   else if (!m->changed && (m->msg_deleted == 0))
@@ -1028,6 +1052,11 @@ struct Message *mx_msg_open(struct Mailbox *m, int msgno)
     return NULL;
   }
 
+#ifdef USE_HCACHE
+  /* The driver and the caller may need the whole header from now on */
+  mutt_hcache_restore_deferred(m->emails[msgno]);
+#endif
+
   msg = mutt_mem_calloc(1, sizeof(struct Message));
   if (m->mx_ops->msg_open(m, msg, msgno) < 0)
     FREE(&msg);
@@ -1035,6 +1064,27 @@ struct Message *mx_msg_open(struct Mailbox *m, int msgno)
   return msg;
 }
 
+/**
+ * mx_mbox_flush - Write appended messages to disk - Wrapper for MxOps::mbox_flush()
+ * @param m Mailbox opened with #MUTT_APPEND
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * A mailbox opened with #MUTT_BATCH may not write its messages to disk as they
+ * are committed.  This must be called before relying on them being saved, e.g.
+ * before deleting the originals.
+ */
+int mx_mbox_flush(struct Mailbox *m)
+{
+  if (!m || !m->mx_ops)
+    return -1;
+
+  if (!m->append || !m->mx_ops->mbox_flush)
+    return 0;
+
+  return m->mx_ops->mbox_flush(m);
+}
+
 /**
  * mx_msg_commit - Commit a message to a folder - Wrapper for MxOps::msg_commit()
  * @param m   Mailbox
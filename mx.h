@@ -56,6 +56,8 @@ extern char *        Trash;
 #define MUTT_PEEK      (1 << 5) /**< revert atime back after taking a look (if applicable) */
 #define MUTT_APPENDNEW (1 << 6) /**< set in mx_open_mailbox_append if the mailbox doesn't
                                  * exist. used by maildir/mh to create the mailbox. */
+#define MUTT_BATCH     (1 << 7) /**< appending many messages, which may not be saved
+                                 * until mx_mbox_flush() */
 
 /* mx_msg_open_new() */
 #define MUTT_ADD_FROM  (1 << 0) /**< add a From_ line */
@@ -165,6 +167,13 @@ struct MxOps
    * @retval -1 Failure
    */
   int (*mbox_close)      (struct Mailbox *m);
+  /**
+   * mbox_flush - Save the messages appended to a Mailbox, e.g. to disk
+   * @param m Mailbox opened with #MUTT_APPEND
+   * @retval  0 Success
+   * @retval -1 Failure
+   */
+  int (*mbox_flush)      (struct Mailbox *m);
   /**
    * msg_open - Open an email message in Mailbox
    * @param m     Mailbox
@@ -271,6 +280,7 @@ struct MxOps
 int             mx_mbox_check      (struct Mailbox *m, int *index_hint);
 int             mx_mbox_check_stats(struct Mailbox *m, int flags);
 int             mx_mbox_close      (struct Context **ptr);
+int             mx_mbox_flush      (struct Mailbox *m);
 struct Context *mx_mbox_open       (struct Mailbox *m, int flags);
 int             mx_mbox_sync       (struct Mailbox *m, int *index_hint);
 int             mx_msg_close       (struct Mailbox *m, struct Message **msg);
@@ -1182,7 +1182,7 @@ static int parse_overview_line(char *line, void *data)
     {
       mutt_debug(LL_DEBUG2, "mutt_hcache_fetch %s\n", buf);
       mutt_email_free(&e);
-      e = mutt_hcache_restore(hdata);
+      e = mutt_hcache_restore(fc->hc, hdata);
       m->emails[m->msg_count] = e;
       mutt_hcache_free(fc->hc, &hdata);
       e->edata = NULL;
@@ -1363,7 +1363,7 @@ static int nntp_fetch_headers(struct Mailbox *m, void *hc, anum_t first, anum_t
     if (hdata)
     {
       mutt_debug(LL_DEBUG2, "mutt_hcache_fetch %s\n", buf);
-      e = mutt_hcache_restore(hdata);
+      e = mutt_hcache_restore(fc.hc, hdata);
       m->emails[m->msg_count] = e;
       mutt_hcache_free(fc.hc, &hdata);
       e->edata = NULL;
@@ -1628,7 +1628,7 @@ static int check_mailbox(struct Mailbox *m)
           bool deleted;
 
           mutt_debug(LL_DEBUG2, "#1 mutt_hcache_fetch %s\n", buf);
-          e = mutt_hcache_restore(hdata);
+          e = mutt_hcache_restore(hc, hdata);
           mutt_hcache_free(hc, &hdata);
           e->edata = NULL;
           deleted = e->deleted;
@@ -1675,7 +1675,7 @@ static int check_mailbox(struct Mailbox *m)
         if (m->msg_count >= m->email_max)
           mx_alloc_memory(m);
 
-        e = mutt_hcache_restore(hdata);
+        e = mutt_hcache_restore(hc, hdata);
         m->emails[m->msg_count] = e;
         mutt_hcache_free(hc, &hdata);
         e->edata = NULL;
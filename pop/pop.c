@@ -477,7 +477,7 @@ static int pop_fetch_headers(struct Mailbox *m)
          *   (the old e->data should point inside a malloc'd block from
          *   hcache so there shouldn't be a memleak here)
          */
-        struct Email *e = mutt_hcache_restore((unsigned char *) data);
+        struct Email *e = mutt_hcache_restore(hc, (unsigned char *) data);
         mutt_hcache_free(hc, &data);
         mutt_email_free(&m->emails[i]);
         m->emails[i] = e;
@@ -65,6 +65,9 @@
 #include "send.h"
 #include "sendlib.h"
 #include "state.h"
+#ifdef USE_IMAP
+#include "imap/imap.h"
+#endif
 #ifdef ENABLE_NLS
 #include <libintl.h>
 #endif
@@ -1042,6 +1045,43 @@ static void recvattach_edit_content_type(struct AttachCtx *actx,
   mutt_update_recvattach_menu(actx, menu, true);
 }
 
+#ifdef USE_IMAP
+/**
+ * recvattach_fetch_part - Fetch an attachment that was left out of a message
+ * @param actx Attachment context
+ * @param ap   Attachment
+ * @retval  0 Success, or nothing to fetch
+ * @retval  1 The whole message is needed
+ * @retval -1 Error
+ *
+ * See $imap_partial_fetch.
+ */
+static int recvattach_fetch_part(struct AttachCtx *actx, struct AttachPtr *ap)
+{
+  struct Mailbox *m = Context ? Context->mailbox : NULL;
+  FILE *fp = NULL;
+
+  /* Only the original message can be missing some parts */
+  if (ap->fp != actx->root_fp)
+    return 0;
+
+  struct Body *b = NULL;
+  int rc = imap_fetch_missing_part(m, actx->email, ap->content, ap->fp, &fp, &b);
+  if (fp)
+  {
+    /* The email's own part still describes the message file */
+    mutt_actx_add_fp(actx, fp);
+    mutt_actx_add_body(actx, b);
+    b->tagged = ap->content->tagged;
+    b->aptr = ap;
+    ap->content->aptr = NULL;
+    ap->content = b;
+    ap->fp = fp;
+  }
+  return rc;
+}
+#endif
+
 /**
  * mutt_attach_display_loop - Event loop for the Attachment menu
  * @param menu Menu listing Attachments
@@ -1063,6 +1103,20 @@ int mutt_attach_display_loop(struct Menu *menu, int op, struct Email *e,
         /* fallthrough */
 
       case OP_VIEW_ATTACH:
+#ifdef USE_IMAP
+        if (recv)
+        {
+          const int rc = recvattach_fetch_part(actx, CURATTACH);
+          /* let mutt_view_attachments() fetch the whole message */
+          if (rc > 0)
+            return OP_VIEW_ATTACH;
+          if (rc < 0)
+          {
+            op = OP_NULL;
+            break;
+          }
+        }
+#endif
         op = mutt_view_attachment(CURATTACH->fp, CURATTACH->content, MUTT_REGULAR, e, actx);
         break;
 
@@ -1312,6 +1366,114 @@ static void attach_collapse(struct AttachCtx *actx, struct Menu *menu)
   }
 }
 
+#ifdef USE_IMAP
+/**
+ * recvattach_fetch_message - Fetch the parts that were left out of a message
+ * @param actx Attachment context
+ * @param menu Menu listing Attachments
+ * @param msg  Message being shown
+ * @param op   Operation about to be performed, e.g. OP_SAVE
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * A large IMAP message may have been opened without its attachments, see
+ * $imap_partial_fetch.  Viewing, saving, piping or printing only needs the
+ * selected attachments.  Changing or sending them needs the whole message,
+ * which replaces the partial one.
+ */
+static int recvattach_fetch_message(struct AttachCtx *actx, struct Menu *menu,
+                                    struct Message **msg, int op)
+{
+  struct Mailbox *m = Context ? Context->mailbox : NULL;
+  struct Email *e = actx->email;
+  int rc = 0;
+
+  if (!imap_part_missing(m, e, e->content))
+    return 0;
+
+  switch (op)
+  {
+    case OP_ATTACH_VIEW_MAILCAP:
+    case OP_ATTACH_VIEW_TEXT:
+    case OP_DISPLAY_HEADERS:
+    case OP_VIEW_ATTACH:
+      rc = recvattach_fetch_part(actx, CURATTACH);
+      break;
+
+    case OP_PIPE:
+    case OP_PRINT:
+    case OP_SAVE:
+      if (!menu->tagprefix)
+      {
+        rc = recvattach_fetch_part(actx, CURATTACH);
+        break;
+      }
+      rc = 0;
+      for (int i = 0; (rc == 0) && (i < actx->idxlen); i++)
+        if (actx->idx[i]->content->tagged)
+          rc = recvattach_fetch_part(actx, actx->idx[i]);
+      break;
+
+    /* Changing or sending the attachments needs the whole message */
+    case OP_BOUNCE_MESSAGE:
+    case OP_CHECK_TRADITIONAL:
+    case OP_COMPOSE_TO_SENDER:
+    case OP_DELETE:
+    case OP_EDIT_TYPE:
+    case OP_EXTRACT_KEYS:
+    case OP_FOLLOWUP:
+    case OP_FORWARD_MESSAGE:
+    case OP_FORWARD_TO_GROUP:
+    case OP_GROUP_CHAT_REPLY:
+    case OP_GROUP_REPLY:
+    case OP_LIST_REPLY:
+    case OP_REPLY:
+    case OP_RESEND:
+    case OP_UNDELETE:
+      rc = 1;
+      break;
+  }
+
+  if (rc <= 0)
+    return rc;
+
+  /* The new parts have the same layout, so keep the tags and collapsed trees */
+  const int idxlen = actx->idxlen;
+  unsigned char *state = mutt_mem_calloc(MAX(idxlen, 1), 1);
+  for (int i = 0; i < idxlen; i++)
+    state[i] = (actx->idx[i]->content->tagged ? 1 : 0) |
+               (actx->idx[i]->content->collapsed ? 2 : 0);
+
+  /* Opening the whole message parses its parts again */
+  struct Message *full = mx_msg_open(m, e->msgno);
+  if (!full)
+  {
+    FREE(&state);
+    return -1;
+  }
+  mx_msg_close(m, msg);
+  *msg = full;
+
+  for (int i = 0; i < actx->idxlen; i++)
+    actx->idx[i]->content = NULL;
+  mutt_actx_free_entries(actx);
+  actx->root_fp = full->fp;
+  mutt_update_recvattach_menu(actx, menu, true);
+
+  if (actx->idxlen == idxlen)
+  {
+    for (int i = 0; i < idxlen; i++)
+    {
+      actx->idx[i]->content->tagged = state[i] & 1;
+      actx->idx[i]->content->collapsed = state[i] & 2;
+    }
+    mutt_update_recvattach_menu(actx, menu, false);
+  }
+  FREE(&state);
+  return 0;
+}
+#endif
+
 /**
  * mutt_view_attachments - Show the attachments in a Menu
  * @param e Email
@@ -1326,11 +1488,23 @@ void mutt_view_attachments(struct Email *e)
   struct Mailbox *m = Context ? Context->mailbox : NULL;
 
   /* make sure we have parsed this message */
+#ifdef USE_IMAP
+  imap_allow_partial(m, e, true);
+#endif
   mutt_parse_mime_message(m, e);
+#ifdef USE_IMAP
+  imap_allow_partial(m, e, false);
+#endif
 
   mutt_message_hook(m, e, MUTT_MESSAGE_HOOK);
 
+#ifdef USE_IMAP
+  imap_allow_partial(m, e, true);
+#endif
   struct Message *msg = mx_msg_open(m, e->msgno);
+#ifdef USE_IMAP
+  imap_allow_partial(m, e, false);
+#endif
   if (!msg)
     return;
 
@@ -1352,6 +1526,14 @@ void mutt_view_attachments(struct Email *e)
       op = mutt_menu_loop(menu);
     if (!Context)
       return;
+#ifdef USE_IMAP
+    if (recvattach_fetch_message(actx, menu, &msg, op) < 0)
+    {
+      mutt_error(_("Can't fetch the attachment"));
+      op = OP_NULL;
+      continue;
+    }
+#endif
     switch (op)
     {
       case OP_ATTACH_VIEW_MAILCAP:
@@ -0,0 +1,497 @@
+/**
+ * @file
+ * Benchmark for the header cache backends
+ *
+ * @authors
+ * Copyright (C) 2019 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hcache_bench Header cache benchmark
+ *
+ * Measure the throughput and latency of the header cache, without the noise
+ * of a full NeoMutt session.
+ *
+ * A set of Emails is synthesised from a fixed seed, so runs are reproducible.
+ * Then, for every compiled-in backend (or those given with `-b`), the time
+ * taken by each call to mutt_hcache_dump(), mutt_hcache_store(),
+ * mutt_hcache_fetch() and mutt_hcache_restore() is recorded.
+ *
+ * Usage: `hcache-bench [-n count] [-r rounds] [-s seed] [-d dir] [-b backend]...`
+ *
+ * If the header cache compression is compiled in, `-c method` and `-l level`
+ * select the compression of the records.
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "mutt/mutt.h"
+#include "email/lib.h"
+#include "hcache/hcache.h"
+#include "hcache/serialize.h"
+
+/* These are normally provided by the NeoMutt binary */
+char *HeaderCachePagesize = "16384";
+bool HeaderCacheCompress = false;
+bool AutoSubscribe = false;
+
+/**
+ * mutt_encode_path - Convert a path to 'us-ascii'
+ * @param buf    Buffer for the result
+ * @param buflen Length of buffer
+ * @param src    Path to convert (OPTIONAL)
+ *
+ * The benchmark only uses ASCII paths, so no conversion is needed.
+ */
+void mutt_encode_path(char *buf, size_t buflen, const char *src)
+{
+  if (buf != src)
+    mutt_str_strfcpy(buf, src, buflen);
+}
+
+/**
+ * mutt_auto_subscribe - Check if user is subscribed to mailing list
+ * @param mailto URL of mailing list subscribe
+ */
+void mutt_auto_subscribe(const char *mailto)
+{
+}
+
+/**
+ * enum BenchOp - Operations timed by the benchmark
+ */
+enum BenchOp
+{
+  BENCH_DUMP,    ///< mutt_hcache_dump()
+  BENCH_STORE,   ///< mutt_hcache_store()
+  BENCH_FETCH,   ///< mutt_hcache_fetch()
+  BENCH_RESTORE, ///< mutt_hcache_restore()
+  BENCH_MAX,
+};
+
+static const char *const BenchOpNames[] = { "dump", "store", "fetch", "restore" };
+
+/**
+ * struct BenchTimes - Latencies of one operation
+ */
+struct BenchTimes
+{
+  uint64_t *ns;  ///< Latency of each call, in nanoseconds
+  size_t count;  ///< Number of calls
+  uint64_t total; ///< Sum of the latencies
+};
+
+static unsigned long Seed = 1; ///< State of the random number generator
+
+/**
+ * bench_rand - Get a reproducible pseudo-random number
+ * @param max Upper bound (exclusive)
+ * @retval num Number in [0, max)
+ */
+static unsigned int bench_rand(unsigned int max)
+{
+  Seed = (Seed * 1103515245 + 12345) & 0x7fffffff;
+  return (Seed >> 8) % max;
+}
+
+/**
+ * bench_now - Get a monotonic timestamp
+ * @retval num Time in nanoseconds
+ */
+static uint64_t bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * bench_word - Append a random word to a string
+ * @param buf    Buffer
+ * @param buflen Length of buffer
+ */
+static void bench_word(char *buf, size_t buflen)
+{
+  static const char *const words[] = {
+    "meeting", "report", "update", "review", "patch", "release", "question",
+    "invoice", "project", "status", "agenda", "build", "fix", "weekly",
+    "notes", "draft", "urgent", "lunch", "hcache", "neomutt",
+  };
+
+  size_t len = mutt_str_strlen(buf);
+  snprintf(buf + len, buflen - len, "%s%s", (len != 0) ? " " : "",
+           words[bench_rand(mutt_array_size(words))]);
+}
+
+/**
+ * bench_email - Synthesise an Email
+ * @param i Index of the Email
+ * @retval ptr New Email
+ *
+ * The Emails look like typical mailing list traffic: a few recipients,
+ * threading headers, a multipart body and some user-defined headers.
+ */
+static struct Email *bench_email(int i)
+{
+  static const char *const domains[] = { "example.com", "example.org",
+                                         "lists.example.net", "neomutt.org" };
+  char buf[1024];
+
+  struct Email *e = mutt_email_new();
+  e->env = mutt_env_new();
+  e->content = mutt_body_new();
+
+  buf[0] = '\0';
+  if (bench_rand(3) == 0)
+    mutt_str_strfcpy(buf, "Re:", sizeof(buf));
+  for (int w = 1 + bench_rand(8); w > 0; w--)
+    bench_word(buf, sizeof(buf));
+  e->env->subject = mutt_str_strdup(buf);
+  e->env->real_subj = e->env->subject + ((buf[0] == 'R') ? 4 : 0);
+
+  snprintf(buf, sizeof(buf), "User %u <user%u@%s>", bench_rand(500),
+           bench_rand(500), domains[bench_rand(mutt_array_size(domains))]);
+  e->env->from = mutt_addr_parse_list(NULL, buf);
+  for (int r = 1 + bench_rand(4); r > 0; r--)
+  {
+    snprintf(buf, sizeof(buf), "rcpt%u@%s", bench_rand(1000),
+             domains[bench_rand(mutt_array_size(domains))]);
+    e->env->to = mutt_addr_parse_list(e->env->to, buf);
+  }
+
+  snprintf(buf, sizeof(buf), "<%d.%u@%s>", i, bench_rand(1 << 20),
+           domains[bench_rand(mutt_array_size(domains))]);
+  e->env->message_id = mutt_str_strdup(buf);
+  for (int r = bench_rand(6); r > 0; r--)
+  {
+    snprintf(buf, sizeof(buf), "<%u.%u@%s>", bench_rand(1 << 20),
+             bench_rand(1 << 20), domains[bench_rand(mutt_array_size(domains))]);
+    mutt_list_insert_tail(&e->env->references, mutt_str_strdup(buf));
+  }
+  if (!STAILQ_EMPTY(&e->env->references))
+    mutt_list_insert_tail(&e->env->in_reply_to,
+                          mutt_str_strdup(STAILQ_FIRST(&e->env->references)->data));
+
+  snprintf(buf, sizeof(buf), "X-Mailer: NeoMutt/%u", bench_rand(100));
+  mutt_list_insert_tail(&e->env->userhdrs, mutt_str_strdup(buf));
+  snprintf(buf, sizeof(buf), "List-Id: <list%u.%s>", bench_rand(10),
+           domains[bench_rand(mutt_array_size(domains))]);
+  mutt_list_insert_tail(&e->env->userhdrs, mutt_str_strdup(buf));
+
+  e->content->type = TYPE_MULTIPART;
+  e->content->subtype = mutt_str_strdup("mixed");
+  snprintf(buf, sizeof(buf), "----=_Part_%u_%u", bench_rand(1 << 20), i);
+  mutt_param_set(&e->content->parameter, "boundary", buf);
+  e->content->length = 500 + bench_rand(100000);
+  e->content->offset = bench_rand(1000);
+
+  e->date_sent = 1500000000 + i * 60;
+  e->received = e->date_sent + bench_rand(600);
+  e->lines = e->content->length / 60;
+  e->read = bench_rand(4) != 0;
+  e->flagged = bench_rand(20) == 0;
+  e->replied = bench_rand(10) == 0;
+
+  return e;
+}
+
+/**
+ * bench_record - Record the latency of a call
+ * @param bt    Latencies of the operation
+ * @param start Time at which the call started
+ */
+static void bench_record(struct BenchTimes *bt, uint64_t start)
+{
+  uint64_t ns = bench_now() - start;
+  bt->ns[bt->count++] = ns;
+  bt->total += ns;
+}
+
+/**
+ * bench_cmp - Compare two latencies - Implements ::sort_t
+ */
+static int bench_cmp(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * bench_report - Print the statistics of an operation
+ * @param backend Name of the backend
+ * @param op      Operation
+ * @param bt      Latencies of the operation
+ */
+static void bench_report(const char *backend, enum BenchOp op, struct BenchTimes *bt)
+{
+  if (bt->count == 0)
+    return;
+
+  qsort(bt->ns, bt->count, sizeof(uint64_t), bench_cmp);
+
+#define PCT(p) (bt->ns[(bt->count - 1) * (p) / 100] / 1000.0)
+  printf("%-14s %-8s %10.0f %9.2f %9.2f %9.2f %9.2f\n", backend,
+         BenchOpNames[op], bt->count * 1e9 / bt->total, PCT(50), PCT(90),
+         PCT(99), bt->ns[bt->count - 1] / 1000.0);
+#undef PCT
+}
+
+/**
+ * bench_backend - Benchmark one backend
+ * @param backend Name of the backend
+ * @param dir     Directory for the database files
+ * @param emails  Emails to store
+ * @param count   Number of Emails
+ * @param rounds  Number of times the Emails are fetched back
+ * @retval true Success
+ */
+static bool bench_backend(const char *backend, const char *dir,
+                          struct Email **emails, int count, int rounds)
+{
+  struct BenchTimes bt[BENCH_MAX] = { { 0 } };
+  char path[PATH_MAX];
+  char key[32];
+  bool rc = false;
+
+  for (int op = 0; op < BENCH_MAX; op++)
+    bt[op].ns = mutt_mem_calloc((size_t) count * ((op < BENCH_FETCH) ? 1 : rounds),
+                                sizeof(uint64_t));
+
+  mutt_str_replace(&HeaderCacheBackend, backend);
+  snprintf(path, sizeof(path), "%s/%s.hcache", dir, backend);
+  unlink(path);
+
+  header_cache_t *hc = mutt_hcache_open(path, "/hcache-bench", NULL);
+  if (!hc)
+  {
+    fprintf(stderr, "%s: can't open %s\n", backend, path);
+    goto done;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    int dlen = 0;
+    uint64_t start = bench_now();
+    void *data = mutt_hcache_dump(hc, emails[i], &dlen, 0);
+    bench_record(&bt[BENCH_DUMP], start);
+    FREE(&data);
+  }
+
+  /* Store in one batch, as the mailbox backends do */
+  uint64_t populate = bench_now();
+  mutt_hcache_begin(hc);
+  for (int i = 0; i < count; i++)
+  {
+    size_t klen = snprintf(key, sizeof(key), "/%d", i);
+    uint64_t start = bench_now();
+    mutt_hcache_store(hc, key, klen, emails[i], 0);
+    bench_record(&bt[BENCH_STORE], start);
+  }
+  mutt_hcache_commit(hc);
+  mutt_hcache_close(hc);
+  populate = bench_now() - populate;
+
+  uint64_t reload = bench_now();
+  hc = mutt_hcache_open(path, "/hcache-bench", NULL);
+  if (!hc)
+  {
+    fprintf(stderr, "%s: can't reopen %s\n", backend, path);
+    goto done;
+  }
+
+  int misses = 0;
+  for (int r = 0; r < rounds; r++)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      size_t klen = snprintf(key, sizeof(key), "/%d", i);
+      uint64_t start = bench_now();
+      void *data = mutt_hcache_fetch(hc, key, klen);
+      bench_record(&bt[BENCH_FETCH], start);
+      if (!data)
+      {
+        misses++;
+        continue;
+      }
+
+      start = bench_now();
+      struct Email *e = mutt_hcache_restore(hc, data);
+      bench_record(&bt[BENCH_RESTORE], start);
+      mutt_hcache_free(hc, &data);
+      mutt_email_free(&e);
+    }
+  }
+  mutt_hcache_close(hc);
+  reload = bench_now() - reload;
+
+  struct stat st;
+  off_t size = (stat(path, &st) == 0) ? st.st_size : 0;
+
+  for (int op = 0; op < BENCH_MAX; op++)
+    bench_report(backend, op, &bt[op]);
+  printf("%-14s populate %.3fs, reload %.3fs, %lld KiB, %d misses\n\n", backend,
+         populate / 1e9, reload / 1e9, (long long) size / 1024, misses);
+
+  unlink(path);
+  rc = (misses == 0);
+
+done:
+  for (int op = 0; op < BENCH_MAX; op++)
+    FREE(&bt[op].ns);
+  return rc;
+}
+
+/**
+ * usage - Display the usage of the benchmark
+ * @param name Name of the program
+ */
+static void usage(const char *name)
+{
+  const char *list = mutt_hcache_backend_list();
+  fprintf(stderr,
+          "Usage: %s [-n count] [-r rounds] [-s seed] [-d dir] [-b backend]...\n"
+          "  -n  Number of emails (default 10000)\n"
+          "  -r  Number of times the emails are fetched back (default 1)\n"
+          "  -s  Seed used to synthesise the emails (default 1)\n"
+          "  -d  Directory for the database files (default: a temporary one)\n"
+          "  -b  Backend to benchmark, may be repeated (default: all)\n"
+#ifdef USE_HCACHE_COMPRESSION
+          "  -c  Compression method (default: none)\n"
+          "  -l  Compression level (default 1)\n"
+#endif
+          "Backends: %s\n",
+          name, list);
+  FREE(&list);
+}
+
+int main(int argc, char *argv[])
+{
+  struct ListHead backends = STAILQ_HEAD_INITIALIZER(backends);
+  char tmpdir[] = "/tmp/hcache-bench-XXXXXX";
+  const char *dir = NULL;
+  int count = 10000;
+  int rounds = 1;
+  int opt;
+
+#ifdef USE_HCACHE_COMPRESSION
+  HeaderCacheCompressLevel = 1;
+  while ((opt = getopt(argc, argv, "b:c:d:l:n:r:s:h")) != -1)
+#else
+  while ((opt = getopt(argc, argv, "b:d:n:r:s:h")) != -1)
+#endif
+  {
+    switch (opt)
+    {
+      case 'b':
+        if (!mutt_hcache_is_valid_backend(optarg))
+        {
+          fprintf(stderr, "Unknown backend: %s\n", optarg);
+          return 1;
+        }
+        mutt_list_insert_tail(&backends, mutt_str_strdup(optarg));
+        break;
+#ifdef USE_HCACHE_COMPRESSION
+      case 'c':
+        if (!mutt_hcache_is_valid_compression(optarg))
+        {
+          fprintf(stderr, "Unknown compression method: %s\n", optarg);
+          return 1;
+        }
+        HeaderCacheCompressMethod = optarg;
+        break;
+      case 'l':
+        HeaderCacheCompressLevel = atoi(optarg);
+        break;
+#endif
+      case 'd':
+        dir = optarg;
+        break;
+      case 'n':
+        count = atoi(optarg);
+        break;
+      case 'r':
+        rounds = atoi(optarg);
+        break;
+      case 's':
+        Seed = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if ((count <= 0) || (rounds <= 0))
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (STAILQ_EMPTY(&backends))
+  {
+    char *list = (char *) mutt_hcache_backend_list();
+    for (char *name = strtok(list, ", "); name; name = strtok(NULL, ", "))
+      mutt_list_insert_tail(&backends, mutt_str_strdup(name));
+    FREE(&list);
+  }
+
+  if (!dir)
+  {
+    dir = mkdtemp(tmpdir);
+    if (!dir)
+    {
+      fprintf(stderr, "Can't create a temporary directory: %s\n", strerror(errno));
+      return 1;
+    }
+  }
+
+  printf("%d emails, %d round(s), seed %lu\n\n", count, rounds, Seed);
+
+  struct Email **emails = mutt_mem_calloc(count, sizeof(struct Email *));
+  for (int i = 0; i < count; i++)
+    emails[i] = bench_email(i);
+
+  printf("%-14s %-8s %10s %9s %9s %9s %9s\n", "backend", "op", "ops/s",
+         "p50(us)", "p90(us)", "p99(us)", "max(us)");
+
+  bool rc = true;
+  struct ListNode *np = NULL;
+  STAILQ_FOREACH(np, &backends, entries)
+  {
+    rc &= bench_backend(np->data, dir, emails, count, rounds);
+  }
+
+  for (int i = 0; i < count; i++)
+    mutt_email_free(&emails[i]);
+  FREE(&emails);
+  mutt_list_free(&backends);
+  FREE(&HeaderCacheBackend);
+  if (dir == tmpdir)
+    rmdir(tmpdir);
+
+  return rc ? 0 : 1;
+}
@@ -46,6 +46,7 @@
 const char *mutt_make_version(void);
 /* #include "hcache/hcache.h" */
 const char *mutt_hcache_backend_list(void);
+const char *mutt_hcache_compress_list(void);
 
 const int SCREEN_WIDTH = 80;
 
@@ -260,6 +261,11 @@ static struct CompileOptions comp_opts[] = {
 #else
   { "pgp", 0 },
 #endif
+#ifdef USE_PTHREADS
+  { "pthreads", 1 },
+#else
+  { "pthreads", 0 },
+#endif
 #ifdef USE_SASL
   { "sasl", 1 },
 #else
@@ -402,6 +408,11 @@ void print_version(FILE *fp)
   const char *backends = mutt_hcache_backend_list();
   fprintf(fp, "\nhcache backends: %s", backends);
   FREE(&backends);
+#ifdef USE_HCACHE_COMPRESSION
+  const char *compression = mutt_hcache_compress_list();
+  fprintf(fp, "\nhcache compression: %s", compression);
+  FREE(&compression);
+#endif
 #endif
 
   fputs("\n\nCompiler:\n", fp);